@@ -84,6 +84,12 @@ int copy_siginfo_to_user32(compat_siginfo_t __user *to, siginfo_t *from)
 			case __SI_POLL >> 16:
 				put_user_ex(from->si_fd, &to->si_fd);
 				break;
+			case __SI_SYS >> 16:
+				put_user_ex(from->si_syscall,
+					    &to->_sifields._sigsys._syscall);
+				put_user_ex(from->si_arch,
+					    &to->_sifields._sigsys._arch);
+				break;
 			case __SI_TIMER >> 16:
 				put_user_ex(from->si_overrun, &to->si_overrun);
 				put_user_ex(ptr_to_compat(from->si_ptr),
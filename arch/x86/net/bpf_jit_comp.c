@@ -11,6 +11,8 @@
 #include <asm/cacheflush.h>
 #include <linux/netdevice.h>
 #include <linux/filter.h>
+#include <linux/bpf.h>
+#include <linux/seccomp.h>
 
 /*
  * Conventions :
@@ -109,6 +111,7 @@ do {								\
 #define SEEN_DATAREF 1 /* might call external helpers */
 #define SEEN_XREG    2 /* ebx is used */
 #define SEEN_MEM     4 /* use mem[] for temporary storage */
+#define SEEN_SECCOMP 8 /* calls seccomp_bpf_load(), there is no skb */
 
 static inline void bpf_flush_icache(void *start, void *end)
 {
@@ -213,6 +216,7 @@ void bpf_jit_compile(struct sk_filter *fp)
 		case BPF_S_ANC_RXHASH:
 		case BPF_S_ANC_CPU:
 		case BPF_S_ANC_QUEUE:
+		case BPF_S_ANC_SECCOMP_LD_W:
 		case BPF_S_LD_W_ABS:
 		case BPF_S_LD_H_ABS:
 		case BPF_S_LD_B_ABS:
@@ -477,6 +481,19 @@ void bpf_jit_compile(struct sk_filter *fp)
 				CLEAR_A();
 #endif
 				break;
+#ifdef CONFIG_SECCOMP_FILTER
+			case BPF_S_ANC_SECCOMP_LD_W:
+				/* A = seccomp_bpf_load(K), a plain C call:
+				 * %rbx (X) is preserved, the frame keeps
+				 * the stack aligned
+				 */
+				seen |= SEEN_SECCOMP;
+				func = (u8 *)seccomp_bpf_load;
+				t_offset = func - (image + addrs[i]);
+				EMIT1_off32(0xbf, K); /* mov imm32,%edi */
+				EMIT1_off32(0xe8, t_offset); /* call seccomp_bpf_load */
+				break;
+#endif
 			case BPF_S_LD_W_ABS:
 				func = CHOOSE_LOAD_FUNC(K, sk_load_word);
 common_load:			seen |= SEEN_DATAREF;
@@ -663,3 +680,748 @@ void bpf_jit_free(struct sk_filter *fp)
 		schedule_work(work);
 	}
 }
+
+#ifdef CONFIG_BPF_SYSCALL
+/*
+ * Extended BPF JIT
+ *
+ * eBPF registers map 1:1 onto x86-64 registers so that helper calls
+ * need no argument shuffling: R0 is the return value in rax, R1-R5 are
+ * the argument registers, R6-R9 live in callee saved registers and R10
+ * is the frame pointer.  r11 is a scratch register for the JIT.
+ *
+ *  rbp - 512 .. rbp - 1	: eBPF program stack
+ *  rbp - 544 .. rbp - 513	: saved rbx, r13, r14, r15
+ */
+#define AUX_REG		(MAX_BPF_REG)
+#define EBPF_STACKSIZE	(MAX_BPF_STACK + 32)
+
+#define EMIT2_off32(b1, b2, off) \
+	do { EMIT2(b1, b2); EMIT(off, 4); } while (0)
+#define EMIT3_off32(b1, b2, b3, off) \
+	do { EMIT3(b1, b2, b3); EMIT(off, 4); } while (0)
+
+#define X86_JGE	0x7D
+#define X86_JG	0x7F
+
+/* x86 register number of each eBPF register, the REX prefix extends
+ * it for r8-r15, see is_ereg()
+ */
+static const int reg2hex[] = {
+	[BPF_REG_0] = 0,	/* rax */
+	[BPF_REG_1] = 7,	/* rdi */
+	[BPF_REG_2] = 6,	/* rsi */
+	[BPF_REG_3] = 2,	/* rdx */
+	[BPF_REG_4] = 1,	/* rcx */
+	[BPF_REG_5] = 0,	/* r8 */
+	[BPF_REG_6] = 3,	/* rbx, callee saved */
+	[BPF_REG_7] = 5,	/* r13, callee saved */
+	[BPF_REG_8] = 6,	/* r14, callee saved */
+	[BPF_REG_9] = 7,	/* r15, callee saved */
+	[BPF_REG_10] = 5,	/* rbp, read only frame pointer */
+	[AUX_REG] = 3,		/* r11, scratch */
+};
+
+/* is_ereg() == true if register is one of r8-r15 */
+static inline bool is_ereg(u32 reg)
+{
+	return reg == BPF_REG_5 || reg == AUX_REG ||
+	       (reg >= BPF_REG_7 && reg <= BPF_REG_9);
+}
+
+/* add modifiers to the REX prefix if the register is one of r8-r15 */
+static inline u8 add_1mod(u8 byte, u32 reg)
+{
+	if (is_ereg(reg))
+		byte |= 1;
+	return byte;
+}
+
+/* rm_reg goes in REX.B, reg in REX.R */
+static inline u8 add_2mod(u8 byte, u32 rm_reg, u32 reg)
+{
+	if (is_ereg(rm_reg))
+		byte |= 1;
+	if (is_ereg(reg))
+		byte |= 4;
+	return byte;
+}
+
+/* encode 'dst_reg' register into ModRM.rm */
+static inline u8 add_1reg(u8 byte, u32 dst_reg)
+{
+	return byte + reg2hex[dst_reg];
+}
+
+/* encode 'rm_reg' into ModRM.rm and 'reg' into ModRM.reg */
+static inline u8 add_2reg(u8 byte, u32 rm_reg, u32 reg)
+{
+	return byte + reg2hex[rm_reg] + (reg2hex[reg] << 3);
+}
+
+static inline int bpf_size_to_x86_bytes(int bpf_size)
+{
+	if (bpf_size == BPF_W)
+		return 4;
+	else if (bpf_size == BPF_H)
+		return 2;
+	else if (bpf_size == BPF_B)
+		return 1;
+	else if (bpf_size == BPF_DW)
+		return 4; /* imm32 */
+	else
+		return 0;
+}
+
+/* ModRM for [base + off] with the shortest displacement */
+#define EMIT_MEM(base, reg, off)					\
+do {									\
+	if (is_imm8(off))						\
+		EMIT2(add_2reg(0x40, base, reg), off);			\
+	else								\
+		EMIT1_off32(add_2reg(0x80, base, reg), off);		\
+} while (0)
+
+/*
+ * call rel32 to func from the current position.  The displacement is
+ * relative to the end of the 5 byte call, so compute it before the
+ * opcode byte is emitted.
+ */
+#define EMIT_CALL(func)							\
+do {									\
+	s32 __call_off = (s32) ((unsigned long) (func) -		\
+		((unsigned long) image + proglen + (prog - temp) + 5));	\
+	EMIT1_off32(0xE8, __call_off);					\
+} while (0)
+
+static int do_ebpf_jit(struct bpf_prog *bpf_prog, int *addrs, u8 *image,
+		       int oldproglen, int *cleanup_addr)
+{
+	const struct bpf_insn *insn = bpf_prog->insnsi;
+	int insn_cnt = bpf_prog->len;
+	u8 temp[64];
+	u8 *prog = temp;
+	int proglen = 0;
+	int i, ilen;
+
+	EMIT1(0x55); /* push rbp */
+	EMIT3(0x48, 0x89, 0xE5); /* mov rbp,rsp */
+	EMIT3_off32(0x48, 0x81, 0xEC, EBPF_STACKSIZE); /* sub rsp,stacksize */
+	EMIT3_off32(0x48, 0x89, 0x9D, -EBPF_STACKSIZE); /* mov [rbp-X],rbx */
+	EMIT3_off32(0x4C, 0x89, 0xAD, -EBPF_STACKSIZE + 8); /* mov [rbp-X],r13 */
+	EMIT3_off32(0x4C, 0x89, 0xB5, -EBPF_STACKSIZE + 16); /* mov [rbp-X],r14 */
+	EMIT3_off32(0x4C, 0x89, 0xBD, -EBPF_STACKSIZE + 24); /* mov [rbp-X],r15 */
+
+	ilen = prog - temp;
+	if (image)
+		memcpy(image, temp, ilen);
+	proglen = ilen;
+	prog = temp;
+
+	for (i = 0; i < insn_cnt; i++, insn++) {
+		const s32 imm32 = insn->imm;
+		u32 dst_reg = insn->dst_reg;
+		u32 src_reg = insn->src_reg;
+		bool alu64 = BPF_CLASS(insn->code) == BPF_ALU64;
+		u32 target = dst_reg;
+		s32 jmp_offset;
+		u8 b2 = 0, b3 = 0;
+		u8 jmp_cond;
+		u64 imm64;
+
+		switch (insn->code) {
+			/* ALU */
+		case BPF_ALU | BPF_ADD | BPF_X:
+		case BPF_ALU | BPF_SUB | BPF_X:
+		case BPF_ALU | BPF_AND | BPF_X:
+		case BPF_ALU | BPF_OR | BPF_X:
+		case BPF_ALU | BPF_XOR | BPF_X:
+		case BPF_ALU64 | BPF_ADD | BPF_X:
+		case BPF_ALU64 | BPF_SUB | BPF_X:
+		case BPF_ALU64 | BPF_AND | BPF_X:
+		case BPF_ALU64 | BPF_OR | BPF_X:
+		case BPF_ALU64 | BPF_XOR | BPF_X:
+			switch (BPF_OP(insn->code)) {
+			case BPF_ADD: b2 = 0x01; break;
+			case BPF_SUB: b2 = 0x29; break;
+			case BPF_AND: b2 = 0x21; break;
+			case BPF_OR: b2 = 0x09; break;
+			case BPF_XOR: b2 = 0x31; break;
+			}
+			if (alu64)
+				EMIT1(add_2mod(0x48, dst_reg, src_reg));
+			else if (is_ereg(dst_reg) || is_ereg(src_reg))
+				EMIT1(add_2mod(0x40, dst_reg, src_reg));
+			EMIT2(b2, add_2reg(0xC0, dst_reg, src_reg));
+			break;
+
+			/* mov dst, src */
+		case BPF_ALU64 | BPF_MOV | BPF_X:
+		case BPF_ALU | BPF_MOV | BPF_X:
+			if (alu64)
+				EMIT1(add_2mod(0x48, dst_reg, src_reg));
+			else if (is_ereg(dst_reg) || is_ereg(src_reg))
+				EMIT1(add_2mod(0x40, dst_reg, src_reg));
+			EMIT2(0x89, add_2reg(0xC0, dst_reg, src_reg));
+			break;
+
+			/* neg dst */
+		case BPF_ALU | BPF_NEG:
+		case BPF_ALU64 | BPF_NEG:
+			if (alu64)
+				EMIT1(add_1mod(0x48, dst_reg));
+			else if (is_ereg(dst_reg))
+				EMIT1(add_1mod(0x40, dst_reg));
+			EMIT2(0xF7, add_1reg(0xD8, dst_reg));
+			break;
+
+		case BPF_ALU | BPF_ADD | BPF_K:
+		case BPF_ALU | BPF_SUB | BPF_K:
+		case BPF_ALU | BPF_AND | BPF_K:
+		case BPF_ALU | BPF_OR | BPF_K:
+		case BPF_ALU | BPF_XOR | BPF_K:
+		case BPF_ALU64 | BPF_ADD | BPF_K:
+		case BPF_ALU64 | BPF_SUB | BPF_K:
+		case BPF_ALU64 | BPF_AND | BPF_K:
+		case BPF_ALU64 | BPF_OR | BPF_K:
+		case BPF_ALU64 | BPF_XOR | BPF_K:
+			if (alu64)
+				EMIT1(add_1mod(0x48, dst_reg));
+			else if (is_ereg(dst_reg))
+				EMIT1(add_1mod(0x40, dst_reg));
+
+			switch (BPF_OP(insn->code)) {
+			case BPF_ADD: b3 = 0xC0; break;
+			case BPF_SUB: b3 = 0xE8; break;
+			case BPF_AND: b3 = 0xE0; break;
+			case BPF_OR: b3 = 0xC8; break;
+			case BPF_XOR: b3 = 0xF0; break;
+			}
+
+			if (is_imm8(imm32))
+				EMIT3(0x83, add_1reg(b3, dst_reg), imm32);
+			else
+				EMIT2_off32(0x81, add_1reg(b3, dst_reg), imm32);
+			break;
+
+		case BPF_ALU64 | BPF_MOV | BPF_K:
+			/* mov dst, imm32 sign extended to 64 bits */
+			EMIT1(add_1mod(0x48, dst_reg));
+			EMIT2_off32(0xC7, add_1reg(0xC0, dst_reg), imm32);
+			break;
+
+		case BPF_ALU | BPF_MOV | BPF_K:
+			/* mov dst32, imm32 zero extends */
+			if (is_ereg(dst_reg))
+				EMIT1(add_1mod(0x40, dst_reg));
+			EMIT1_off32(add_1reg(0xB8, dst_reg), imm32);
+			break;
+
+		case BPF_LD | BPF_IMM | BPF_DW:
+			/* movabs dst, imm64 */
+			imm64 = (u64) (u32) insn[0].imm | ((u64) (u32) insn[1].imm) << 32;
+			EMIT2(add_1mod(0x48, dst_reg), add_1reg(0xB8, dst_reg));
+			EMIT((u32) imm64, 4);
+			EMIT(imm64 >> 32, 4);
+			insn++;
+			i++;
+			break;
+
+			/* dst %= src, dst /= src, dst %= imm32, dst /= imm32 */
+		case BPF_ALU | BPF_MOD | BPF_X:
+		case BPF_ALU | BPF_DIV | BPF_X:
+		case BPF_ALU | BPF_MOD | BPF_K:
+		case BPF_ALU | BPF_DIV | BPF_K:
+		case BPF_ALU64 | BPF_MOD | BPF_X:
+		case BPF_ALU64 | BPF_DIV | BPF_X:
+		case BPF_ALU64 | BPF_MOD | BPF_K:
+		case BPF_ALU64 | BPF_DIV | BPF_K:
+			/* dst *= src, dst *= imm32 */
+		case BPF_ALU | BPF_MUL | BPF_K:
+		case BPF_ALU | BPF_MUL | BPF_X:
+		case BPF_ALU64 | BPF_MUL | BPF_K:
+		case BPF_ALU64 | BPF_MUL | BPF_X:
+			EMIT1(0x50); /* push rax */
+			EMIT1(0x52); /* push rdx */
+
+			/* r11 = divisor or multiplier, zero extended for
+			 * 32-bit operations
+			 */
+			if (BPF_SRC(insn->code) == BPF_X) {
+				if (alu64)
+					EMIT1(add_2mod(0x48, AUX_REG, src_reg));
+				else
+					EMIT1(add_2mod(0x40, AUX_REG, src_reg));
+				EMIT2(0x89, add_2reg(0xC0, AUX_REG, src_reg));
+			} else if (alu64) {
+				/* mov r11, imm32 */
+				EMIT3_off32(0x49, 0xC7, 0xC3, imm32);
+			} else {
+				/* mov r11d, imm32 */
+				EMIT2_off32(0x41, 0xBB, imm32);
+			}
+
+			/* mov rax, dst */
+			if (alu64)
+				EMIT1(add_2mod(0x48, BPF_REG_0, dst_reg));
+			else if (is_ereg(dst_reg))
+				EMIT1(add_2mod(0x40, BPF_REG_0, dst_reg));
+			EMIT2(0x89, add_2reg(0xC0, BPF_REG_0, dst_reg));
+
+			if (BPF_OP(insn->code) != BPF_MUL &&
+			    BPF_SRC(insn->code) == BPF_X) {
+				/* if (src == 0) return 0 */
+				EMIT4(0x49, 0x83, 0xFB, 0x00); /* cmp r11,0 */
+				/* jne .+9 (skip over pop, pop, xor and jmp) */
+				EMIT2(X86_JNE, 1 + 1 + 2 + 5);
+				EMIT1(0x5A); /* pop rdx */
+				EMIT1(0x58); /* pop rax */
+				EMIT2(0x31, 0xC0); /* xor eax,eax */
+
+				/* 13 bytes follow this jmp: xor, div, mov,
+				 * pop, pop and mov
+				 */
+				jmp_offset = *cleanup_addr - (addrs[i] - 13);
+				EMIT1_off32(0xE9, jmp_offset);
+			}
+
+			if (BPF_OP(insn->code) == BPF_MUL) {
+				/* mul r11 */
+				EMIT3(alu64 ? 0x49 : 0x41, 0xF7, 0xE3);
+			} else {
+				EMIT2(0x31, 0xD2); /* xor edx,edx */
+				/* div r11 */
+				EMIT3(alu64 ? 0x49 : 0x41, 0xF7, 0xF3);
+			}
+
+			if (BPF_OP(insn->code) == BPF_MOD)
+				EMIT3(0x49, 0x89, 0xD3); /* mov r11,rdx */
+			else
+				EMIT3(0x49, 0x89, 0xC3); /* mov r11,rax */
+
+			EMIT1(0x5A); /* pop rdx */
+			EMIT1(0x58); /* pop rax */
+
+			/* mov dst, r11 */
+			EMIT3(add_2mod(0x48, dst_reg, AUX_REG), 0x89,
+			      add_2reg(0xC0, dst_reg, AUX_REG));
+			break;
+
+			/* shifts */
+		case BPF_ALU | BPF_LSH | BPF_K:
+		case BPF_ALU | BPF_RSH | BPF_K:
+		case BPF_ALU | BPF_ARSH | BPF_K:
+		case BPF_ALU64 | BPF_LSH | BPF_K:
+		case BPF_ALU64 | BPF_RSH | BPF_K:
+		case BPF_ALU64 | BPF_ARSH | BPF_K:
+			if (alu64)
+				EMIT1(add_1mod(0x48, dst_reg));
+			else if (is_ereg(dst_reg))
+				EMIT1(add_1mod(0x40, dst_reg));
+
+			switch (BPF_OP(insn->code)) {
+			case BPF_LSH: b3 = 0xE0; break;
+			case BPF_RSH: b3 = 0xE8; break;
+			case BPF_ARSH: b3 = 0xF8; break;
+			}
+			EMIT3(0xC1, add_1reg(b3, dst_reg), imm32);
+			break;
+
+		case BPF_ALU | BPF_LSH | BPF_X:
+		case BPF_ALU | BPF_RSH | BPF_X:
+		case BPF_ALU | BPF_ARSH | BPF_X:
+		case BPF_ALU64 | BPF_LSH | BPF_X:
+		case BPF_ALU64 | BPF_RSH | BPF_X:
+		case BPF_ALU64 | BPF_ARSH | BPF_X:
+			/* the shift count must be in cl, which is R4 */
+			if (dst_reg == BPF_REG_4) {
+				/* mov r11, dst */
+				EMIT3(0x49, 0x89, 0xCB);
+				target = AUX_REG;
+			}
+			if (src_reg != BPF_REG_4) {
+				EMIT1(0x51); /* push rcx */
+				/* mov rcx, src */
+				EMIT3(add_2mod(0x48, BPF_REG_4, src_reg), 0x89,
+				      add_2reg(0xC0, BPF_REG_4, src_reg));
+			}
+
+			if (alu64)
+				EMIT1(add_1mod(0x48, target));
+			else if (is_ereg(target))
+				EMIT1(add_1mod(0x40, target));
+
+			switch (BPF_OP(insn->code)) {
+			case BPF_LSH: b3 = 0xE0; break;
+			case BPF_RSH: b3 = 0xE8; break;
+			case BPF_ARSH: b3 = 0xF8; break;
+			}
+			EMIT2(0xD3, add_1reg(b3, target)); /* shift by cl */
+
+			if (src_reg != BPF_REG_4)
+				EMIT1(0x59); /* pop rcx */
+			if (dst_reg == BPF_REG_4)
+				EMIT3(0x4C, 0x89, 0xD9); /* mov rcx, r11 */
+			break;
+
+		case BPF_ALU | BPF_END | BPF_TO_BE:
+			switch (imm32) {
+			case 16:
+				/* rol dst16, 8 */
+				EMIT1(0x66);
+				if (is_ereg(dst_reg))
+					EMIT1(0x41);
+				EMIT3(0xC1, add_1reg(0xC0, dst_reg), 8);
+				goto zero_extend_16;
+			case 32:
+				/* bswap dst32 */
+				if (is_ereg(dst_reg))
+					EMIT1(0x41);
+				EMIT2(0x0F, add_1reg(0xC8, dst_reg));
+				break;
+			case 64:
+				/* bswap dst64 */
+				EMIT3(add_1mod(0x48, dst_reg), 0x0F,
+				      add_1reg(0xC8, dst_reg));
+				break;
+			}
+			break;
+
+		case BPF_ALU | BPF_END | BPF_TO_LE:
+			switch (imm32) {
+			case 16:
+zero_extend_16:
+				/* movzwl dst, dst16 */
+				if (is_ereg(dst_reg))
+					EMIT1(add_2mod(0x40, dst_reg, dst_reg));
+				EMIT3(0x0F, 0xB7, add_2reg(0xC0, dst_reg, dst_reg));
+				break;
+			case 32:
+				/* mov dst32, dst32 clears the upper half */
+				if (is_ereg(dst_reg))
+					EMIT1(add_2mod(0x40, dst_reg, dst_reg));
+				EMIT2(0x89, add_2reg(0xC0, dst_reg, dst_reg));
+				break;
+			case 64:
+				/* nop */
+				break;
+			}
+			break;
+
+			/* ST: *(u8*)(dst_reg + off) = imm */
+		case BPF_ST | BPF_MEM | BPF_B:
+			if (is_ereg(dst_reg))
+				EMIT1(0x41);
+			EMIT1(0xC6);
+			goto st;
+		case BPF_ST | BPF_MEM | BPF_H:
+			EMIT1(0x66);
+			if (is_ereg(dst_reg))
+				EMIT1(0x41);
+			EMIT1(0xC7);
+			goto st;
+		case BPF_ST | BPF_MEM | BPF_W:
+			if (is_ereg(dst_reg))
+				EMIT1(0x41);
+			EMIT1(0xC7);
+			goto st;
+		case BPF_ST | BPF_MEM | BPF_DW:
+			EMIT2(add_1mod(0x48, dst_reg), 0xC7);
+
+st:			if (is_imm8(insn->off))
+				EMIT2(add_1reg(0x40, dst_reg), insn->off);
+			else
+				EMIT1_off32(add_1reg(0x80, dst_reg), insn->off);
+
+			EMIT(imm32, bpf_size_to_x86_bytes(BPF_SIZE(insn->code)));
+			break;
+
+			/* STX: *(u8*)(dst_reg + off) = src_reg */
+		case BPF_STX | BPF_MEM | BPF_B:
+			/* sil and dil need a REX prefix */
+			if (is_ereg(dst_reg) || is_ereg(src_reg) ||
+			    src_reg == BPF_REG_1 || src_reg == BPF_REG_2)
+				EMIT1(add_2mod(0x40, dst_reg, src_reg));
+			EMIT1(0x88);
+			goto stx;
+		case BPF_STX | BPF_MEM | BPF_H:
+			EMIT1(0x66);
+			if (is_ereg(dst_reg) || is_ereg(src_reg))
+				EMIT1(add_2mod(0x40, dst_reg, src_reg));
+			EMIT1(0x89);
+			goto stx;
+		case BPF_STX | BPF_MEM | BPF_W:
+			if (is_ereg(dst_reg) || is_ereg(src_reg))
+				EMIT1(add_2mod(0x40, dst_reg, src_reg));
+			EMIT1(0x89);
+			goto stx;
+		case BPF_STX | BPF_MEM | BPF_DW:
+			EMIT2(add_2mod(0x48, dst_reg, src_reg), 0x89);
+stx:			EMIT_MEM(dst_reg, src_reg, insn->off);
+			break;
+
+			/* LDX: dst_reg = *(u8*)(src_reg + off) */
+		case BPF_LDX | BPF_MEM | BPF_B:
+			/* movzx dst, byte [src + off] */
+			EMIT3(add_2mod(0x48, src_reg, dst_reg), 0x0F, 0xB6);
+			goto ldx;
+		case BPF_LDX | BPF_MEM | BPF_H:
+			/* movzx dst, word [src + off] */
+			EMIT3(add_2mod(0x48, src_reg, dst_reg), 0x0F, 0xB7);
+			goto ldx;
+		case BPF_LDX | BPF_MEM | BPF_W:
+			/* mov dst32, dword [src + off] zero extends */
+			if (is_ereg(dst_reg) || is_ereg(src_reg))
+				EMIT1(add_2mod(0x40, src_reg, dst_reg));
+			EMIT1(0x8B);
+			goto ldx;
+		case BPF_LDX | BPF_MEM | BPF_DW:
+			EMIT2(add_2mod(0x48, src_reg, dst_reg), 0x8B);
+ldx:			EMIT_MEM(src_reg, dst_reg, insn->off);
+			break;
+
+			/* STX XADD: lock *(u32*)(dst_reg + off) += src_reg */
+		case BPF_STX | BPF_XADD | BPF_W:
+			EMIT1(0xF0); /* lock prefix */
+			if (is_ereg(dst_reg) || is_ereg(src_reg))
+				EMIT1(add_2mod(0x40, dst_reg, src_reg));
+			EMIT1(0x01);
+			EMIT_MEM(dst_reg, src_reg, insn->off);
+			break;
+		case BPF_STX | BPF_XADD | BPF_DW:
+			EMIT3(0xF0, add_2mod(0x48, dst_reg, src_reg), 0x01);
+			EMIT_MEM(dst_reg, src_reg, insn->off);
+			break;
+
+			/* call */
+		case BPF_JMP | BPF_CALL:
+			EMIT_CALL(__bpf_call_base + imm32);
+			break;
+
+			/* cond jump */
+		case BPF_JMP | BPF_JEQ | BPF_X:
+		case BPF_JMP | BPF_JNE | BPF_X:
+		case BPF_JMP | BPF_JGT | BPF_X:
+		case BPF_JMP | BPF_JGE | BPF_X:
+		case BPF_JMP | BPF_JSGT | BPF_X:
+		case BPF_JMP | BPF_JSGE | BPF_X:
+			/* cmp dst, src */
+			EMIT3(add_2mod(0x48, dst_reg, src_reg), 0x39,
+			      add_2reg(0xC0, dst_reg, src_reg));
+			goto emit_cond_jmp;
+
+		case BPF_JMP | BPF_JSET | BPF_X:
+			/* test dst, src */
+			EMIT3(add_2mod(0x48, dst_reg, src_reg), 0x85,
+			      add_2reg(0xC0, dst_reg, src_reg));
+			goto emit_cond_jmp;
+
+		case BPF_JMP | BPF_JSET | BPF_K:
+			/* test dst, imm32 */
+			EMIT1(add_1mod(0x48, dst_reg));
+			EMIT2_off32(0xF7, add_1reg(0xC0, dst_reg), imm32);
+			goto emit_cond_jmp;
+
+		case BPF_JMP | BPF_JEQ | BPF_K:
+		case BPF_JMP | BPF_JNE | BPF_K:
+		case BPF_JMP | BPF_JGT | BPF_K:
+		case BPF_JMP | BPF_JGE | BPF_K:
+		case BPF_JMP | BPF_JSGT | BPF_K:
+		case BPF_JMP | BPF_JSGE | BPF_K:
+			/* cmp dst, imm32 */
+			EMIT1(add_1mod(0x48, dst_reg));
+			if (is_imm8(imm32))
+				EMIT3(0x83, add_1reg(0xF8, dst_reg), imm32);
+			else
+				EMIT2_off32(0x81, add_1reg(0xF8, dst_reg), imm32);
+
+emit_cond_jmp:		/* convert BPF opcode to x86 */
+			switch (BPF_OP(insn->code)) {
+			case BPF_JEQ:
+				jmp_cond = X86_JE;
+				break;
+			case BPF_JSET:
+			case BPF_JNE:
+				jmp_cond = X86_JNE;
+				break;
+			case BPF_JGT:
+				/* GT is unsigned '>', JA in x86 */
+				jmp_cond = X86_JA;
+				break;
+			case BPF_JGE:
+				/* GE is unsigned '>=', JAE in x86 */
+				jmp_cond = X86_JAE;
+				break;
+			case BPF_JSGT:
+				/* signed '>', GT in x86 */
+				jmp_cond = X86_JG;
+				break;
+			default: /* BPF_JSGE */
+				/* signed '>=', GE in x86 */
+				jmp_cond = X86_JGE;
+				break;
+			}
+			jmp_offset = addrs[i + insn->off] - addrs[i];
+			EMIT_COND_JMP(jmp_cond, jmp_offset);
+			break;
+
+		case BPF_JMP | BPF_JA:
+			jmp_offset = addrs[i + insn->off] - addrs[i];
+			/* jumps to the next insn are optimized out */
+			EMIT_JMP(jmp_offset);
+			break;
+
+		case BPF_LD | BPF_IND | BPF_W:
+		case BPF_LD | BPF_IND | BPF_H:
+		case BPF_LD | BPF_IND | BPF_B:
+			/* esi = src32 + imm32, before rdi is overwritten */
+			if (src_reg != BPF_REG_2) {
+				if (is_ereg(src_reg))
+					EMIT1(add_2mod(0x40, BPF_REG_2, src_reg));
+				EMIT2(0x89, add_2reg(0xC0, BPF_REG_2, src_reg));
+			}
+			if (imm32)
+				EMIT2_off32(0x81, 0xC6, imm32); /* add esi,imm32 */
+			goto emit_ld_skb;
+
+		case BPF_LD | BPF_ABS | BPF_W:
+		case BPF_LD | BPF_ABS | BPF_H:
+		case BPF_LD | BPF_ABS | BPF_B:
+			EMIT1_off32(0xBE, imm32); /* mov esi,imm32 */
+emit_ld_skb:
+			EMIT3(0x48, 0x89, 0xDF); /* mov rdi,rbx (skb in R6) */
+			/* mov edx,size */
+			EMIT1_off32(0xBA, bpf_size_to_x86_bytes(BPF_SIZE(insn->code)));
+			EMIT_CALL(bpf_load_skb);
+			/* out of the packet: return 0 */
+			EMIT4(0x48, 0x83, 0xF8, 0xFF); /* cmp rax,-1 */
+			EMIT2(X86_JNE, 2 + 5); /* jne .+7 */
+			EMIT2(0x31, 0xC0); /* xor eax,eax */
+			jmp_offset = *cleanup_addr - addrs[i];
+			EMIT1_off32(0xE9, jmp_offset);
+			break;
+
+		case BPF_JMP | BPF_EXIT:
+			if (i != insn_cnt - 1) {
+				jmp_offset = *cleanup_addr - addrs[i];
+				EMIT_JMP(jmp_offset);
+			}
+			/* the last insn falls through into the epilogue */
+			break;
+
+		default:
+			/* the verifier accepted an insn this JIT does not
+			 * know about, stay with the interpreter
+			 */
+			pr_err("bpf_jit: unknown opcode %02x\n", insn->code);
+			return -EINVAL;
+		}
+
+		ilen = prog - temp;
+		if (image) {
+			if (unlikely(proglen + ilen > oldproglen)) {
+				pr_err("bpf_jit_compile fatal error\n");
+				return -EFAULT;
+			}
+			memcpy(image + proglen, temp, ilen);
+		}
+		proglen += ilen;
+		addrs[i] = proglen;
+		prog = temp;
+	}
+
+	/* epilogue */
+	*cleanup_addr = proglen;
+	EMIT3_off32(0x48, 0x8B, 0x9D, -EBPF_STACKSIZE); /* mov rbx,[rbp-X] */
+	EMIT3_off32(0x4C, 0x8B, 0xAD, -EBPF_STACKSIZE + 8); /* mov r13,[rbp-X] */
+	EMIT3_off32(0x4C, 0x8B, 0xB5, -EBPF_STACKSIZE + 16); /* mov r14,[rbp-X] */
+	EMIT3_off32(0x4C, 0x8B, 0xBD, -EBPF_STACKSIZE + 24); /* mov r15,[rbp-X] */
+	EMIT1(0xC9); /* leave */
+	EMIT1(0xC3); /* ret */
+
+	ilen = prog - temp;
+	if (image) {
+		if (unlikely(proglen + ilen > oldproglen)) {
+			pr_err("bpf_jit_compile fatal error\n");
+			return -EFAULT;
+		}
+		memcpy(image + proglen, temp, ilen);
+	}
+	proglen += ilen;
+	return proglen;
+}
+
+void bpf_int_jit_compile(struct bpf_prog *prog)
+{
+	int proglen, oldproglen = 0, cleanup_addr;
+	u8 *image = NULL;
+	int *addrs;
+	int pass, i;
+
+	if (!bpf_jit_enable)
+		return;
+
+	addrs = kmalloc(prog->len * sizeof(*addrs), GFP_KERNEL);
+	if (!addrs)
+		return;
+
+	/* Before the first pass, make a rough estimation of addrs[]:
+	 * each eBPF instruction is translated to less than 64 bytes.
+	 * Jumps only get shorter from one pass to the next.
+	 */
+	for (proglen = 0, i = 0; i < prog->len; i++) {
+		proglen += 64;
+		addrs[i] = proglen;
+	}
+	cleanup_addr = proglen;
+
+	for (pass = 0; pass < 10; pass++) {
+		proglen = do_ebpf_jit(prog, addrs, image, oldproglen,
+				      &cleanup_addr);
+		if (proglen <= 0) {
+			if (image)
+				module_free(NULL, image);
+			image = NULL;
+			goto out;
+		}
+		if (image) {
+			if (proglen != oldproglen) {
+				pr_err("bpf_jit: proglen=%d != oldproglen=%d\n",
+				       proglen, oldproglen);
+				module_free(NULL, image);
+				image = NULL;
+			}
+			break;
+		}
+		if (proglen == oldproglen) {
+			image = module_alloc(proglen);
+			if (!image)
+				goto out;
+		}
+		oldproglen = proglen;
+	}
+
+	if (bpf_jit_enable > 1)
+		pr_err("flen=%d proglen=%d pass=%d image=%p\n",
+		       prog->len, proglen, pass, image);
+
+	if (image) {
+		if (bpf_jit_enable > 1)
+			print_hex_dump(KERN_ERR, "JIT code: ", DUMP_PREFIX_ADDRESS,
+				       16, 1, image, proglen, false);
+
+		bpf_flush_icache(image, image + proglen);
+
+		prog->bpf_func = (void *)image;
+		prog->jited = true;
+	}
+out:
+	kfree(addrs);
+}
+
+/* called from process context, after the last user of the program */
+void bpf_int_jit_free(struct bpf_prog *prog)
+{
+	module_free(NULL, prog->bpf_func);
+}
+#endif /* CONFIG_BPF_SYSCALL */
@@ -179,6 +179,23 @@ static inline void blkio_update_group_iops(struct blkio_group *blkg,
 	}
 }
 
+static inline void blkio_update_group_latency(struct blkio_group *blkg,
+			unsigned int target_us)
+{
+	struct blkio_policy_type *blkiop;
+
+	list_for_each_entry(blkiop, &blkio_list, list) {
+
+		/* If this policy does not own the blkg, do not send updates */
+		if (blkiop->plid != blkg->plid)
+			continue;
+
+		if (blkiop->ops.blkio_update_group_latency_fn)
+			blkiop->ops.blkio_update_group_latency_fn(blkg->key,
+							blkg, target_us);
+	}
+}
+
 /*
  * Add to the appropriate stat variable depending on the request type.
  * This should be called with the blkg->stats_lock held.
@@ -855,6 +872,14 @@ static int blkio_policy_parse_and_set(char *buf,
 			break;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		if (temp > UINT_MAX)
+			goto out;
+
+		newpn->plid = plid;
+		newpn->fileid = fileid;
+		newpn->val.latency = (unsigned int)temp;
+		break;
 	default:
 		BUG();
 	}
@@ -950,6 +975,23 @@ unsigned int blkcg_get_write_iops(struct blkio_cgroup *blkcg, dev_t dev)
 	return iops;
 }
 
+/* Returns the latency target in microseconds, 0 if there is none */
+unsigned int blkcg_get_latency_target(struct blkio_cgroup *blkcg, dev_t dev)
+{
+	struct blkio_policy_node *pn;
+	unsigned long flags;
+	unsigned int target_us = 0;
+
+	spin_lock_irqsave(&blkcg->lock, flags);
+	pn = blkio_policy_search_node(blkcg, dev, BLKIO_POLICY_LATENCY,
+				BLKIO_LATENCY_target_device);
+	if (pn)
+		target_us = pn->val.latency;
+	spin_unlock_irqrestore(&blkcg->lock, flags);
+
+	return target_us;
+}
+
 /* Checks whether user asked for deleting a policy rule */
 static bool blkio_delete_rule_command(struct blkio_policy_node *pn)
 {
@@ -971,6 +1013,10 @@ static bool blkio_delete_rule_command(struct blkio_policy_node *pn)
 				return 1;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		if (pn->val.latency == 0)
+			return 1;
+		break;
 	default:
 		BUG();
 	}
@@ -996,6 +1042,9 @@ static void blkio_update_policy_rule(struct blkio_policy_node *oldpn,
 			oldpn->val.iops = newpn->val.iops;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		oldpn->val.latency = newpn->val.latency;
+		break;
 	default:
 		BUG();
 	}
@@ -1031,6 +1080,9 @@ static void blkio_update_blkg_policy(struct blkio_cgroup *blkcg,
 			break;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		blkio_update_group_latency(blkg, pn->val.latency);
+		break;
 	default:
 		BUG();
 	}
@@ -1142,6 +1194,10 @@ blkio_print_policy_node(struct seq_file *m, struct blkio_policy_node *pn)
 				break;
 			}
 			break;
+		case BLKIO_POLICY_LATENCY:
+			seq_printf(m, "%u:%u\t%u\n", MAJOR(pn->dev),
+				MINOR(pn->dev), pn->val.latency);
+			break;
 		default:
 			BUG();
 	}
@@ -1195,6 +1251,15 @@ static int blkiocg_file_read(struct cgroup *cgrp, struct cftype *cft,
 			BUG();
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		switch(name) {
+		case BLKIO_LATENCY_target_device:
+			blkio_read_policy_node_files(cft, blkcg, m);
+			return 0;
+		default:
+			BUG();
+		}
+		break;
 	default:
 		BUG();
 	}
@@ -1499,6 +1564,17 @@ struct cftype blkio_files[] = {
 	},
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+#ifdef CONFIG_BLK_DEV_IOLATENCY
+	{
+		.name = "latency.target_device",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_LATENCY,
+				BLKIO_LATENCY_target_device),
+		.read_seq_string = blkiocg_file_read,
+		.write_string = blkiocg_file_write,
+		.max_write_len = 256,
+	},
+#endif /* CONFIG_BLK_DEV_IOLATENCY */
+
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	{
 		.name = "avg_queue_size",
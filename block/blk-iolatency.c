@@ -0,0 +1,609 @@
+/*
+ * Interface for keeping the IO latency of a cgroup below a target
+ *
+ * A group with a latency target on a device is protected.  The completion
+ * latencies of its requests are sampled over a window, and if more than 1%
+ * of them exceeded the target (its p99 is over target) the number of
+ * requests that each group with no target, or a looser one, may have in
+ * flight on the device is halved.  Once no protected group has missed its
+ * target for two windows, throttled groups get their depth back a quarter
+ * at a time.
+ *
+ * Only the number of requests in flight is limited, so this works on top
+ * of any elevator, and on multi-queue devices, but not on bio based ones.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/blktrace_api.h>
+#include "blk-cgroup.h"
+#include "blk.h"
+
+/* Latencies are judged over windows of this length */
+static unsigned long iolat_window = HZ/10;	/* 100 ms */
+
+/* Windows with fewer completions than this are not judged */
+static unsigned int iolat_min_samples = 16;
+
+struct iolat_grp {
+	/* List of iolat groups on the request queue */
+	struct hlist_node grp_node;
+
+	struct blkio_group blkg;
+	atomic_t ref;
+
+	/* Latency target in usecs, 0 if this group is not protected */
+	unsigned int target_us;
+
+	/* Requests this group may have in flight, UINT_MAX if unlimited */
+	unsigned int max_depth;
+	atomic_t inflight;
+	wait_queue_head_t wait;
+
+	/* Current sampling window */
+	unsigned long window_start;
+	atomic_t nr_samples;
+	atomic_t nr_missed;
+
+	struct rcu_head rcu_head;
+};
+
+struct iolat_data {
+	/* Protects grp_list and the depth of the groups on it */
+	spinlock_t lock;
+
+	/* List of iolat groups */
+	struct hlist_head grp_list;
+
+	struct iolat_grp *root_grp;
+	struct request_queue *queue;
+
+	/* Number of groups with a latency target */
+	atomic_t nr_protected;
+
+	/* When a protected group last missed its target */
+	unsigned long last_miss;
+
+	/*
+	 * number of total undestroyed groups
+	 */
+	unsigned int nr_undestroyed_grps;
+};
+
+#define iolat_log_grp(iolat, grp, fmt, args...)				\
+	blk_add_trace_msg((iolat)->queue, "iolat %s " fmt,		\
+				blkg_path(&(grp)->blkg), ##args)
+
+static inline struct iolat_grp *grp_of_blkg(struct blkio_group *blkg)
+{
+	if (blkg)
+		return container_of(blkg, struct iolat_grp, blkg);
+
+	return NULL;
+}
+
+static void iolat_free_grp(struct rcu_head *head)
+{
+	struct iolat_grp *grp;
+
+	grp = container_of(head, struct iolat_grp, rcu_head);
+	free_percpu(grp->blkg.stats_cpu);
+	kfree(grp);
+}
+
+static void iolat_put_grp(struct iolat_grp *grp)
+{
+	BUG_ON(atomic_read(&grp->ref) <= 0);
+	if (!atomic_dec_and_test(&grp->ref))
+		return;
+
+	/*
+	 * Lookups walk the cgroup list under rcu, and may still see the
+	 * group after it was unlinked.
+	 */
+	call_rcu(&grp->rcu_head, iolat_free_grp);
+}
+
+static struct iolat_grp *iolat_alloc_grp(struct iolat_data *iolat, gfp_t gfp)
+{
+	struct iolat_grp *grp;
+
+	grp = kzalloc_node(sizeof(*grp), gfp, iolat->queue->node);
+	if (!grp)
+		return NULL;
+
+	if (blkio_alloc_blkg_stats(&grp->blkg)) {
+		kfree(grp);
+		return NULL;
+	}
+
+	INIT_HLIST_NODE(&grp->grp_node);
+	grp->max_depth = UINT_MAX;
+	atomic_set(&grp->inflight, 0);
+	init_waitqueue_head(&grp->wait);
+	grp->window_start = jiffies;
+	atomic_set(&grp->nr_samples, 0);
+	atomic_set(&grp->nr_missed, 0);
+
+	/*
+	 * Take the initial reference that will be released on destroy,
+	 * either by request queue exit or by cgroup deletion, whichever
+	 * comes first.
+	 */
+	atomic_set(&grp->ref, 1);
+	return grp;
+}
+
+static void iolat_set_target(struct iolat_data *iolat, struct iolat_grp *grp,
+			     unsigned int target_us)
+{
+	unsigned int old = xchg(&grp->target_us, target_us);
+
+	if (!old && target_us)
+		atomic_inc(&iolat->nr_protected);
+	else if (old && !target_us)
+		atomic_dec(&iolat->nr_protected);
+}
+
+/*
+ * The root group is created with the queue, before the driver attached a
+ * device to it.  Fill in the device, and the root cgroup's target for it,
+ * on first use.
+ */
+static void iolat_fill_dev_details(struct iolat_data *iolat,
+				   struct iolat_grp *grp)
+{
+	struct backing_dev_info *bdi = &iolat->queue->backing_dev_info;
+	unsigned int major, minor;
+	unsigned long flags;
+
+	spin_lock_irqsave(&iolat->lock, flags);
+	if (!grp->blkg.dev && bdi->dev && dev_name(bdi->dev)) {
+		sscanf(dev_name(bdi->dev), "%u:%u", &major, &minor);
+		grp->blkg.dev = MKDEV(major, minor);
+		if (grp == iolat->root_grp)
+			iolat_set_target(iolat, grp,
+				blkcg_get_latency_target(&blkio_root_cgroup,
+							 grp->blkg.dev));
+	}
+	spin_unlock_irqrestore(&iolat->lock, flags);
+}
+
+/* Called with iolat->lock held and under rcu_read_lock() */
+static void iolat_add_grp(struct iolat_data *iolat, struct iolat_grp *grp,
+			  struct blkio_cgroup *blkcg)
+{
+	struct backing_dev_info *bdi = &iolat->queue->backing_dev_info;
+	unsigned int major, minor;
+
+	if (bdi->dev && dev_name(bdi->dev)) {
+		sscanf(dev_name(bdi->dev), "%u:%u", &major, &minor);
+		grp->blkg.dev = MKDEV(major, minor);
+	}
+
+	blkiocg_add_blkio_group(blkcg, &grp->blkg, (void *)iolat,
+				grp->blkg.dev, BLKIO_POLICY_LATENCY);
+	iolat_set_target(iolat, grp,
+			 blkcg_get_latency_target(blkcg, grp->blkg.dev));
+
+	hlist_add_head(&grp->grp_node, &iolat->grp_list);
+	iolat->nr_undestroyed_grps++;
+}
+
+/* Called under rcu_read_lock() */
+static struct iolat_grp *iolat_find_grp(struct iolat_data *iolat,
+					struct blkio_cgroup *blkcg)
+{
+	struct iolat_grp *grp;
+
+	/*
+	 * This is the common case when there are no blkio cgroups.
+	 * Avoid lookup in this case
+	 */
+	if (blkcg == &blkio_root_cgroup)
+		grp = iolat->root_grp;
+	else
+		grp = grp_of_blkg(blkiocg_lookup_group(blkcg, iolat));
+
+	if (grp && unlikely(!grp->blkg.dev))
+		iolat_fill_dev_details(iolat, grp);
+	return grp;
+}
+
+/*
+ * Look up, or create, the group of the current task and return it with a
+ * reference held.  Must be called from process context with no locks held.
+ */
+static struct iolat_grp *iolat_get_grp(struct iolat_data *iolat)
+{
+	struct request_queue *q = iolat->queue;
+	struct iolat_grp *grp, *new;
+
+	/* no groups for dead queue */
+	if (unlikely(blk_queue_dead(q)))
+		return NULL;
+
+	rcu_read_lock();
+	grp = iolat_find_grp(iolat, task_blkio_cgroup(current));
+	if (grp && atomic_inc_not_zero(&grp->ref)) {
+		rcu_read_unlock();
+		return grp;
+	}
+	rcu_read_unlock();
+
+	/* Allocating the per cpu stats may block */
+	new = iolat_alloc_grp(iolat, GFP_NOIO);
+
+	spin_lock_irq(&iolat->lock);
+	rcu_read_lock();
+
+	/*
+	 * Read the cgroup again, and check that nobody else added the group
+	 * while we were allocating.
+	 */
+	grp = iolat_find_grp(iolat, task_blkio_cgroup(current));
+	if (!grp) {
+		/* Group allocation failed. Account the IO to root group */
+		grp = new ? new : iolat->root_grp;
+		if (grp == new) {
+			iolat_add_grp(iolat, new,
+				      task_blkio_cgroup(current));
+			new = NULL;
+		}
+	}
+	if (!atomic_inc_not_zero(&grp->ref))
+		grp = NULL;
+
+	rcu_read_unlock();
+	spin_unlock_irq(&iolat->lock);
+
+	if (new)
+		iolat_put_grp(new);
+	return grp;
+}
+
+static inline bool iolat_may_queue(struct iolat_data *iolat,
+				   struct iolat_grp *grp)
+{
+	return atomic_read(&grp->inflight) < ACCESS_ONCE(grp->max_depth) ||
+		!atomic_read(&iolat->nr_protected);
+}
+
+static void iolat_wait(struct iolat_data *iolat, struct iolat_grp *grp)
+{
+	DEFINE_WAIT(wait);
+
+	/*
+	 * Our own requests may be sitting on the plug; io_schedule()
+	 * flushes it before we sleep.
+	 */
+	for (;;) {
+		prepare_to_wait(&grp->wait, &wait, TASK_UNINTERRUPTIBLE);
+		if (iolat_may_queue(iolat, grp))
+			break;
+		io_schedule();
+	}
+	finish_wait(&grp->wait, &wait);
+}
+
+/*
+ * Group @victim missed its target: halve the depth of every group that
+ * has no target, or a looser one.  Called with iolat->lock held.
+ */
+static void iolat_scale_down(struct iolat_data *iolat,
+			     struct iolat_grp *victim)
+{
+	struct iolat_grp *grp;
+	struct hlist_node *n;
+	unsigned int depth;
+
+	hlist_for_each_entry(grp, n, &iolat->grp_list, grp_node) {
+		if (grp == victim)
+			continue;
+		if (grp->target_us && grp->target_us <= victim->target_us)
+			continue;
+
+		depth = grp->max_depth;
+		if (depth == UINT_MAX)
+			depth = iolat->queue->nr_requests;
+		depth = max(depth / 2, 1U);
+
+		if (depth != grp->max_depth) {
+			grp->max_depth = depth;
+			iolat_log_grp(iolat, grp, "depth down to %u", depth);
+		}
+	}
+
+	iolat->last_miss = jiffies;
+}
+
+/* Called with iolat->lock held */
+static void iolat_scale_up(struct iolat_data *iolat, struct iolat_grp *grp)
+{
+	unsigned int depth = grp->max_depth;
+
+	depth += max(depth / 4, 1U);
+	if (depth >= iolat->queue->nr_requests)
+		depth = UINT_MAX;
+
+	grp->max_depth = depth;
+	iolat_log_grp(iolat, grp, "depth up to %u", depth);
+	wake_up_all(&grp->wait);
+}
+
+/*
+ * Close the sampling window of @grp if it has run out.  A protected group
+ * judges its own latencies; a throttled group takes back some depth if
+ * nobody missed lately.
+ */
+static void iolat_check_window(struct iolat_data *iolat, struct iolat_grp *grp)
+{
+	unsigned long start = grp->window_start, now = jiffies;
+	unsigned int samples, missed;
+	unsigned long flags;
+
+	if (time_before(now, start + iolat_window))
+		return;
+	if (cmpxchg(&grp->window_start, start, now) != start)
+		return;
+
+	samples = atomic_xchg(&grp->nr_samples, 0);
+	missed = atomic_xchg(&grp->nr_missed, 0);
+
+	spin_lock_irqsave(&iolat->lock, flags);
+
+	if (grp->target_us && samples >= iolat_min_samples &&
+	    missed * 100 > samples) {
+		iolat_log_grp(iolat, grp, "missed target %uus: %u/%u",
+			      grp->target_us, missed, samples);
+		iolat_scale_down(iolat, grp);
+	} else if (grp->max_depth != UINT_MAX &&
+		   time_after_eq(now, iolat->last_miss + 2 * iolat_window))
+		iolat_scale_up(iolat, grp);
+
+	spin_unlock_irqrestore(&iolat->lock, flags);
+}
+
+static void iolat_release_rq(struct request *rq)
+{
+	struct iolat_grp *grp = rq->iolat_grp;
+
+	rq->iolat_grp = NULL;
+
+	atomic_dec(&grp->inflight);
+	if (waitqueue_active(&grp->wait))
+		wake_up(&grp->wait);
+	iolat_put_grp(grp);
+}
+
+/*
+ * Throttle the submitter of @bio while its group has as many requests in
+ * flight on @q as it is allowed.  Called from generic_make_request().
+ */
+void blk_iolat_bio(struct request_queue *q, struct bio *bio)
+{
+	struct iolat_data *iolat = q->iolat;
+	struct iolat_grp *grp;
+
+	/* bio based queues never build requests, there is nothing to count */
+	if (!q->request_fn && !q->mq_ops)
+		return;
+
+	/* already waited for before it was throttled */
+	if (bio->bi_rw & REQ_THROTTLED)
+		return;
+
+	rcu_read_lock();
+	grp = iolat_find_grp(iolat, task_blkio_cgroup(current));
+	if (grp && iolat_may_queue(iolat, grp)) {
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
+	grp = iolat_get_grp(iolat);
+	if (!grp)
+		return;
+
+	iolat_wait(iolat, grp);
+	iolat_put_grp(grp);
+}
+
+/*
+ * Charge @rq to the group of the current task.  Counting only starts once
+ * some group on the queue has a target.
+ */
+void blk_iolat_rq_init(struct request *rq)
+{
+	struct iolat_data *iolat = rq->q->iolat;
+	struct iolat_grp *grp;
+
+	if (!atomic_read(&iolat->nr_protected))
+		return;
+
+	rcu_read_lock();
+	grp = iolat_find_grp(iolat, task_blkio_cgroup(current));
+	if (grp && atomic_inc_not_zero(&grp->ref)) {
+		atomic_inc(&grp->inflight);
+		rq->iolat_grp = grp;
+	}
+	rcu_read_unlock();
+}
+
+void blk_iolat_done(struct request *rq)
+{
+	struct iolat_grp *grp = rq->iolat_grp;
+	unsigned int target_us;
+	u64 now;
+
+	if (!grp)
+		return;
+
+	target_us = ACCESS_ONCE(grp->target_us);
+	if (target_us) {
+		now = sched_clock();
+		if (time_after64(now, rq_start_time_ns(rq))) {
+			atomic_inc(&grp->nr_samples);
+			if (now - rq_start_time_ns(rq) >
+			    (u64)target_us * NSEC_PER_USEC)
+				atomic_inc(&grp->nr_missed);
+		}
+	}
+
+	iolat_check_window(rq->q->iolat, grp);
+	iolat_release_rq(rq);
+}
+
+/* A request that never completed, e.g. merged into another one, is freed */
+void blk_iolat_put_request(struct request *rq)
+{
+	if (rq->iolat_grp)
+		iolat_release_rq(rq);
+}
+
+/* Called with iolat->lock held */
+static void iolat_destroy_grp(struct iolat_data *iolat, struct iolat_grp *grp)
+{
+	/* Something wrong if we are trying to remove same group twice */
+	BUG_ON(hlist_unhashed(&grp->grp_node));
+
+	hlist_del_init(&grp->grp_node);
+	iolat_set_target(iolat, grp, 0);
+
+	/* nobody gets to throttle this group any more */
+	grp->max_depth = UINT_MAX;
+	wake_up_all(&grp->wait);
+
+	/*
+	 * Put the reference taken at the time of creation so that when all
+	 * requests are gone, group can be destroyed.
+	 */
+	iolat_put_grp(grp);
+	iolat->nr_undestroyed_grps--;
+}
+
+static void iolat_release_grps(struct iolat_data *iolat)
+{
+	struct hlist_node *pos, *n;
+	struct iolat_grp *grp;
+
+	hlist_for_each_entry_safe(grp, pos, n, &iolat->grp_list, grp_node) {
+		/*
+		 * If cgroup removal path got to blk_group first and removed
+		 * it from cgroup list, then it will take care of destroying
+		 * the group also.
+		 */
+		if (!blkiocg_del_blkio_group(&grp->blkg))
+			iolat_destroy_grp(iolat, grp);
+	}
+}
+
+/*
+ * Blk cgroup controller notification saying that blkio_group object is being
+ * delinked as associated cgroup object is going away.
+ *
+ * This function is called under rcu_read_lock(); "key" is a valid
+ * iolat_data pointer as long as we are under rcu read lock.
+ */
+static void iolat_unlink_blkio_group(void *key, struct blkio_group *blkg)
+{
+	struct iolat_data *iolat = key;
+	unsigned long flags;
+
+	spin_lock_irqsave(&iolat->lock, flags);
+	iolat_destroy_grp(iolat, grp_of_blkg(blkg));
+	spin_unlock_irqrestore(&iolat->lock, flags);
+}
+
+/*
+ * Called under blkcg->lock, which nests inside iolat->lock, so the target
+ * is updated without taking the latter.
+ */
+static void iolat_update_blkio_group_latency(void *key,
+			struct blkio_group *blkg, unsigned int target_us)
+{
+	iolat_set_target(key, grp_of_blkg(blkg), target_us);
+}
+
+static struct blkio_policy_type blkio_policy_iolat = {
+	.ops = {
+		.blkio_unlink_group_fn = iolat_unlink_blkio_group,
+		.blkio_update_group_latency_fn =
+					iolat_update_blkio_group_latency,
+	},
+	.plid = BLKIO_POLICY_LATENCY,
+};
+
+int blk_iolat_init(struct request_queue *q)
+{
+	struct iolat_data *iolat;
+	struct iolat_grp *grp;
+
+	iolat = kzalloc_node(sizeof(*iolat), GFP_KERNEL, q->node);
+	if (!iolat)
+		return -ENOMEM;
+
+	spin_lock_init(&iolat->lock);
+	INIT_HLIST_HEAD(&iolat->grp_list);
+	atomic_set(&iolat->nr_protected, 0);
+	iolat->last_miss = jiffies - 2 * iolat_window;
+
+	/* alloc and Init root group. */
+	iolat->queue = q;
+	grp = iolat_alloc_grp(iolat, GFP_KERNEL);
+	if (!grp) {
+		kfree(iolat);
+		return -ENOMEM;
+	}
+
+	iolat->root_grp = grp;
+
+	spin_lock_irq(&iolat->lock);
+	rcu_read_lock();
+	iolat_add_grp(iolat, grp, &blkio_root_cgroup);
+	rcu_read_unlock();
+	spin_unlock_irq(&iolat->lock);
+
+	/* Attach iolat data to request queue */
+	q->iolat = iolat;
+	return 0;
+}
+
+void blk_iolat_exit(struct request_queue *q)
+{
+	struct iolat_data *iolat = q->iolat;
+	bool wait;
+
+	BUG_ON(!iolat);
+
+	spin_lock_irq(&iolat->lock);
+	iolat_release_grps(iolat);
+
+	/* If there are other groups */
+	wait = iolat->nr_undestroyed_grps > 0;
+	spin_unlock_irq(&iolat->lock);
+
+	/*
+	 * Wait for grp->blkg->key accessors to exit their grace periods,
+	 * only if the cgroup deletion path claimed a group before us.
+	 */
+	if (wait)
+		synchronize_rcu();
+}
+
+void blk_iolat_release(struct request_queue *q)
+{
+	kfree(q->iolat);
+}
+
+static int __init iolat_init(void)
+{
+	blkio_policy_register(&blkio_policy_iolat);
+	return 0;
+}
+
+module_init(iolat_init);
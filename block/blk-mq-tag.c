@@ -0,0 +1,179 @@
+/*
+ * Tag allocation for the multi-queue block layer
+ *
+ * Each hardware queue owns a bitmap of tags.  Allocation is lock-free: a
+ * per-cpu hint remembers where the last search on this CPU ended, so CPUs
+ * sharing a hardware queue tend to work on different words of the bitmap
+ * and a freed tag is handed back to the next allocation on the same CPU
+ * while it is still cache hot.  Tags below nr_reserved_tags are kept for
+ * callers that must not fail or block behind normal I/O.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bitops.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+
+#include <linux/blk-mq.h>
+#include "blk-mq-tag.h"
+
+struct blk_mq_tags {
+	unsigned int nr_tags;
+	unsigned int nr_reserved_tags;
+
+	unsigned int __percpu *hint;
+	wait_queue_head_t wait;
+
+	unsigned long map[];
+};
+
+static int __blk_mq_get_tag_range(unsigned long *map, unsigned int tag,
+				  unsigned int end)
+{
+	for (;;) {
+		tag = find_next_zero_bit(map, end, tag);
+		if (tag >= end)
+			return -1;
+		if (!test_and_set_bit(tag, map))
+			return tag;
+		tag++;
+	}
+}
+
+static unsigned int __blk_mq_get_tag(struct blk_mq_tags *tags,
+				     unsigned int start, unsigned int end)
+{
+	unsigned int *hint = get_cpu_ptr(tags->hint);
+	unsigned int first = *hint;
+	int tag;
+
+	if (first < start || first >= end)
+		first = start;
+
+	tag = __blk_mq_get_tag_range(tags->map, first, end);
+	if (tag < 0 && first != start)
+		tag = __blk_mq_get_tag_range(tags->map, start, end);
+	if (tag >= 0)
+		*hint = tag + 1;
+
+	put_cpu_ptr(tags->hint);
+	return tag < 0 ? BLK_MQ_TAG_FAIL : tag;
+}
+
+/**
+ * blk_mq_get_tag - allocate a tag
+ * @tags:	tag map of the hardware queue
+ * @gfp:	if __GFP_WAIT is set, sleep until a tag is freed
+ * @reserved:	allocate from the reserved pool
+ *
+ * Returns the tag or %BLK_MQ_TAG_FAIL.
+ */
+unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, gfp_t gfp,
+			    bool reserved)
+{
+	unsigned int start, end, tag;
+	DEFINE_WAIT(wait);
+
+	if (reserved) {
+		if (WARN_ON_ONCE(!tags->nr_reserved_tags))
+			return BLK_MQ_TAG_FAIL;
+		start = 0;
+		end = tags->nr_reserved_tags;
+	} else {
+		start = tags->nr_reserved_tags;
+		end = tags->nr_tags;
+	}
+
+	tag = __blk_mq_get_tag(tags, start, end);
+	if (tag != BLK_MQ_TAG_FAIL || !(gfp & __GFP_WAIT))
+		return tag;
+
+	for (;;) {
+		prepare_to_wait(&tags->wait, &wait, TASK_UNINTERRUPTIBLE);
+		tag = __blk_mq_get_tag(tags, start, end);
+		if (tag != BLK_MQ_TAG_FAIL)
+			break;
+		io_schedule();
+	}
+	finish_wait(&tags->wait, &wait);
+
+	return tag;
+}
+
+void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag)
+{
+	BUG_ON(tag >= tags->nr_tags);
+
+	clear_bit(tag, tags->map);
+	smp_mb__after_clear_bit();
+
+	/* hand the tag back to the next allocation on this CPU */
+	this_cpu_write(*tags->hint, tag);
+
+	if (waitqueue_active(&tags->wait))
+		wake_up(&tags->wait);
+}
+
+bool blk_mq_has_free_tags(struct blk_mq_tags *tags)
+{
+	return find_next_zero_bit(tags->map, tags->nr_tags,
+				  tags->nr_reserved_tags) < tags->nr_tags;
+}
+
+unsigned int blk_mq_tags_busy(struct blk_mq_tags *tags)
+{
+	return bitmap_weight(tags->map, tags->nr_tags);
+}
+
+struct blk_mq_tags *blk_mq_init_tags(unsigned int total_tags,
+				     unsigned int reserved_tags, int node)
+{
+	struct blk_mq_tags *tags;
+	unsigned int nr_tags, i;
+	int cpu;
+
+	if (!total_tags || reserved_tags >= total_tags ||
+	    total_tags > BLK_MQ_MAX_DEPTH) {
+		pr_err("blk-mq: bad tag depth %u (%u reserved)\n",
+		       total_tags, reserved_tags);
+		return NULL;
+	}
+
+	tags = kzalloc_node(sizeof(*tags) +
+			    BITS_TO_LONGS(total_tags) * sizeof(unsigned long),
+			    GFP_KERNEL, node);
+	if (!tags)
+		return NULL;
+
+	tags->hint = alloc_percpu(unsigned int);
+	if (!tags->hint) {
+		kfree(tags);
+		return NULL;
+	}
+
+	tags->nr_tags = total_tags;
+	tags->nr_reserved_tags = reserved_tags;
+	init_waitqueue_head(&tags->wait);
+
+	/*
+	 * Start each CPU's search at a different word, so that CPUs sharing
+	 * the queue don't all fight over the first cacheline of the map.
+	 */
+	nr_tags = total_tags - reserved_tags;
+	i = 0;
+	for_each_possible_cpu(cpu) {
+		*per_cpu_ptr(tags->hint, cpu) = reserved_tags +
+			(i * BITS_PER_LONG) % nr_tags;
+		i++;
+	}
+
+	return tags;
+}
+
+void blk_mq_free_tags(struct blk_mq_tags *tags)
+{
+	free_percpu(tags->hint);
+	kfree(tags);
+}
@@ -0,0 +1,1204 @@
+/*
+ * Multi-queue block layer
+ *
+ * Requests are allocated from, and queued to, a software queue that
+ * belongs to the submitting CPU.  Each software queue is mapped onto one
+ * of the hardware submission queues the driver registered, and running a
+ * hardware queue drains all the software queues mapped to it straight
+ * into the driver's ->queue_rq().  There is no elevator, no queue_lock
+ * and no shared request freelist: every hardware queue has its own
+ * preallocated requests and tag map, so CPUs that submit to different
+ * hardware queues never touch the same cachelines.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/smp.h>
+#include <linux/list_sort.h>
+#include <linux/cpu.h>
+#include <linux/delay.h>
+#include <linux/topology.h>
+#include <linux/completion.h>
+
+#include <trace/events/block.h>
+
+#include <linux/blk-mq.h>
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-tag.h"
+
+static inline struct blk_mq_ctx *__blk_mq_get_ctx(struct request_queue *q,
+						  unsigned int cpu)
+{
+	return per_cpu_ptr(q->queue_ctx, cpu);
+}
+
+/*
+ * The software queue of the submitting CPU.  Preemption is left enabled:
+ * being migrated afterwards only costs some locality, ctx->lock keeps the
+ * queue itself consistent.
+ */
+static inline struct blk_mq_ctx *blk_mq_get_ctx(struct request_queue *q)
+{
+	return __blk_mq_get_ctx(q, raw_smp_processor_id());
+}
+
+/*
+ * Check if any of the ctx's have pending work in this hardware queue
+ */
+static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return !list_empty_careful(&hctx->dispatch) ||
+		find_first_bit(hctx->ctx_map, hctx->nr_ctx) < hctx->nr_ctx;
+}
+
+/*
+ * Mark this ctx as having pending work in this hardware queue
+ */
+static void blk_mq_hctx_mark_pending(struct blk_mq_hw_ctx *hctx,
+				     struct blk_mq_ctx *ctx)
+{
+	if (!test_bit(ctx->index_hw, hctx->ctx_map))
+		set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+/*
+ * Default mapping to a software queue, since we use one per CPU.
+ */
+struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q, const int cpu)
+{
+	return q->queue_hw_ctx[q->mq_map[cpu]];
+}
+EXPORT_SYMBOL(blk_mq_map_queue);
+
+struct blk_mq_hw_ctx *blk_mq_alloc_single_hw_queue(struct blk_mq_reg *reg,
+						   unsigned int hctx_index)
+{
+	return kzalloc_node(sizeof(struct blk_mq_hw_ctx), GFP_KERNEL,
+			    reg->numa_node);
+}
+EXPORT_SYMBOL(blk_mq_alloc_single_hw_queue);
+
+void blk_mq_free_single_hw_queue(struct blk_mq_hw_ctx *hctx,
+				 unsigned int hctx_index)
+{
+	kfree(hctx);
+}
+EXPORT_SYMBOL(blk_mq_free_single_hw_queue);
+
+struct request *blk_mq_tag_to_rq(struct blk_mq_hw_ctx *hctx, unsigned int tag)
+{
+	return hctx->rqs[tag];
+}
+EXPORT_SYMBOL(blk_mq_tag_to_rq);
+
+static void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
+			       struct request *rq, unsigned int rw_flags)
+{
+	int tag = rq->tag;
+
+	blk_rq_init(q, rq);
+	rq->tag = tag;
+	rq->mq_ctx = ctx;
+	rq->cmd_flags = rw_flags;
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags))
+		rq->cpu = ctx->cpu;
+}
+
+static struct request *__blk_mq_alloc_request(struct blk_mq_hw_ctx *hctx,
+					      gfp_t gfp, bool reserved)
+{
+	struct request *rq;
+	unsigned int tag;
+
+	tag = blk_mq_get_tag(hctx->tags, gfp, reserved);
+	if (tag == BLK_MQ_TAG_FAIL)
+		return NULL;
+
+	rq = hctx->rqs[tag];
+	rq->tag = tag;
+	return rq;
+}
+
+/**
+ * blk_mq_alloc_request - allocate a request for a multi-queue device
+ * @q:		the queue
+ * @rw:		READ or WRITE, plus any REQ_* flags
+ * @gfp:	if __GFP_WAIT is set, sleep until a tag is available
+ * @reserved:	allocate from the reserved tags
+ *
+ * Used for requests that do not originate from a bio, e.g. pass-through
+ * or driver internal commands.  The request is released again with
+ * blk_mq_free_request() or blk_put_request().
+ */
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp, bool reserved)
+{
+	struct blk_mq_ctx *ctx = blk_mq_get_ctx(q);
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	struct request *rq;
+
+	rq = __blk_mq_alloc_request(hctx, gfp, reserved);
+	if (rq)
+		blk_mq_rq_ctx_init(q, ctx, rq, rw);
+
+	return rq;
+}
+EXPORT_SYMBOL(blk_mq_alloc_request);
+
+void blk_mq_free_request(struct request *rq)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct request_queue *q = rq->q;
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	blk_iolat_put_request(rq);
+
+	rq->cmd_flags = 0;
+	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+	blk_mq_put_tag(hctx->tags, rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_free_request);
+
+/**
+ * blk_mq_end_io_partial - complete part of a request
+ * @rq:		the request being processed
+ * @error:	0 for success, < 0 for error
+ * @nr_bytes:	number of bytes to complete
+ *
+ * Ends I/O on @nr_bytes of @rq.  Returns %true if the request still has
+ * data left; the driver then owns it and must either issue the rest or
+ * give it back with blk_mq_requeue_request() and blk_mq_insert_request().
+ * Returns %false once the whole request is done and has been freed.
+ */
+bool blk_mq_end_io_partial(struct request *rq, int error,
+			   unsigned int nr_bytes)
+{
+	if (blk_update_request(rq, error, nr_bytes))
+		return true;
+
+	blk_iolat_done(rq);
+	blk_account_io_done(rq);
+
+	if (rq->end_io)
+		rq->end_io(rq, error);
+	else
+		blk_mq_free_request(rq);
+	return false;
+}
+EXPORT_SYMBOL(blk_mq_end_io_partial);
+
+void blk_mq_end_io(struct request *rq, int error)
+{
+	if (blk_mq_end_io_partial(rq, error, blk_rq_bytes(rq)))
+		BUG();
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+static void __blk_mq_complete_request(struct request *rq)
+{
+	if (rq->q->softirq_done_fn)
+		__blk_complete_request(rq);
+	else
+		blk_mq_end_io(rq, rq->errors);
+}
+
+/**
+ * blk_mq_complete_request - end I/O on a request
+ * @rq:		the request being processed
+ *
+ * Ends all I/O on a request.  If the driver registered a ->complete
+ * handler it is run from the block softirq on the CPU that submitted the
+ * request (or one sharing its cache), otherwise the request is ended
+ * directly with rq->errors.  Safe to call from interrupt context; races
+ * with the timeout handler are resolved here.
+ */
+void blk_mq_complete_request(struct request *rq)
+{
+	if (unlikely(blk_should_fake_timeout(rq->q)))
+		return;
+	if (!blk_mark_rq_complete(rq))
+		__blk_mq_complete_request(rq);
+}
+EXPORT_SYMBOL(blk_mq_complete_request);
+
+static void blk_mq_start_request(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	trace_block_rq_issue(q, rq);
+
+	if (!rq->timeout)
+		rq->timeout = q->rq_timeout;
+	rq->deadline = jiffies + rq->timeout;
+	set_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+
+	if (q->rq_timed_out_fn && !timer_pending(&q->timeout))
+		mod_timer(&q->timeout, round_jiffies_up(rq->deadline));
+}
+
+/**
+ * blk_mq_requeue_request - take back a request that was handed to the driver
+ * @rq:		the request
+ *
+ * Resets the started and completed state so that @rq can be inserted
+ * again with blk_mq_insert_request().
+ */
+void blk_mq_requeue_request(struct request *rq)
+{
+	trace_block_rq_requeue(rq->q, rq);
+
+	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+	blk_clear_rq_complete(rq);
+}
+EXPORT_SYMBOL(blk_mq_requeue_request);
+
+static void blk_mq_rq_timed_out(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	enum blk_eh_timer_return ret;
+
+	ret = q->rq_timed_out_fn(rq);
+	switch (ret) {
+	case BLK_EH_HANDLED:
+		__blk_mq_complete_request(rq);
+		break;
+	case BLK_EH_RESET_TIMER:
+		rq->deadline = jiffies + rq->timeout;
+		blk_clear_rq_complete(rq);
+		break;
+	case BLK_EH_NOT_HANDLED:
+		/*
+		 * LLD handles this for now but in the future
+		 * we can send a request msg to abort the command
+		 * and we can move more of the generic scsi eh code to
+		 * the blk layer.
+		 */
+		break;
+	default:
+		printk(KERN_ERR "block: bad eh return: %d\n", ret);
+		break;
+	}
+}
+
+void blk_mq_rq_timer(unsigned long data)
+{
+	struct request_queue *q = (struct request_queue *) data;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long next = 0;
+	int i, next_set = 0;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		unsigned int tag;
+
+		for (tag = 0; tag < hctx->queue_depth; tag++) {
+			struct request *rq = hctx->rqs[tag];
+
+			if (!test_bit(REQ_ATOM_STARTED, &rq->atomic_flags))
+				continue;
+
+			if (time_after_eq(jiffies, rq->deadline)) {
+				if (blk_mark_rq_complete(rq))
+					continue;
+				blk_mq_rq_timed_out(rq);
+				if (!test_bit(REQ_ATOM_STARTED, &rq->atomic_flags) ||
+				    test_bit(REQ_ATOM_COMPLETE, &rq->atomic_flags))
+					continue;
+			}
+
+			if (!next_set || time_after(next, rq->deadline)) {
+				next = rq->deadline;
+				next_set = 1;
+			}
+		}
+	}
+
+	if (next_set)
+		mod_timer(&q->timeout, round_jiffies_up(next));
+}
+
+/*
+ * Run this hardware queue, pulling any software queues mapped to it in.
+ * Note that this function currently has various problems around ordering
+ * of IO. In particular, we'd like FIFO behaviour on handling existing
+ * items on the hctx->dispatch list. Ignore that for now.
+ */
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+	int bit;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	/*
+	 * Touch any software queue that has pending entries.
+	 */
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		clear_bit(bit, hctx->ctx_map);
+		ctx = hctx->ctxs[bit];
+
+		spin_lock_irq(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock_irq(&ctx->lock);
+	}
+
+	/*
+	 * If we have previous entries on our dispatch list, grab them
+	 * and dispatch them first.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock_irq(&hctx->lock);
+		if (!list_empty(&hctx->dispatch))
+			list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock_irq(&hctx->lock);
+	}
+
+	/*
+	 * Now process all the entries, sending them to the driver.
+	 */
+	while (!list_empty(&rq_list)) {
+		int ret;
+
+		rq = list_first_entry(&rq_list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+
+		blk_mq_start_request(rq);
+
+		ret = q->mq_ops->queue_rq(hctx, rq);
+		if (likely(ret == BLK_MQ_RQ_QUEUE_OK))
+			continue;
+
+		if (ret == BLK_MQ_RQ_QUEUE_BUSY) {
+			/*
+			 * The driver is out of resources; it is responsible
+			 * for running the queue again once it has some.
+			 */
+			blk_mq_requeue_request(rq);
+			list_add(&rq->queuelist, &rq_list);
+			break;
+		}
+
+		if (ret != BLK_MQ_RQ_QUEUE_ERROR)
+			pr_err("blk-mq: bad return on queue: %d\n", ret);
+		rq->errors = -EIO;
+		blk_mq_end_io(rq, rq->errors);
+	}
+
+	/*
+	 * Any items that need requeuing? Stuff them into hctx->dispatch,
+	 * that is where we will continue on next queue run.
+	 */
+	if (!list_empty(&rq_list)) {
+		spin_lock_irq(&hctx->lock);
+		list_splice(&rq_list, &hctx->dispatch);
+		spin_unlock_irq(&hctx->lock);
+	}
+}
+
+static void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	/*
+	 * Dispatch runs with interrupts enabled, so punt to kblockd from
+	 * completion context.  Drivers that may sleep in ->queue_rq() are
+	 * always run from kblockd, as the submitter may be on its way into
+	 * schedule() when it flushes its plug.
+	 */
+	if (!async && !irqs_disabled() && !(hctx->flags & BLK_MQ_F_BLOCKING))
+		__blk_mq_run_hw_queue(hctx);
+	else
+		kblockd_schedule_delayed_work(hctx->queue, &hctx->run_work, 0);
+}
+
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!blk_mq_hctx_has_pending(hctx) ||
+		    test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+void blk_mq_stop_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		blk_mq_stop_hw_queue(hctx);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queues);
+
+void blk_mq_start_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+	blk_mq_run_hw_queue(hctx, false);
+}
+EXPORT_SYMBOL(blk_mq_start_hw_queue);
+
+void blk_mq_start_stopped_hw_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+
+		clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+static void blk_mq_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work.work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+/*
+ * Must be called with ctx->lock held and interrupts disabled.
+ */
+static void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
+				    struct request *rq, bool at_head)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	trace_block_rq_insert(hctx->queue, rq);
+
+	if (at_head)
+		list_add(&rq->queuelist, &ctx->rq_list);
+	else
+		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	blk_mq_hctx_mark_pending(hctx, ctx);
+}
+
+/**
+ * blk_mq_insert_request - queue a request on its software queue
+ * @rq:		the request
+ * @at_head:	insert at the head rather than the tail
+ * @run_queue:	run the hardware queue afterwards
+ * @async:	run the hardware queue from kblockd
+ *
+ * May be called from interrupt context.
+ */
+void blk_mq_insert_request(struct request *rq, bool at_head, bool run_queue,
+			   bool async)
+{
+	struct request_queue *q = rq->q;
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->lock, flags);
+	__blk_mq_insert_request(hctx, rq, at_head);
+	spin_unlock_irqrestore(&ctx->lock, flags);
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, async);
+}
+EXPORT_SYMBOL(blk_mq_insert_request);
+
+static void blk_mq_insert_requests(struct request_queue *q,
+				   struct blk_mq_ctx *ctx,
+				   struct list_head *list,
+				   int depth, bool from_schedule)
+{
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	struct request *rq;
+
+	trace_block_unplug(q, depth, !from_schedule);
+
+	if (unlikely(blk_queue_dead(q))) {
+		while (!list_empty(list)) {
+			rq = list_entry_rq(list->next);
+			list_del_init(&rq->queuelist);
+			blk_mq_end_io(rq, -ENODEV);
+		}
+		return;
+	}
+
+	spin_lock_irq(&ctx->lock);
+	while (!list_empty(list)) {
+		rq = list_entry_rq(list->next);
+		list_del_init(&rq->queuelist);
+		__blk_mq_insert_request(hctx, rq, false);
+	}
+	spin_unlock_irq(&ctx->lock);
+
+	blk_mq_run_hw_queue(hctx, from_schedule);
+}
+
+static int plug_ctx_cmp(void *priv, struct list_head *a, struct list_head *b)
+{
+	struct request *rqa = container_of(a, struct request, queuelist);
+	struct request *rqb = container_of(b, struct request, queuelist);
+
+	return !(rqa->mq_ctx < rqb->mq_ctx ||
+		 (rqa->mq_ctx == rqb->mq_ctx &&
+		  blk_rq_pos(rqa) < blk_rq_pos(rqb)));
+}
+
+void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
+{
+	struct blk_mq_ctx *this_ctx;
+	struct request *rq;
+	LIST_HEAD(list);
+	LIST_HEAD(ctx_list);
+	int depth;
+
+	list_splice_init(&plug->mq_list, &list);
+	list_sort(NULL, &list, plug_ctx_cmp);
+
+	while (!list_empty(&list)) {
+		rq = list_entry_rq(list.next);
+		this_ctx = rq->mq_ctx;
+		depth = 0;
+
+		while (!list_empty(&list)) {
+			rq = list_entry_rq(list.next);
+			if (rq->mq_ctx != this_ctx)
+				break;
+			list_move_tail(&rq->queuelist, &ctx_list);
+			depth++;
+		}
+
+		blk_mq_insert_requests(this_ctx->queue, this_ctx, &ctx_list,
+				       depth, from_schedule);
+	}
+}
+
+/*
+ * Try to merge @bio into the request at the tail of the software queue.
+ * Only requests that have not been dispatched yet are candidates.
+ */
+static bool blk_mq_attempt_merge(struct request_queue *q,
+				 struct blk_mq_ctx *ctx, struct bio *bio)
+{
+	struct request *rq;
+	bool merged = false;
+
+	if (blk_queue_nomerges(q))
+		return false;
+
+	spin_lock_irq(&ctx->lock);
+	if (!list_empty(&ctx->rq_list)) {
+		rq = list_entry_rq(ctx->rq_list.prev);
+		if (blk_rq_merge_ok(rq, bio)) {
+			switch (blk_try_merge(rq, bio)) {
+			case ELEVATOR_BACK_MERGE:
+				merged = bio_attempt_back_merge(q, rq, bio);
+				break;
+			case ELEVATOR_FRONT_MERGE:
+				merged = bio_attempt_front_merge(q, rq, bio);
+				break;
+			}
+		}
+	}
+	spin_unlock_irq(&ctx->lock);
+
+	return merged;
+}
+
+static void __blk_mq_make_request(struct request_queue *q, struct bio *bio,
+				  bool plug_ok)
+{
+	const int is_sync = rw_is_sync(bio->bi_rw);
+	unsigned int rw_flags = bio_data_dir(bio);
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct blk_plug *plug;
+	struct request *rq;
+
+	ctx = blk_mq_get_ctx(q);
+	hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	if ((hctx->flags & BLK_MQ_F_SHOULD_MERGE) &&
+	    blk_mq_attempt_merge(q, ctx, bio))
+		return;
+
+	if (is_sync)
+		rw_flags |= REQ_SYNC;
+
+	trace_block_getrq(q, bio, rw_flags);
+	rq = __blk_mq_alloc_request(hctx, GFP_NOIO, false);
+	blk_mq_rq_ctx_init(q, ctx, rq, rw_flags);
+
+	init_request_from_bio(rq, bio);
+	drive_stat_acct(rq, 1);
+
+	/*
+	 * A task plug holds requests back so that they reach the software
+	 * queue, and the driver, as one batch.
+	 */
+	plug = current->plug;
+	if (plug && plug_ok) {
+		if (list_empty(&plug->mq_list))
+			trace_block_plug(q);
+		list_add_tail(&rq->queuelist, &plug->mq_list);
+		return;
+	}
+
+	spin_lock_irq(&ctx->lock);
+	__blk_mq_insert_request(hctx, rq, false);
+	spin_unlock_irq(&ctx->lock);
+
+	blk_mq_run_hw_queue(hctx, !is_sync);
+}
+
+struct blk_mq_flush_data {
+	struct completion	done;
+	int			error;
+	bio_end_io_t		*saved_end_io;
+	void			*saved_private;
+};
+
+static void blk_mq_flush_end_io(struct request *rq, int error)
+{
+	struct blk_mq_flush_data *fd = rq->end_io_data;
+
+	fd->error = error;
+	blk_mq_free_request(rq);
+	complete(&fd->done);
+}
+
+/*
+ * Issue an empty REQ_FLUSH request and wait for it to finish.
+ */
+static int blk_mq_issue_flush(struct request_queue *q, struct gendisk *disk)
+{
+	struct blk_mq_flush_data fd;
+	struct request *rq;
+
+	init_completion(&fd.done);
+
+	rq = blk_mq_alloc_request(q, WRITE_FLUSH, GFP_NOIO, false);
+	rq->cmd_type = REQ_TYPE_FS;
+	rq->cmd_flags &= ~REQ_IO_STAT;
+	rq->rq_disk = disk;
+	rq->end_io = blk_mq_flush_end_io;
+	rq->end_io_data = &fd;
+
+	blk_mq_insert_request(rq, false, true, false);
+	wait_for_completion(&fd.done);
+
+	return fd.error;
+}
+
+static void blk_mq_fua_end_io(struct bio *bio, int error)
+{
+	struct blk_mq_flush_data *fd = bio->bi_private;
+
+	fd->error = error;
+	complete(&fd->done);
+}
+
+/*
+ * Without an elevator there is no flush state machine to sequence
+ * REQ_FLUSH/REQ_FUA bios, so do it synchronously in the submitter's
+ * context: drivers only ever see empty flush requests and, if they
+ * advertise it, REQ_FUA writes.  generic_make_request_checks() already
+ * stripped the flags if the queue has no cache to flush.
+ */
+static void blk_mq_flush_bio(struct request_queue *q, struct bio *bio)
+{
+	struct gendisk *disk = bio->bi_bdev->bd_disk;
+	struct blk_mq_flush_data fd;
+	int err;
+
+	if (bio->bi_rw & REQ_FLUSH) {
+		err = blk_mq_issue_flush(q, disk);
+		if (err || !bio->bi_size) {
+			bio_endio(bio, err);
+			return;
+		}
+		bio->bi_rw &= ~REQ_FLUSH;
+	}
+
+	if (!(bio->bi_rw & REQ_FUA) || (q->flush_flags & REQ_FUA)) {
+		__blk_mq_make_request(q, bio, true);
+		return;
+	}
+
+	/* emulate FUA: write, wait, then flush before completing the bio */
+	init_completion(&fd.done);
+	fd.saved_end_io = bio->bi_end_io;
+	fd.saved_private = bio->bi_private;
+	bio->bi_end_io = blk_mq_fua_end_io;
+	bio->bi_private = &fd;
+	bio->bi_rw &= ~REQ_FUA;
+
+	__blk_mq_make_request(q, bio, false);
+	wait_for_completion(&fd.done);
+
+	bio->bi_end_io = fd.saved_end_io;
+	bio->bi_private = fd.saved_private;
+
+	err = fd.error;
+	if (!err)
+		err = blk_mq_issue_flush(q, disk);
+	bio_endio(bio, err);
+}
+
+static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	/*
+	 * low level driver can indicate that it wants pages above a
+	 * certain limit bounced to low memory (ie for highmem, or even
+	 * ISA dma in theory)
+	 */
+	blk_queue_bounce(q, &bio);
+
+	if (unlikely(blk_queue_dead(q))) {
+		bio_endio(bio, -ENODEV);
+		return;
+	}
+
+	if (unlikely(bio->bi_rw & (REQ_FLUSH | REQ_FUA))) {
+		blk_mq_flush_bio(q, bio);
+		return;
+	}
+
+	__blk_mq_make_request(q, bio, true);
+}
+
+/*
+ * Wait for all requests that were allocated before the queue was marked
+ * dead to be completed by the driver.
+ */
+void blk_mq_drain_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int busy;
+	int i;
+
+	while (true) {
+		busy = 0;
+		queue_for_each_hw_ctx(q, hctx, i) {
+			if (blk_mq_hctx_has_pending(hctx))
+				blk_mq_run_hw_queue(hctx, false);
+			busy += blk_mq_tags_busy(hctx->tags);
+		}
+
+		if (!busy)
+			break;
+		msleep(10);
+	}
+}
+
+void blk_mq_sync_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		cancel_delayed_work_sync(&hctx->run_work);
+}
+
+/*
+ * Spread the possible CPUs evenly over the hardware queues.  If there
+ * are fewer queues than CPUs, thread siblings share the queue of the
+ * first sibling, since they share caches anyway.
+ */
+unsigned int *blk_mq_make_queue_map(struct blk_mq_reg *reg)
+{
+	unsigned int nr_queues = reg->nr_hw_queues;
+	unsigned int nr_cpus = 0, index = 0;
+	bool share_siblings;
+	unsigned int *map;
+	int cpu, first;
+
+	map = kzalloc_node(sizeof(*map) * nr_cpu_ids, GFP_KERNEL,
+			   reg->numa_node);
+	if (!map)
+		return NULL;
+
+	share_siblings = nr_queues < num_possible_cpus();
+	for_each_possible_cpu(cpu) {
+		first = cpumask_first(topology_thread_cpumask(cpu));
+		if (!share_siblings || first >= nr_cpu_ids || first == cpu)
+			nr_cpus++;
+	}
+
+	for_each_possible_cpu(cpu) {
+		first = cpumask_first(topology_thread_cpumask(cpu));
+		if (share_siblings && first < nr_cpu_ids && first != cpu)
+			map[cpu] = map[first];
+		else
+			map[cpu] = (index++ * nr_queues) / nr_cpus;
+	}
+
+	return map;
+}
+
+#define order_to_size(order)	(PAGE_SIZE << (order))
+
+static void blk_mq_free_rq_map(struct blk_mq_hw_ctx *hctx)
+{
+	struct page *page;
+
+	while (!list_empty(&hctx->page_list)) {
+		page = list_first_entry(&hctx->page_list, struct page, lru);
+		list_del_init(&page->lru);
+		__free_pages(page, page_private(page));
+	}
+
+	kfree(hctx->rqs);
+	hctx->rqs = NULL;
+
+	if (hctx->tags) {
+		blk_mq_free_tags(hctx->tags);
+		hctx->tags = NULL;
+	}
+}
+
+/*
+ * Preallocate the requests of a hardware queue, together with the
+ * driver's per-request data, in runs of physically contiguous pages.
+ */
+static int blk_mq_init_rq_map(struct blk_mq_hw_ctx *hctx,
+			      unsigned int reserved_tags, int node)
+{
+	unsigned int i, j, entries_per_page, max_order = 4;
+	size_t rq_size, left;
+
+	hctx->rqs = kmalloc_node(hctx->queue_depth * sizeof(struct request *),
+				 GFP_KERNEL, node);
+	if (!hctx->rqs)
+		return -ENOMEM;
+
+	rq_size = round_up(sizeof(struct request) + hctx->cmd_size,
+			   cache_line_size());
+	left = rq_size * hctx->queue_depth;
+
+	for (i = 0; i < hctx->queue_depth;) {
+		int this_order = max_order;
+		struct page *page;
+		int to_do;
+		void *p;
+
+		while (this_order && left < order_to_size(this_order - 1))
+			this_order--;
+
+		do {
+			page = alloc_pages_node(node, GFP_KERNEL | __GFP_NOWARN,
+						this_order);
+			if (page)
+				break;
+			if (!this_order--)
+				break;
+			if (order_to_size(this_order) < rq_size)
+				break;
+		} while (1);
+
+		if (!page)
+			goto fail;
+
+		set_page_private(page, this_order);
+		list_add_tail(&page->lru, &hctx->page_list);
+
+		p = page_address(page);
+		entries_per_page = order_to_size(this_order) / rq_size;
+		to_do = min(entries_per_page, hctx->queue_depth - i);
+		left -= to_do * rq_size;
+		for (j = 0; j < to_do; j++) {
+			hctx->rqs[i] = p;
+			blk_rq_init(hctx->queue, hctx->rqs[i]);
+			p += rq_size;
+			i++;
+		}
+	}
+
+	hctx->tags = blk_mq_init_tags(hctx->queue_depth, reserved_tags, node);
+	if (!hctx->tags)
+		goto fail;
+
+	return 0;
+fail:
+	blk_mq_free_rq_map(hctx);
+	return -ENOMEM;
+}
+
+static void blk_mq_free_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	blk_mq_free_rq_map(hctx);
+	kfree(hctx->ctxs);
+	kfree(hctx->ctx_map);
+}
+
+static int blk_mq_init_hw_queues(struct request_queue *q,
+				 struct blk_mq_reg *reg, void *driver_data)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i, j;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		int node = hctx->numa_node;
+
+		INIT_DELAYED_WORK(&hctx->run_work, blk_mq_work_fn);
+		spin_lock_init(&hctx->lock);
+		INIT_LIST_HEAD(&hctx->dispatch);
+		INIT_LIST_HEAD(&hctx->page_list);
+		hctx->queue = q;
+		hctx->flags = reg->flags;
+		hctx->queue_depth = reg->queue_depth;
+		hctx->cmd_size = reg->cmd_size;
+
+		if (blk_mq_init_rq_map(hctx, reg->reserved_tags, node))
+			break;
+
+		hctx->ctxs = kmalloc_node(nr_cpu_ids * sizeof(void *),
+					  GFP_KERNEL, node);
+		if (!hctx->ctxs)
+			break;
+
+		hctx->ctx_map = kzalloc_node(BITS_TO_LONGS(nr_cpu_ids) *
+					     sizeof(unsigned long),
+					     GFP_KERNEL, node);
+		if (!hctx->ctx_map)
+			break;
+
+		hctx->nr_ctx = 0;
+
+		if (reg->ops->init_hctx &&
+		    reg->ops->init_hctx(hctx, driver_data, i))
+			break;
+	}
+
+	if (i == q->nr_hw_queues)
+		return 0;
+
+	/*
+	 * Init failed
+	 */
+	queue_for_each_hw_ctx(q, hctx, j) {
+		if (j > i)
+			break;
+
+		if (j < i && reg->ops->exit_hctx)
+			reg->ops->exit_hctx(hctx, j);
+
+		blk_mq_free_hw_queue(hctx);
+	}
+
+	return 1;
+}
+
+static void blk_mq_init_cpu_queues(struct request_queue *q)
+{
+	unsigned int i;
+
+	for_each_possible_cpu(i) {
+		struct blk_mq_ctx *__ctx = per_cpu_ptr(q->queue_ctx, i);
+
+		memset(__ctx, 0, sizeof(*__ctx));
+		__ctx->cpu = i;
+		spin_lock_init(&__ctx->lock);
+		INIT_LIST_HEAD(&__ctx->rq_list);
+		__ctx->queue = q;
+	}
+}
+
+static void blk_mq_map_swqueue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	unsigned int i;
+
+	/*
+	 * Map software to hardware queues
+	 */
+	for_each_possible_cpu(i) {
+		ctx = per_cpu_ptr(q->queue_ctx, i);
+		hctx = q->mq_ops->map_queue(q, i);
+		cpumask_set_cpu(i, hctx->cpumask);
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+	}
+}
+
+static void blk_mq_free_hctxs(struct blk_mq_reg *reg,
+			      struct blk_mq_hw_ctx **hctxs)
+{
+	unsigned int i;
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		if (!hctxs[i])
+			continue;
+		free_cpumask_var(hctxs[i]->cpumask);
+		if (reg->ops->free_hctx)
+			reg->ops->free_hctx(hctxs[i], i);
+		else
+			blk_mq_free_single_hw_queue(hctxs[i], i);
+	}
+	kfree(hctxs);
+}
+
+/**
+ * blk_mq_init_queue - create a multi-queue request queue
+ * @reg:	description of the driver's hardware queues
+ * @driver_data: passed to ->init_hctx()
+ *
+ * Description:
+ *    Allocates a request queue that bypasses the elevator and the queue
+ *    lock: bios are turned into requests on the submitting CPU's software
+ *    queue and handed to @reg->ops->queue_rq() on the hardware queue that
+ *    CPU maps to.  Completed requests are ended with blk_mq_end_io() or
+ *    blk_mq_complete_request().
+ *
+ *    Returns %NULL on failure.  The queue is released with
+ *    blk_cleanup_queue() like any other.
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct blk_mq_hw_ctx **hctxs;
+	struct blk_mq_ctx *ctx;
+	struct request_queue *q;
+	unsigned int *map;
+	int i, cpu;
+
+	if (!reg->nr_hw_queues || !reg->ops->queue_rq ||
+	    !reg->ops->map_queue || !reg->queue_depth ||
+	    reg->queue_depth > BLK_MQ_MAX_DEPTH ||
+	    reg->reserved_tags >= reg->queue_depth)
+		return NULL;
+
+	ctx = alloc_percpu(struct blk_mq_ctx);
+	if (!ctx)
+		return NULL;
+
+	hctxs = kzalloc_node(reg->nr_hw_queues * sizeof(*hctxs), GFP_KERNEL,
+			     reg->numa_node);
+	if (!hctxs)
+		goto err_percpu;
+
+	map = blk_mq_make_queue_map(reg);
+	if (!map)
+		goto err_hctxs;
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		if (reg->ops->alloc_hctx)
+			hctxs[i] = reg->ops->alloc_hctx(reg, i);
+		else
+			hctxs[i] = blk_mq_alloc_single_hw_queue(reg, i);
+		if (!hctxs[i])
+			goto err_map;
+
+		if (!zalloc_cpumask_var(&hctxs[i]->cpumask, GFP_KERNEL)) {
+			blk_mq_free_single_hw_queue(hctxs[i], i);
+			hctxs[i] = NULL;
+			goto err_map;
+		}
+
+		/* place the queue's requests near the CPUs submitting them */
+		hctxs[i]->numa_node = reg->numa_node;
+		if (reg->numa_node == NUMA_NO_NODE) {
+			for_each_possible_cpu(cpu) {
+				if (map[cpu] == i) {
+					hctxs[i]->numa_node = cpu_to_node(cpu);
+					break;
+				}
+			}
+		}
+		hctxs[i]->queue_num = i;
+	}
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		goto err_map;
+
+	q->mq_map = map;
+	q->nr_queues = nr_cpu_ids;
+	q->nr_hw_queues = reg->nr_hw_queues;
+	q->queue_ctx = ctx;
+	q->queue_hw_ctx = hctxs;
+	q->mq_ops = reg->ops;
+	q->queue_flags |= QUEUE_FLAG_MQ_DEFAULT;
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	setup_timer(&q->timeout, blk_mq_rq_timer, (unsigned long) q);
+	blk_queue_rq_timeout(q, reg->timeout ? reg->timeout : 30 * HZ);
+	blk_queue_rq_timed_out(q, reg->ops->timeout);
+	if (reg->ops->complete)
+		blk_queue_softirq_done(q, reg->ops->complete);
+
+	blk_mq_init_cpu_queues(q);
+
+	if (blk_mq_init_hw_queues(q, reg, driver_data))
+		goto err_queue;
+
+	blk_mq_map_swqueue(q);
+	return q;
+
+err_queue:
+	/* hand the queue back as a plain one, we free our part below */
+	q->mq_ops = NULL;
+	q->queue_hw_ctx = NULL;
+	q->nr_hw_queues = 0;
+	q->queue_ctx = NULL;
+	q->mq_map = NULL;
+	blk_cleanup_queue(q);
+err_map:
+	kfree(map);
+err_hctxs:
+	blk_mq_free_hctxs(reg, hctxs);
+err_percpu:
+	free_percpu(ctx);
+	return NULL;
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+void blk_mq_free_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (q->mq_ops->exit_hctx)
+			q->mq_ops->exit_hctx(hctx, i);
+		blk_mq_free_hw_queue(hctx);
+		free_cpumask_var(hctx->cpumask);
+		if (q->mq_ops->free_hctx)
+			q->mq_ops->free_hctx(hctx, i);
+		else
+			blk_mq_free_single_hw_queue(hctx, i);
+	}
+
+	kfree(q->queue_hw_ctx);
+	free_percpu(q->queue_ctx);
+	kfree(q->mq_map);
+
+	q->queue_hw_ctx = NULL;
+	q->queue_ctx = NULL;
+	q->mq_map = NULL;
+	q->nr_hw_queues = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef INT_BLK_MQ_H
+#define INT_BLK_MQ_H
+
+struct blk_mq_reg;
+
+/*
+ * Per-cpu software submission queue.  Submitters only ever touch the
+ * queue of the CPU they are running on, so the lock is nearly always
+ * uncontended; the hardware queue it maps to drains it on dispatch.
+ */
+struct blk_mq_ctx {
+	struct {
+		spinlock_t		lock;
+		struct list_head	rq_list;
+	}  ____cacheline_aligned_in_smp;
+
+	unsigned int		cpu;
+	unsigned int		index_hw;
+
+	struct request_queue	*queue;
+} ____cacheline_aligned_in_smp;
+
+void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule);
+void blk_mq_free_queue(struct request_queue *q);
+void blk_mq_drain_queue(struct request_queue *q);
+void blk_mq_sync_queue(struct request_queue *q);
+void blk_mq_rq_timer(unsigned long data);
+
+/*
+ * CPU -> queue mappings
+ */
+unsigned int *blk_mq_make_queue_map(struct blk_mq_reg *reg);
+
+#endif
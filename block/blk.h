@@ -29,6 +29,13 @@ void __blk_queue_free_tags(struct request_queue *q);
 bool __blk_end_bidi_request(struct request *rq, int error,
 			    unsigned int nr_bytes, unsigned int bidi_bytes);
 
+void drive_stat_acct(struct request *rq, int new_io);
+void blk_account_io_done(struct request *req);
+bool bio_attempt_back_merge(struct request_queue *q, struct request *req,
+			    struct bio *bio);
+bool bio_attempt_front_merge(struct request_queue *q, struct request *req,
+			     struct bio *bio);
+
 void blk_rq_timed_out_timer(unsigned long data);
 void blk_delete_timer(struct request *);
 void blk_add_timer(struct request *);
@@ -39,6 +46,7 @@ void __generic_unplug_device(struct request_queue *);
  */
 enum rq_atomic_flags {
 	REQ_ATOM_COMPLETE = 0,
+	REQ_ATOM_STARTED,
 };
 
 /*
@@ -234,4 +242,25 @@ static inline void blk_throtl_exit(struct request_queue *q) { }
 static inline void blk_throtl_release(struct request_queue *q) { }
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+/*
+ * Internal latency target interface
+ */
+#ifdef CONFIG_BLK_DEV_IOLATENCY
+extern void blk_iolat_bio(struct request_queue *q, struct bio *bio);
+extern void blk_iolat_rq_init(struct request *rq);
+extern void blk_iolat_done(struct request *rq);
+extern void blk_iolat_put_request(struct request *rq);
+extern int blk_iolat_init(struct request_queue *q);
+extern void blk_iolat_exit(struct request_queue *q);
+extern void blk_iolat_release(struct request_queue *q);
+#else /* CONFIG_BLK_DEV_IOLATENCY */
+static inline void blk_iolat_bio(struct request_queue *q, struct bio *bio) { }
+static inline void blk_iolat_rq_init(struct request *rq) { }
+static inline void blk_iolat_done(struct request *rq) { }
+static inline void blk_iolat_put_request(struct request *rq) { }
+static inline int blk_iolat_init(struct request_queue *q) { return 0; }
+static inline void blk_iolat_exit(struct request_queue *q) { }
+static inline void blk_iolat_release(struct request_queue *q) { }
+#endif /* CONFIG_BLK_DEV_IOLATENCY */
+
 #endif /* BLK_INTERNAL_H */
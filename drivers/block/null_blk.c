@@ -0,0 +1,636 @@
+/*
+ * Null block device driver.
+ *
+ * Accepts I/O and completes it without touching any data, so that the cost
+ * of the block layer itself can be measured.  The device can sit on a bio
+ * based queue, a request_fn queue or a multi-queue request queue, and its
+ * commands are completed inline, from the block softirq, or from a per-cpu
+ * hrtimer after a configurable delay that stands in for the hardware.
+ *
+ * See Documentation/blockdev/null_blk.txt for the module parameters.
+ */
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/bio.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/llist.h>
+
+struct nullb_cmd {
+	struct llist_node ll_list;
+	struct request *rq;
+	struct bio *bio;
+	unsigned int tag;
+	struct nullb_queue *nq;
+};
+
+/*
+ * Command pool of one submission queue.  Only used for the bio and
+ * request_fn modes; blk-mq hands us the command with the request.
+ */
+struct nullb_queue {
+	unsigned long *tag_map;
+	wait_queue_head_t wait;
+	unsigned int queue_depth;
+
+	struct nullb_cmd *cmds;
+};
+
+struct nullb {
+	struct list_head list;
+	unsigned int index;
+	struct request_queue *q;
+	struct gendisk *disk;
+	spinlock_t lock;
+
+	struct nullb_queue *queues;
+	unsigned int nr_queues;
+};
+
+static LIST_HEAD(nullb_list);
+static DEFINE_MUTEX(nullb_mutex);
+static int null_major;
+static int nullb_indexes;
+
+/*
+ * Commands completed in timer mode are queued on the submitting CPU and
+ * ended in one batch when that CPU's timer fires.
+ */
+struct completion_queue {
+	struct llist_head list;
+	struct hrtimer timer;
+};
+
+static DEFINE_PER_CPU(struct completion_queue, completion_queues);
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+
+	NULL_Q_BIO		= 0,
+	NULL_Q_RQ		= 1,
+	NULL_Q_MQ		= 2,
+};
+
+static int submit_queues = 1;
+module_param(submit_queues, int, S_IRUGO);
+MODULE_PARM_DESC(submit_queues, "Number of submission queues");
+
+static int home_node = NUMA_NO_NODE;
+module_param(home_node, int, S_IRUGO);
+MODULE_PARM_DESC(home_node, "NUMA node to allocate the device on");
+
+static int queue_mode = NULL_Q_MQ;
+module_param(queue_mode, int, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "Block interface to use (0=bio, 1=rq, 2=multiqueue)");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size of each device in GB");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Logical block size in bytes");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "Completion method (0=inline, 1=softirq, 2=timer)");
+
+static int completion_nsec = 10000;
+module_param(completion_nsec, int, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Completion latency in ns for irqmode=2");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Depth of each submission queue");
+
+static void put_tag(struct nullb_queue *nq, unsigned int tag)
+{
+	clear_bit_unlock(tag, nq->tag_map);
+	smp_mb__after_clear_bit();
+
+	if (waitqueue_active(&nq->wait))
+		wake_up(&nq->wait);
+}
+
+static unsigned int get_tag(struct nullb_queue *nq)
+{
+	unsigned int tag;
+
+	do {
+		tag = find_first_zero_bit(nq->tag_map, nq->queue_depth);
+		if (tag >= nq->queue_depth)
+			return -1U;
+	} while (test_and_set_bit_lock(tag, nq->tag_map));
+
+	return tag;
+}
+
+static struct nullb_cmd *__alloc_cmd(struct nullb_queue *nq)
+{
+	struct nullb_cmd *cmd;
+	unsigned int tag;
+
+	tag = get_tag(nq);
+	if (tag == -1U)
+		return NULL;
+
+	cmd = &nq->cmds[tag];
+	cmd->tag = tag;
+	cmd->nq = nq;
+	return cmd;
+}
+
+static struct nullb_cmd *alloc_cmd(struct nullb_queue *nq, bool can_wait)
+{
+	struct nullb_cmd *cmd;
+	DEFINE_WAIT(wait);
+
+	cmd = __alloc_cmd(nq);
+	if (cmd || !can_wait)
+		return cmd;
+
+	for (;;) {
+		prepare_to_wait(&nq->wait, &wait, TASK_UNINTERRUPTIBLE);
+		cmd = __alloc_cmd(nq);
+		if (cmd)
+			break;
+		io_schedule();
+	}
+	finish_wait(&nq->wait, &wait);
+
+	return cmd;
+}
+
+static void free_cmd(struct nullb_cmd *cmd)
+{
+	put_tag(cmd->nq, cmd->tag);
+}
+
+/*
+ * The request_fn queue is stopped when it runs out of commands, restart
+ * it once one has been given back.
+ */
+static void null_restart_queue(struct request_queue *q)
+{
+	unsigned long flags;
+
+	if (!blk_queue_stopped(q))
+		return;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	if (blk_queue_stopped(q))
+		blk_start_queue(q);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+static void end_cmd(struct nullb_cmd *cmd)
+{
+	struct request_queue *q;
+
+	switch (queue_mode) {
+	case NULL_Q_MQ:
+		blk_mq_end_io(cmd->rq, 0);
+		break;
+	case NULL_Q_RQ:
+		q = cmd->rq->q;
+		blk_end_request_all(cmd->rq, 0);
+		free_cmd(cmd);
+		null_restart_queue(q);
+		break;
+	case NULL_Q_BIO:
+		bio_endio(cmd->bio, 0);
+		free_cmd(cmd);
+		break;
+	}
+}
+
+static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
+{
+	struct completion_queue *cq;
+	struct llist_node *entry;
+	struct nullb_cmd *cmd;
+
+	cq = container_of(timer, struct completion_queue, timer);
+
+	entry = llist_del_all(&cq->list);
+	while (entry) {
+		cmd = llist_entry(entry, struct nullb_cmd, ll_list);
+		entry = entry->next;
+		end_cmd(cmd);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+static void null_cmd_end_timer(struct nullb_cmd *cmd)
+{
+	struct completion_queue *cq = &get_cpu_var(completion_queues);
+
+	/* the first command on an idle queue arms the timer */
+	if (llist_add(&cmd->ll_list, &cq->list))
+		hrtimer_start(&cq->timer, ktime_set(0, completion_nsec),
+			      HRTIMER_MODE_REL);
+
+	put_cpu_var(completion_queues);
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+	if (queue_mode == NULL_Q_MQ)
+		end_cmd(blk_mq_rq_to_pdu(rq));
+	else
+		end_cmd(rq->special);
+}
+
+static void null_handle_cmd(struct nullb_cmd *cmd)
+{
+	switch (irqmode) {
+	case NULL_IRQ_SOFTIRQ:
+		switch (queue_mode) {
+		case NULL_Q_MQ:
+			blk_mq_complete_request(cmd->rq);
+			break;
+		case NULL_Q_RQ:
+			blk_complete_request(cmd->rq);
+			break;
+		case NULL_Q_BIO:
+			/*
+			 * A bio carries no submitting CPU to steer the
+			 * softirq to, so end it inline.
+			 */
+			end_cmd(cmd);
+			break;
+		}
+		break;
+	case NULL_IRQ_NONE:
+		end_cmd(cmd);
+		break;
+	case NULL_IRQ_TIMER:
+		null_cmd_end_timer(cmd);
+		break;
+	}
+}
+
+static struct nullb_queue *nullb_to_queue(struct nullb *nullb)
+{
+	unsigned int index = 0;
+
+	if (nullb->nr_queues != 1) {
+		unsigned int per_queue = DIV_ROUND_UP(nr_cpu_ids,
+						      nullb->nr_queues);
+
+		index = raw_smp_processor_id() / per_queue;
+	}
+
+	return &nullb->queues[index];
+}
+
+static void null_queue_bio(struct request_queue *q, struct bio *bio)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(nullb_to_queue(nullb), true);
+	cmd->bio = bio;
+
+	null_handle_cmd(cmd);
+}
+
+static int null_rq_prep_fn(struct request_queue *q, struct request *req)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_queue *nq = nullb_to_queue(nullb);
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(nq, false);
+	if (!cmd) {
+		/*
+		 * Stop the queue before looking again, so a command given
+		 * back in between either shows up here or sees the queue
+		 * stopped and restarts it.  The barrier orders setting the
+		 * stopped flag before rereading the tag map; it pairs with
+		 * the one in put_tag().
+		 */
+		blk_stop_queue(q);
+		smp_mb();
+		cmd = alloc_cmd(nq, false);
+		if (!cmd)
+			return BLKPREP_DEFER;
+		queue_flag_clear(QUEUE_FLAG_STOPPED, q);
+	}
+
+	cmd->rq = req;
+	req->special = cmd;
+	return BLKPREP_OK;
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct request *rq;
+
+	while ((rq = blk_fetch_request(q)) != NULL) {
+		struct nullb_cmd *cmd = rq->special;
+
+		spin_unlock_irq(q->queue_lock);
+		null_handle_cmd(cmd);
+		spin_lock_irq(q->queue_lock);
+	}
+}
+
+static int null_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+	cmd->rq = rq;
+	cmd->nq = hctx->driver_data;
+
+	null_handle_cmd(cmd);
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static int null_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			  unsigned int index)
+{
+	struct nullb *nullb = data;
+
+	hctx->driver_data = &nullb->queues[index];
+	return 0;
+}
+
+static struct blk_mq_ops null_mq_ops = {
+	.queue_rq	= null_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.init_hctx	= null_init_hctx,
+	.complete	= null_softirq_done_fn,
+};
+
+static const struct block_device_operations null_fops = {
+	.owner		= THIS_MODULE,
+};
+
+static int setup_commands(struct nullb_queue *nq)
+{
+	init_waitqueue_head(&nq->wait);
+	nq->queue_depth = hw_queue_depth;
+
+	nq->cmds = kcalloc(nq->queue_depth, sizeof(*nq->cmds), GFP_KERNEL);
+	if (!nq->cmds)
+		return -ENOMEM;
+
+	nq->tag_map = kcalloc(BITS_TO_LONGS(nq->queue_depth),
+			      sizeof(unsigned long), GFP_KERNEL);
+	if (!nq->tag_map) {
+		kfree(nq->cmds);
+		nq->cmds = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void cleanup_queues(struct nullb *nullb)
+{
+	int i;
+
+	for (i = 0; i < nullb->nr_queues; i++) {
+		kfree(nullb->queues[i].tag_map);
+		kfree(nullb->queues[i].cmds);
+	}
+
+	kfree(nullb->queues);
+}
+
+static int setup_queues(struct nullb *nullb)
+{
+	int i, ret;
+
+	nullb->queues = kcalloc(submit_queues, sizeof(struct nullb_queue),
+				GFP_KERNEL);
+	if (!nullb->queues)
+		return -ENOMEM;
+
+	nullb->nr_queues = submit_queues;
+	if (queue_mode == NULL_Q_MQ)
+		return 0;
+
+	for (i = 0; i < submit_queues; i++) {
+		ret = setup_commands(&nullb->queues[i]);
+		if (ret) {
+			nullb->nr_queues = i;
+			cleanup_queues(nullb);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static struct request_queue *null_alloc_queue(struct nullb *nullb)
+{
+	struct request_queue *q;
+
+	switch (queue_mode) {
+	case NULL_Q_MQ: {
+		struct blk_mq_reg reg = {
+			.ops		= &null_mq_ops,
+			.nr_hw_queues	= submit_queues,
+			.queue_depth	= hw_queue_depth,
+			.cmd_size	= sizeof(struct nullb_cmd),
+			.numa_node	= home_node,
+			.flags		= BLK_MQ_F_SHOULD_MERGE,
+		};
+
+		return blk_mq_init_queue(&reg, nullb);
+	}
+	case NULL_Q_RQ:
+		q = blk_init_queue_node(null_request_fn, &nullb->lock,
+					home_node);
+		if (q) {
+			blk_queue_prep_rq(q, null_rq_prep_fn);
+			blk_queue_softirq_done(q, null_softirq_done_fn);
+		}
+		return q;
+	default:
+		q = blk_alloc_queue_node(GFP_KERNEL, home_node);
+		if (q)
+			blk_queue_make_request(q, null_queue_bio);
+		return q;
+	}
+}
+
+static int null_add_dev(void)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	sector_t size;
+	int ret = -ENOMEM;
+
+	nullb = kzalloc_node(sizeof(*nullb), GFP_KERNEL, home_node);
+	if (!nullb)
+		goto out;
+
+	spin_lock_init(&nullb->lock);
+
+	ret = setup_queues(nullb);
+	if (ret)
+		goto out_free_nullb;
+
+	ret = -ENOMEM;
+	nullb->q = null_alloc_queue(nullb);
+	if (!nullb->q)
+		goto out_cleanup_queues;
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	disk = nullb->disk = alloc_disk_node(1, home_node);
+	if (!disk)
+		goto out_cleanup_blk_queue;
+
+	mutex_lock(&nullb_mutex);
+	list_add_tail(&nullb->list, &nullb_list);
+	nullb->index = nullb_indexes++;
+	mutex_unlock(&nullb_mutex);
+
+	size = (sector_t)gb << 30;
+	set_capacity(disk, size >> 9);
+
+	disk->flags		|= GENHD_FL_EXT_DEVT;
+	disk->major		= null_major;
+	disk->first_minor	= nullb->index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	sprintf(disk->disk_name, "nullb%d", nullb->index);
+	add_disk(disk);
+	return 0;
+
+out_cleanup_blk_queue:
+	blk_cleanup_queue(nullb->q);
+out_cleanup_queues:
+	cleanup_queues(nullb);
+out_free_nullb:
+	kfree(nullb);
+out:
+	return ret;
+}
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del_init(&nullb->list);
+
+	del_gendisk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	put_disk(nullb->disk);
+	cleanup_queues(nullb);
+	kfree(nullb);
+}
+
+static void null_del_devs(void)
+{
+	struct nullb *nullb;
+
+	mutex_lock(&nullb_mutex);
+	while (!list_empty(&nullb_list)) {
+		nullb = list_first_entry(&nullb_list, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	mutex_unlock(&nullb_mutex);
+}
+
+static void null_cancel_timers(void)
+{
+	int cpu;
+
+	if (irqmode != NULL_IRQ_TIMER)
+		return;
+
+	for_each_possible_cpu(cpu)
+		hrtimer_cancel(&per_cpu(completion_queues, cpu).timer);
+}
+
+static int __init null_init(void)
+{
+	unsigned int i;
+	int ret;
+
+	if (bs < 512 || bs > PAGE_SIZE || !is_power_of_2(bs)) {
+		pr_warn("null_blk: invalid block size %d, using 512\n", bs);
+		bs = 512;
+	}
+
+	if (queue_mode < NULL_Q_BIO || queue_mode > NULL_Q_MQ) {
+		pr_warn("null_blk: invalid queue_mode %d, using %d\n",
+			queue_mode, NULL_Q_MQ);
+		queue_mode = NULL_Q_MQ;
+	}
+
+	if (irqmode < NULL_IRQ_NONE || irqmode > NULL_IRQ_TIMER) {
+		pr_warn("null_blk: invalid irqmode %d, using %d\n",
+			irqmode, NULL_IRQ_SOFTIRQ);
+		irqmode = NULL_IRQ_SOFTIRQ;
+	}
+
+	/* a request_fn queue is fed from a single command pool */
+	if (queue_mode == NULL_Q_RQ)
+		submit_queues = 1;
+	else
+		submit_queues = clamp_t(int, submit_queues, 1, nr_cpu_ids);
+
+	hw_queue_depth = clamp_t(int, hw_queue_depth, 1, BLK_MQ_MAX_DEPTH);
+
+	for_each_possible_cpu(i) {
+		struct completion_queue *cq = &per_cpu(completion_queues, i);
+
+		init_llist_head(&cq->list);
+
+		if (irqmode != NULL_IRQ_TIMER)
+			continue;
+
+		hrtimer_init(&cq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		cq->timer.function = null_cmd_timer_expired;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		ret = null_add_dev();
+		if (ret) {
+			null_del_devs();
+			null_cancel_timers();
+			unregister_blkdev(null_major, "nullb");
+			return ret;
+		}
+	}
+
+	pr_info("null_blk: module loaded\n");
+	return 0;
+}
+
+static void __exit null_exit(void)
+{
+	null_del_devs();
+	null_cancel_timers();
+	unregister_blkdev(null_major, "nullb");
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_DESCRIPTION("Null block device for block layer benchmarking");
+MODULE_LICENSE("GPL");
@@ -71,6 +71,9 @@
 #define NR_HASH			(PAGE_SIZE / sizeof(struct hlist_head))
 #define HASH_MASK		(NR_HASH - 1)
 
+/* Stripe workers of all arrays, see raid5_wakeup_stripe_thread() */
+static struct workqueue_struct *raid5_wq;
+
 static inline struct hlist_head *stripe_hash(struct r5conf *conf, sector_t sect)
 {
 	int hash = (sect >> STRIPE_SHIFT) & HASH_MASK;
@@ -190,6 +193,48 @@ static int stripe_operations_active(struct stripe_head *sh)
 	       test_bit(STRIPE_COMPUTE_RUN, &sh->state);
 }
 
+/* Pick the next online CPU of the group's node for a worker.  Nodes
+ * without online CPUs borrow the current one.
+ */
+static int raid5_worker_cpu(struct r5worker_group *group)
+{
+	const struct cpumask *mask = cpumask_of_node(group->node);
+	int cpu;
+
+	cpu = cpumask_next_and(group->last_cpu, mask, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first_and(mask, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = raw_smp_processor_id();
+	group->last_cpu = cpu;
+	return cpu;
+}
+
+/* A stripe was added to handle_list: get an idle worker of the local
+ * node going.  raid5d is woken regardless, it still handles stripes
+ * too.  Called with device_lock held.
+ */
+static void raid5_wakeup_stripe_thread(struct r5conf *conf)
+{
+	struct r5worker_group *group;
+	int i;
+
+	if (!conf->worker_cnt_per_group)
+		return;
+
+	group = &conf->worker_groups[cpu_to_node(raw_smp_processor_id())];
+	for (i = 0; i < conf->worker_cnt_per_group; i++) {
+		struct r5worker *worker = &group->workers[i];
+
+		if (!worker->working) {
+			worker->working = 1;
+			queue_work_on(raid5_worker_cpu(group), raid5_wq,
+				      &worker->work);
+			return;
+		}
+	}
+}
+
 static void __release_stripe(struct r5conf *conf, struct stripe_head *sh)
 {
 	if (atomic_dec_and_test(&sh->count)) {
@@ -204,6 +249,7 @@ static void __release_stripe(struct r5conf *conf, struct stripe_head *sh)
 			else {
 				clear_bit(STRIPE_BIT_DELAY, &sh->state);
 				list_add_tail(&sh->lru, &conf->handle_list);
+				raid5_wakeup_stripe_thread(conf);
 			}
 			md_wakeup_thread(conf->mddev->thread);
 		} else {
@@ -4523,6 +4569,104 @@ static void raid5d(struct mddev *mddev)
 	pr_debug("--- raid5d inactive\n");
 }
 
+/*
+ * A stripe worker: handle stripes from handle_list until it is empty.
+ * The stripe state machine already copes with handle_stripe() being
+ * called from several contexts: STRIPE_ACTIVE keeps a stripe from being
+ * handled twice at once, and the per-cpu scribble space is only used
+ * with preemption disabled.
+ */
+static void raid5_do_work(struct work_struct *work)
+{
+	struct r5worker *worker = container_of(work, struct r5worker, work);
+	struct r5conf *conf = worker->group->conf;
+	struct stripe_head *sh;
+	int handled = 0;
+	struct blk_plug plug;
+
+	pr_debug("+++ raid5worker active\n");
+
+	blk_start_plug(&plug);
+	spin_lock_irq(&conf->device_lock);
+	while ((sh = __get_priority_stripe(conf)) != NULL) {
+		spin_unlock_irq(&conf->device_lock);
+
+		handled++;
+		handle_stripe(sh);
+		release_stripe(sh);
+		cond_resched();
+
+		spin_lock_irq(&conf->device_lock);
+	}
+	worker->working = 0;
+	spin_unlock_irq(&conf->device_lock);
+	pr_debug("%d stripes handled\n", handled);
+
+	async_tx_issue_pending_all();
+	blk_finish_plug(&plug);
+
+	pr_debug("--- raid5worker inactive\n");
+}
+
+static int alloc_thread_groups(struct r5conf *conf, int cnt,
+			       struct r5worker_group **groups)
+{
+	struct r5worker_group *new;
+	struct r5worker *workers;
+	int i, j;
+
+	*groups = NULL;
+	if (cnt == 0)
+		return 0;
+
+	new = kcalloc(nr_node_ids, sizeof(*new), GFP_KERNEL);
+	workers = kcalloc(nr_node_ids * cnt, sizeof(*workers), GFP_KERNEL);
+	if (!new || !workers) {
+		kfree(new);
+		kfree(workers);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nr_node_ids; i++) {
+		struct r5worker_group *group = &new[i];
+
+		group->workers = workers + i * cnt;
+		group->conf = conf;
+		group->node = i;
+		group->last_cpu = -1;
+		for (j = 0; j < cnt; j++) {
+			INIT_WORK(&group->workers[j].work, raid5_do_work);
+			group->workers[j].group = group;
+		}
+	}
+	*groups = new;
+	return 0;
+}
+
+/* Stop kicking workers and wait for the running ones to finish. */
+static struct r5worker_group *quiesce_thread_groups(struct r5conf *conf)
+{
+	struct r5worker_group *old;
+
+	spin_lock_irq(&conf->device_lock);
+	old = conf->worker_groups;
+	conf->worker_cnt_per_group = 0;
+	conf->worker_groups = NULL;
+	spin_unlock_irq(&conf->device_lock);
+
+	if (old)
+		flush_workqueue(raid5_wq);
+	return old;
+}
+
+static void free_thread_groups(struct r5worker_group *groups)
+{
+	if (groups) {
+		kfree(groups[0].workers);
+		kfree(groups);
+	}
+}
+
 static ssize_t
 raid5_show_stripe_cache_size(struct mddev *mddev, char *page)
 {
@@ -4631,10 +4775,60 @@ stripe_cache_active_show(struct mddev *mddev, char *page)
 static struct md_sysfs_entry
 raid5_stripecache_active = __ATTR_RO(stripe_cache_active);
 
+static ssize_t
+raid5_show_group_thread_cnt(struct mddev *mddev, char *page)
+{
+	struct r5conf *conf = mddev->private;
+	if (conf)
+		return sprintf(page, "%d\n", conf->worker_cnt_per_group);
+	else
+		return 0;
+}
+
+static ssize_t
+raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
+{
+	struct r5conf *conf = mddev->private;
+	struct r5worker_group *new_groups, *old_groups;
+	unsigned long new;
+	int err;
+
+	if (len >= PAGE_SIZE)
+		return -EINVAL;
+	if (!conf)
+		return -ENODEV;
+
+	if (strict_strtoul(page, 10, &new))
+		return -EINVAL;
+	if (new > num_possible_cpus())
+		return -EINVAL;
+	if (new == conf->worker_cnt_per_group)
+		return len;
+
+	err = alloc_thread_groups(conf, new, &new_groups);
+	if (err)
+		return err;
+
+	old_groups = quiesce_thread_groups(conf);
+	free_thread_groups(old_groups);
+
+	spin_lock_irq(&conf->device_lock);
+	conf->worker_groups = new_groups;
+	conf->worker_cnt_per_group = new;
+	spin_unlock_irq(&conf->device_lock);
+	return len;
+}
+
+static struct md_sysfs_entry
+raid5_group_thread_cnt = __ATTR(group_thread_cnt, S_IRUGO | S_IWUSR,
+				raid5_show_group_thread_cnt,
+				raid5_store_group_thread_cnt);
+
 static struct attribute *raid5_attrs[] =  {
 	&raid5_stripecache_size.attr,
 	&raid5_stripecache_active.attr,
 	&raid5_preread_bypass_threshold.attr,
+	&raid5_group_thread_cnt.attr,
 	NULL,
 };
 static struct attribute_group raid5_attrs_group = {
@@ -4682,6 +4876,7 @@ static void raid5_free_percpu(struct r5conf *conf)
 
 static void free_conf(struct r5conf *conf)
 {
+	free_thread_groups(quiesce_thread_groups(conf));
 	shrink_stripes(conf);
 	raid5_free_percpu(conf);
 	kfree(conf->disks);
@@ -6009,6 +6204,10 @@ static struct md_personality raid4_personality =
 
 static int __init raid5_init(void)
 {
+	raid5_wq = alloc_workqueue("raid5wq",
+				   WQ_MEM_RECLAIM | WQ_CPU_INTENSIVE, 0);
+	if (!raid5_wq)
+		return -ENOMEM;
 	register_md_personality(&raid6_personality);
 	register_md_personality(&raid5_personality);
 	register_md_personality(&raid4_personality);
@@ -6020,6 +6219,7 @@ static void raid5_exit(void)
 	unregister_md_personality(&raid6_personality);
 	unregister_md_personality(&raid5_personality);
 	unregister_md_personality(&raid4_personality);
+	destroy_workqueue(raid5_wq);
 }
 
 module_init(raid5_init);
@@ -3,6 +3,7 @@
 
 #include <linux/raid/xor.h>
 #include <linux/dmaengine.h>
+#include <linux/workqueue.h>
 
 /*
  *
@@ -360,6 +361,23 @@ struct disk_info {
 	struct md_rdev	*rdev, *replacement;
 };
 
+/* Stripe workers handle stripes from handle_list alongside raid5d.
+ * There is one group of workers per NUMA node; a worker is queued on
+ * the node of the CPU that made a stripe ready for handling.
+ */
+struct r5worker {
+	struct work_struct	work;
+	struct r5worker_group	*group;
+	int			working; /* protected by device_lock */
+};
+
+struct r5worker_group {
+	struct r5worker		*workers;
+	struct r5conf		*conf;
+	int			node;
+	int			last_cpu;  /* round-robin over the node's CPUs */
+};
+
 struct r5conf {
 	struct hlist_head	*stripe_hashtbl;
 	struct mddev		*mddev;
@@ -449,6 +467,9 @@ struct r5conf {
 	 * the new thread here until we fully activate the array.
 	 */
 	struct md_thread	*thread;
+
+	struct r5worker_group	*worker_groups;	/* one per node */
+	int			worker_cnt_per_group; /* 0: raid5d only */
 };
 
 /*
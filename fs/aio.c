@@ -35,6 +35,11 @@
 #include <linux/eventfd.h>
 #include <linux/blkdev.h>
 #include <linux/compat.h>
+#include <linux/kthread.h>
+#include <linux/vmalloc.h>
+#include <linux/fdtable.h>
+#include <linux/cred.h>
+#include <linux/log2.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -66,6 +71,13 @@ static LIST_HEAD(fput_head);
 static void aio_kick_handler(struct work_struct *);
 static void aio_queue_work(struct kioctx *);
 
+/* how long the submission queue thread polls before going to sleep */
+#define AIO_SQ_IDLE		HZ
+/* and how long it waits for completion ring space before looking again */
+#define AIO_SQ_CQ_WAIT		1
+
+static int aio_sq_thread_start(struct kioctx *ctx);
+
 /* aio_setup
  *	Creates the slab caches used by the aio routines, panic on
  *	failure as this is done early during the boot sequence.
@@ -89,6 +101,11 @@ static void aio_free_ring(struct kioctx *ctx)
 	struct aio_ring_info *info = &ctx->ring_info;
 	long i;
 
+	if (info->sq_ring) {
+		vunmap(info->sq_ring);
+		info->sq_ring = NULL;
+	}
+
 	for (i=0; i<info->nr_pages; i++)
 		put_page(info->ring_pages[i]);
 
@@ -109,7 +126,8 @@ static int aio_setup_ring(struct kioctx *ctx)
 	struct aio_ring_info *info = &ctx->ring_info;
 	unsigned nr_events = ctx->max_reqs;
 	unsigned long size;
-	int nr_pages;
+	unsigned sq_entries = 0;
+	int nr_pages, sq_pages = 0;
 
 	/* Compensate for the ring buffer's head/tail overlap entry */
 	nr_events += 2;	/* 1 is required, 2 for good luck */
@@ -123,6 +141,15 @@ static int aio_setup_ring(struct kioctx *ctx)
 
 	nr_events = (PAGE_SIZE * nr_pages - sizeof(struct aio_ring)) / sizeof(struct io_event);
 
+	/* The submission queue follows the events, starting on a new page */
+	if (ctx->flags & AIO_SETUP_SQRING) {
+		sq_entries = roundup_pow_of_two(ctx->max_reqs);
+		size = sizeof(struct aio_sq_ring);
+		size += sizeof(struct iocb) * sq_entries;
+		sq_pages = (size + PAGE_SIZE-1) >> PAGE_SHIFT;
+		nr_pages += sq_pages;
+	}
+
 	info->nr = 0;
 	info->ring_pages = info->internal_pages;
 	if (nr_pages > AIO_RING_PAGES) {
@@ -157,6 +184,28 @@ static int aio_setup_ring(struct kioctx *ctx)
 
 	ctx->user_id = info->mmap_base;
 
+	if (sq_pages) {
+		struct aio_sq_ring *sq;
+
+		sq = vmap(info->ring_pages + nr_pages - sq_pages, sq_pages,
+			  VM_MAP, PAGE_KERNEL);
+		if (!sq) {
+			aio_free_ring(ctx);
+			return -ENOMEM;
+		}
+		sq->head = sq->tail = 0;
+		sq->mask = sq_entries - 1;
+		sq->flags = 0;
+		sq->dropped = 0;
+
+		info->sq_ring = sq;
+		info->sq_user = info->mmap_base +
+				((nr_pages - sq_pages) << PAGE_SHIFT);
+		info->sq_nr_pages = sq_pages;
+		info->sq_mask = sq_entries - 1;	/* trusted copy */
+		info->sq_head = 0;
+	}
+
 	info->nr = nr_events;		/* trusted copy */
 
 	ring = kmap_atomic(info->ring_pages[0]);
@@ -165,6 +214,8 @@ static int aio_setup_ring(struct kioctx *ctx)
 	ring->head = ring->tail = 0;
 	ring->magic = AIO_RING_MAGIC;
 	ring->compat_features = AIO_RING_COMPAT_FEATURES;
+	if (sq_pages)
+		ring->compat_features |= AIO_RING_COMPAT_SQRING;
 	ring->incompat_features = AIO_RING_INCOMPAT_FEATURES;
 	ring->header_length = sizeof(struct aio_ring);
 	kunmap_atomic(ring);
@@ -239,7 +290,7 @@ static inline void put_ioctx(struct kioctx *kioctx)
 /* ioctx_alloc
  *	Allocates and initializes an ioctx.  Returns an ERR_PTR if it failed.
  */
-static struct kioctx *ioctx_alloc(unsigned nr_events)
+static struct kioctx *ioctx_alloc(unsigned nr_events, unsigned flags)
 {
 	struct mm_struct *mm;
 	struct kioctx *ctx;
@@ -260,13 +311,16 @@ static struct kioctx *ioctx_alloc(unsigned nr_events)
 		return ERR_PTR(-ENOMEM);
 
 	ctx->max_reqs = nr_events;
+	ctx->flags = flags;
 	mm = ctx->mm = current->mm;
 	atomic_inc(&mm->mm_count);
 
 	atomic_set(&ctx->users, 2);
 	spin_lock_init(&ctx->ctx_lock);
 	spin_lock_init(&ctx->ring_info.ring_lock);
+	mutex_init(&ctx->ring_info.sq_mutex);
 	init_waitqueue_head(&ctx->wait);
+	init_waitqueue_head(&ctx->sq_wait);
 
 	INIT_LIST_HEAD(&ctx->active_reqs);
 	INIT_LIST_HEAD(&ctx->run_list);
@@ -304,6 +358,25 @@ out_freectx:
 	return ERR_PTR(err);
 }
 
+/* aio_sq_thread_stop
+ *	Stops the submission queue polling thread, if any, and drops the
+ *	files and credentials it was submitting with.
+ */
+static void aio_sq_thread_stop(struct kioctx *ctx)
+{
+	struct task_struct *thread = xchg(&ctx->sq_thread, NULL);
+
+	if (!thread)
+		return;
+
+	kthread_stop(thread);
+	put_task_struct(thread);
+	put_files_struct(ctx->sq_files);
+	put_cred(ctx->sq_cred);
+	ctx->sq_files = NULL;
+	ctx->sq_cred = NULL;
+}
+
 /* kill_ctx
  *	Cancels all outstanding aio requests on an aio context.  Used 
  *	when the processes owning a context have all exited to encourage 
@@ -316,6 +389,8 @@ static void kill_ctx(struct kioctx *ctx)
 	DECLARE_WAITQUEUE(wait, tsk);
 	struct io_event res;
 
+	aio_sq_thread_stop(ctx);
+
 	spin_lock_irq(&ctx->ctx_lock);
 	ctx->dead = 1;
 	while (!list_empty(&ctx->active_reqs)) {
@@ -951,6 +1026,48 @@ void kick_iocb(struct kiocb *iocb)
 }
 EXPORT_SYMBOL(kick_iocb);
 
+/* __aio_add_event
+ *	Appends an event to the completion ring.  Must be called holding
+ *	ctx->ctx_lock, with room for the event accounted for in
+ *	ctx->reqs_active.
+ */
+static void __aio_add_event(struct kioctx *ctx, u64 obj, u64 data,
+			    long res, long res2)
+{
+	struct aio_ring_info	*info = &ctx->ring_info;
+	struct aio_ring	*ring;
+	struct io_event	*event;
+	unsigned long	tail;
+
+	assert_spin_locked(&ctx->ctx_lock);
+
+	ring = kmap_atomic(info->ring_pages[0]);
+
+	tail = info->tail;
+	event = aio_ring_event(info, tail);
+	if (++tail >= info->nr)
+		tail = 0;
+
+	event->obj = obj;
+	event->data = data;
+	event->res = res;
+	event->res2 = res2;
+
+	dprintk("aio_add_event: %p[%lu]: %Lx %Lx %lx %lx\n",
+		ctx, tail, obj, data, res, res2);
+
+	/* after flagging the request as done, we
+	 * must never even look at it again
+	 */
+	smp_wmb();	/* make event visible before updating tail */
+
+	info->tail = tail;
+	ring->tail = tail;
+
+	put_aio_ring_event(event);
+	kunmap_atomic(ring);
+}
+
 /* aio_complete
  *	Called when the io request on the given iocb is complete.
  *	Returns true if this is the last user of the request.  The 
@@ -959,11 +1076,7 @@ EXPORT_SYMBOL(kick_iocb);
 int aio_complete(struct kiocb *iocb, long res, long res2)
 {
 	struct kioctx	*ctx = iocb->ki_ctx;
-	struct aio_ring_info	*info;
-	struct aio_ring	*ring;
-	struct io_event	*event;
 	unsigned long	flags;
-	unsigned long	tail;
 	int		ret;
 
 	/*
@@ -981,8 +1094,6 @@ int aio_complete(struct kiocb *iocb, long res, long res2)
 		return 1;
 	}
 
-	info = &ctx->ring_info;
-
 	/* add a completion event to the ring buffer.
 	 * must be done holding ctx->ctx_lock to prevent
 	 * other code from messing with the tail
@@ -1001,34 +1112,10 @@ int aio_complete(struct kiocb *iocb, long res, long res2)
 	if (kiocbIsCancelled(iocb))
 		goto put_rq;
 
-	ring = kmap_atomic(info->ring_pages[0]);
-
-	tail = info->tail;
-	event = aio_ring_event(info, tail);
-	if (++tail >= info->nr)
-		tail = 0;
-
-	event->obj = (u64)(unsigned long)iocb->ki_obj.user;
-	event->data = iocb->ki_user_data;
-	event->res = res;
-	event->res2 = res2;
-
-	dprintk("aio_complete: %p[%lu]: %p: %p %Lx %lx %lx\n",
-		ctx, tail, iocb, iocb->ki_obj.user, iocb->ki_user_data,
-		res, res2);
-
-	/* after flagging the request as done, we
-	 * must never even look at it again
-	 */
-	smp_wmb();	/* make event visible before updating tail */
+	__aio_add_event(ctx, (u64)(unsigned long)iocb->ki_obj.user,
+			iocb->ki_user_data, res, res2);
 
-	info->tail = tail;
-	ring->tail = tail;
-
-	put_aio_ring_event(event);
-	kunmap_atomic(ring);
-
-	pr_debug("added to ring %p at [%lu]\n", iocb, tail);
+	pr_debug("added to ring %p\n", iocb);
 
 	/*
 	 * Check if the user asked us to deliver the result through an
@@ -1093,6 +1180,10 @@ static int aio_read_evt(struct kioctx *ioctx, struct io_event *ent)
 	}
 	spin_unlock(&info->ring_lock);
 
+	/* the polling thread may be waiting for completion ring space */
+	if (ret && waitqueue_active(&ioctx->sq_wait))
+		wake_up(&ioctx->sq_wait);
+
 out:
 	kunmap_atomic(ring);
 	dprintk("leaving aio_read_evt: %d  h%lu t%lu\n", ret,
@@ -1295,7 +1386,8 @@ static void io_destroy(struct kioctx *ioctx)
  *	pointer is passed for ctxp.  Will fail with -ENOSYS if not
  *	implemented.
  */
-SYSCALL_DEFINE2(io_setup, unsigned, nr_events, aio_context_t __user *, ctxp)
+static long do_io_setup(unsigned nr_events, unsigned flags,
+			aio_context_t __user *ctxp)
 {
 	struct kioctx *ioctx = NULL;
 	unsigned long ctx;
@@ -1312,10 +1404,14 @@ SYSCALL_DEFINE2(io_setup, unsigned, nr_events, aio_context_t __user *, ctxp)
 		goto out;
 	}
 
-	ioctx = ioctx_alloc(nr_events);
+	ioctx = ioctx_alloc(nr_events, flags);
 	ret = PTR_ERR(ioctx);
 	if (!IS_ERR(ioctx)) {
-		ret = put_user(ioctx->user_id, ctxp);
+		ret = 0;
+		if (flags & AIO_SETUP_SQPOLL)
+			ret = aio_sq_thread_start(ioctx);
+		if (!ret)
+			ret = put_user(ioctx->user_id, ctxp);
 		if (ret)
 			io_destroy(ioctx);
 		put_ioctx(ioctx);
@@ -1325,6 +1421,36 @@ out:
 	return ret;
 }
 
+SYSCALL_DEFINE2(io_setup, unsigned, nr_events, aio_context_t __user *, ctxp)
+{
+	return do_io_setup(nr_events, 0, ctxp);
+}
+
+/* sys_io_setup_ring:
+ *	Like io_setup(), but flags may request a submission queue that is
+ *	mapped after the completion events (AIO_SETUP_SQRING), optionally
+ *	serviced by a polling kernel thread (AIO_SETUP_SQPOLL).  Submitting
+ *	from the queue avoids copying in an iocb pointer array and the
+ *	iocbs themselves; with a polling thread it avoids the io_submit()
+ *	call altogether while the thread is awake.  May fail with -EPERM if
+ *	AIO_SETUP_SQPOLL is requested without CAP_SYS_ADMIN, or with -EINVAL
+ *	for unknown flags, in addition to the io_setup() errors.
+ */
+SYSCALL_DEFINE3(io_setup_ring, unsigned, nr_events, unsigned, flags,
+		aio_context_t __user *, ctxp)
+{
+	if (flags & ~(AIO_SETUP_SQRING | AIO_SETUP_SQPOLL))
+		return -EINVAL;
+
+	if (flags & AIO_SETUP_SQPOLL) {
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+		flags |= AIO_SETUP_SQRING;
+	}
+
+	return do_io_setup(nr_events, flags, ctxp);
+}
+
 /* sys_io_destroy:
  *	Destroy the aio_context specified.  May cancel any outstanding 
  *	AIOs and block on completion.  Will fail with -ENOSYS if not
@@ -1389,6 +1515,18 @@ static ssize_t aio_rw_vect_retry(struct kiocb *iocb)
 	if (iocb->ki_pos < 0)
 		return -EINVAL;
 
+	/*
+	 * Buffered reads would block in the read path on every page cache
+	 * miss.  Start readahead instead and come back from the aio
+	 * workqueue once the pages have been read in.
+	 */
+	if (opcode == IOCB_CMD_PREADV && !(file->f_flags & O_DIRECT) &&
+	    S_ISREG(inode->i_mode) && mapping->a_ops->readpage) {
+		ret = filemap_aio_read_wait(iocb, iocb->ki_pos, iocb->ki_left);
+		if (ret)
+			return ret;
+	}
+
 	do {
 		ret = rw_op(iocb, &iocb->ki_iovec[iocb->ki_cur_seg],
 			    iocb->ki_nr_segs - iocb->ki_cur_seg,
@@ -1676,6 +1814,225 @@ out_put_req:
 	return ret;
 }
 
+/* aio_sq_fail
+ *	Reports an iocb from the submission queue that could not be started.
+ *	The submitter isn't around to see an error return, so it gets an
+ *	event carrying the error instead.
+ */
+static void aio_sq_fail(struct kioctx *ctx, struct iocb __user *user_iocb,
+			struct iocb *iocb, long res)
+{
+	struct aio_ring_info *info = &ctx->ring_info;
+	struct aio_ring *ring;
+	long avail;
+
+	spin_lock_irq(&ctx->ctx_lock);
+	ring = kmap_atomic(info->ring_pages[0]);
+	avail = aio_ring_avail(info, ring) - ctx->reqs_active;
+	kunmap_atomic(ring);
+
+	if (avail > 0)
+		__aio_add_event(ctx, (u64)(unsigned long)user_iocb,
+				iocb->aio_data, res, 0);
+	else
+		info->sq_ring->dropped++;
+
+	smp_mb();
+	if (waitqueue_active(&ctx->wait))
+		wake_up(&ctx->wait);
+	spin_unlock_irq(&ctx->ctx_lock);
+}
+
+/* aio_sq_submit
+ *	Submits up to nr iocbs from the submission queue.  Returns the
+ *	number of entries consumed, or an error if none could be.  Entries
+ *	that are refused for lack of completion ring space are left on the
+ *	queue for a later call.
+ */
+static long aio_sq_submit(struct kioctx *ctx, long nr, bool compat)
+{
+	struct aio_ring_info *info = &ctx->ring_info;
+	struct aio_sq_ring *sq = info->sq_ring;
+	struct kiocb_batch batch;
+	struct blk_plug plug;
+	unsigned head, pending;
+	long ret = 0;
+	long i = 0;
+
+	mutex_lock(&info->sq_mutex);
+
+	head = info->sq_head;
+	pending = ACCESS_ONCE(sq->tail) - head;
+	smp_rmb();	/* read the tail before the entries it covers */
+
+	/* userspace owns tail; don't trust it to be sane */
+	if (pending > info->sq_mask + 1)
+		pending = info->sq_mask + 1;
+	if (nr > pending)
+		nr = pending;
+	if (!nr)
+		goto out;
+
+	kiocb_batch_init(&batch, nr);
+	blk_start_plug(&plug);
+
+	for (i = 0; i < nr; i++) {
+		unsigned idx = head & info->sq_mask;
+		struct iocb __user *user_iocb;
+		struct iocb tmp;
+
+		user_iocb = (struct iocb __user *)(info->sq_user +
+				offsetof(struct aio_sq_ring, iocbs) +
+				idx * sizeof(struct iocb));
+		tmp = sq->iocbs[idx];
+
+		ret = io_submit_one(ctx, user_iocb, &tmp, &batch, compat);
+		if (ret == -EAGAIN)
+			break;
+		if (ret) {
+			aio_sq_fail(ctx, user_iocb, &tmp, ret);
+			ret = 0;
+		}
+		head++;
+	}
+	blk_finish_plug(&plug);
+
+	kiocb_batch_free(ctx, &batch);
+
+	/* finish reading the entries before handing them back */
+	smp_mb();
+	info->sq_head = head;
+	sq->head = head;
+out:
+	mutex_unlock(&info->sq_mutex);
+	return i ? i : ret;
+}
+
+static inline bool aio_sq_pending(struct kioctx *ctx)
+{
+	struct aio_ring_info *info = &ctx->ring_info;
+
+	return ACCESS_ONCE(info->sq_ring->tail) != info->sq_head;
+}
+
+/*
+ * aio_sq_thread:
+ *	Polls the submission queue of an AIO_SETUP_SQPOLL context and
+ *	submits whatever shows up there, using the files, credentials and
+ *	mm of the task that set the context up.  After AIO_SQ_IDLE without
+ *	work it sets AIO_SQ_NEED_WAKEUP and sleeps until io_submit() kicks
+ *	it.  While the completion ring is full it sleeps until an event is
+ *	reaped, or for AIO_SQ_CQ_WAIT if userspace reaps from the ring.
+ */
+static int aio_sq_thread(void *data)
+{
+	struct kioctx *ctx = data;
+	struct aio_sq_ring *sq = ctx->ring_info.sq_ring;
+	struct files_struct *old_files = current->files;
+	mm_segment_t oldfs = get_fs();
+	const struct cred *old_cred;
+	unsigned long idle = jiffies + AIO_SQ_IDLE;
+	DEFINE_WAIT(wait);
+	long ret;
+
+	task_lock(current);
+	current->files = ctx->sq_files;
+	task_unlock(current);
+	old_cred = override_creds(ctx->sq_cred);
+	set_fs(USER_DS);
+	use_mm(ctx->mm);
+
+	while (!kthread_should_stop()) {
+		ret = aio_sq_submit(ctx, LONG_MAX, ctx->sq_compat);
+		if (ret > 0) {
+			idle = jiffies + AIO_SQ_IDLE;
+			cond_resched();
+			continue;
+		}
+
+		if (ret == -EAGAIN) {
+			/*
+			 * No room for more completions; spinning won't make
+			 * any, so wait for the submitter to reap some.
+			 */
+			prepare_to_wait(&ctx->sq_wait, &wait,
+					TASK_INTERRUPTIBLE);
+			if (!kthread_should_stop())
+				schedule_timeout(AIO_SQ_CQ_WAIT);
+			finish_wait(&ctx->sq_wait, &wait);
+			idle = jiffies + AIO_SQ_IDLE;
+			continue;
+		}
+
+		if (time_before(jiffies, idle)) {
+			cpu_relax();
+			cond_resched();
+			continue;
+		}
+
+		prepare_to_wait(&ctx->sq_wait, &wait, TASK_INTERRUPTIBLE);
+		sq->flags |= AIO_SQ_NEED_WAKEUP;
+		/* order the flag store against re-reading the tail */
+		smp_mb();
+		if (!aio_sq_pending(ctx) && !kthread_should_stop())
+			schedule();
+		finish_wait(&ctx->sq_wait, &wait);
+		sq->flags &= ~AIO_SQ_NEED_WAKEUP;
+		idle = jiffies + AIO_SQ_IDLE;
+	}
+
+	unuse_mm(ctx->mm);
+	set_fs(oldfs);
+	revert_creds(old_cred);
+	task_lock(current);
+	current->files = old_files;
+	task_unlock(current);
+	return 0;
+}
+
+static int aio_sq_thread_start(struct kioctx *ctx)
+{
+	struct task_struct *thread;
+
+	ctx->sq_files = get_files_struct(current);
+	ctx->sq_cred = get_current_cred();
+	ctx->sq_compat = is_compat_task();
+
+	thread = kthread_create(aio_sq_thread, ctx, "aio-sq/%d",
+				task_pid_nr(current));
+	if (IS_ERR(thread)) {
+		put_files_struct(ctx->sq_files);
+		put_cred(ctx->sq_cred);
+		ctx->sq_files = NULL;
+		ctx->sq_cred = NULL;
+		return PTR_ERR(thread);
+	}
+
+	get_task_struct(thread);
+	ctx->sq_thread = thread;
+	wake_up_process(thread);
+	return 0;
+}
+
+/* aio_sq_enter
+ *	io_submit() with a NULL iocb array on a context that has a
+ *	submission queue: either submit from the queue directly, or wake
+ *	up the polling thread if it has gone to sleep.
+ */
+static long aio_sq_enter(struct kioctx *ctx, long nr, bool compat)
+{
+	if (ctx->flags & AIO_SETUP_SQPOLL) {
+		smp_mb();
+		/* also kicks a thread waiting for completion ring space */
+		if ((ACCESS_ONCE(ctx->ring_info.sq_ring->flags) &
+		     AIO_SQ_NEED_WAKEUP) || waitqueue_active(&ctx->sq_wait))
+			wake_up(&ctx->sq_wait);
+		return 0;
+	}
+
+	return aio_sq_submit(ctx, nr, compat);
+}
+
 long do_io_submit(aio_context_t ctx_id, long nr,
 		  struct iocb __user *__user *iocbpp, bool compat)
 {
@@ -1700,6 +2057,12 @@ long do_io_submit(aio_context_t ctx_id, long nr,
 		return -EINVAL;
 	}
 
+	if (!iocbpp && ctx->ring_info.sq_ring) {
+		ret = aio_sq_enter(ctx, nr, compat);
+		put_ioctx(ctx);
+		return ret;
+	}
+
 	kiocb_batch_init(&batch, nr);
 
 	blk_start_plug(&plug);
@@ -1735,15 +2098,18 @@ long do_io_submit(aio_context_t ctx_id, long nr,
 
 /* sys_io_submit:
  *	Queue the nr iocbs pointed to by iocbpp for processing.  Returns
- *	the number of iocbs queued.  May return -EINVAL if the aio_context
- *	specified by ctx_id is invalid, if nr is < 0, if the iocb at
- *	*iocbpp[0] is not properly initialized, if the operation specified
- *	is invalid for the file descriptor in the iocb.  May fail with
- *	-EFAULT if any of the data structures point to invalid data.  May
- *	fail with -EBADF if the file descriptor specified in the first
- *	iocb is invalid.  May fail with -EAGAIN if insufficient resources
- *	are available to queue any iocbs.  Will return 0 if nr is 0.  Will
- *	fail with -ENOSYS if not implemented.
+ *	the number of iocbs queued.  If iocbpp is NULL and the context has
+ *	a submission queue, up to nr iocbs are taken from the queue instead
+ *	(or its polling thread is woken up, see io_setup_ring()).  May
+ *	return -EINVAL if the aio_context specified by ctx_id is invalid,
+ *	if nr is < 0, if the iocb at *iocbpp[0] is not properly
+ *	initialized, if the operation specified is invalid for the file
+ *	descriptor in the iocb.  May fail with -EFAULT if any of the data
+ *	structures point to invalid data.  May fail with -EBADF if the
+ *	file descriptor specified in the first iocb is invalid.  May fail
+ *	with -EAGAIN if insufficient resources are available to queue any
+ *	iocbs.  Will return 0 if nr is 0.  Will fail with -ENOSYS if not
+ *	implemented.
  */
 SYSCALL_DEFINE3(io_submit, aio_context_t, ctx_id, long, nr,
 		struct iocb __user * __user *, iocbpp)
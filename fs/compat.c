@@ -498,6 +498,26 @@ compat_sys_io_setup(unsigned nr_reqs, u32 __user *ctx32p)
 	return ret;
 }
 
+asmlinkage long
+compat_sys_io_setup_ring(unsigned nr_reqs, unsigned flags, u32 __user *ctx32p)
+{
+	long ret;
+	aio_context_t ctx64;
+
+	mm_segment_t oldfs = get_fs();
+	if (unlikely(get_user(ctx64, ctx32p)))
+		return -EFAULT;
+
+	set_fs(KERNEL_DS);
+	/* The __user pointer cast is valid because of the set_fs() */
+	ret = sys_io_setup_ring(nr_reqs, flags, (aio_context_t __user *) &ctx64);
+	set_fs(oldfs);
+	/* truncating is ok because it's a user address */
+	if (!ret)
+		ret = put_user((u32) ctx64, ctx32p);
+	return ret;
+}
+
 asmlinkage long
 compat_sys_io_getevents(aio_context_t ctx_id,
 				 unsigned long min_nr,
@@ -624,6 +644,10 @@ compat_sys_io_submit(aio_context_t ctx_id, int nr, u32 __user *iocb)
 	if (unlikely(nr < 0))
 		return -EINVAL;
 
+	/* submission from the context's own submission queue */
+	if (!iocb)
+		return do_io_submit(ctx_id, nr, NULL, 1);
+
 	if (nr > MAX_AIO_SUBMITS)
 		nr = MAX_AIO_SUBMITS;
 	
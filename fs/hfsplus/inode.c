@@ -214,10 +214,10 @@ static struct dentry *hfsplus_file_lookup(struct inode *dir,
 	/*
 	 * __mark_inode_dirty expects inodes to be hashed.  Since we don't
 	 * want resource fork inodes in the regular inode space, we make them
-	 * appear hashed, but do not put on any lists.  hlist_del()
-	 * will work fine and require no locking.
+	 * appear hashed, but do not put on any lists.  Unhashing them
+	 * again only touches the inode itself.
 	 */
-	hlist_add_fake(&inode->i_hash);
+	inode_fake_hash(inode);
 
 	mark_inode_dirty(inode);
 out:
@@ -104,7 +104,22 @@ extern long do_handle_open(int mountdirfd,
 /*
  * inode.c
  */
-extern spinlock_t inode_sb_list_lock;
+DECLARE_LGLOCK(inode_sb_list_lglock);
+
+/*
+ * sb->s_inodes is split into one list per cpu, each protected by that
+ * cpu's inode_sb_list_lglock lock.
+ */
+static inline struct list_head *sb_inode_list(struct super_block *sb, int cpu)
+{
+#ifdef CONFIG_SMP
+	return per_cpu_ptr(sb->s_inodes, cpu);
+#else
+	return &sb->s_inodes;
+#endif
+}
+
+extern bool sb_has_inodes(struct super_block *);
 
 /*
  * fs-writeback.c
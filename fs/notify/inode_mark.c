@@ -236,80 +236,92 @@ out:
 
 /**
  * fsnotify_unmount_inodes - an sb is unmounting.  handle any watched inodes.
- * @list: list of inodes being unmounted (sb->s_inodes)
+ * @sb: superblock being unmounted
  *
  * Called during unmount with no locks held, so needs to be safe against
- * concurrent modifiers. We temporarily drop inode_sb_list_lock and CAN block.
+ * concurrent modifiers. We temporarily drop the s_inodes list lock and CAN
+ * block.
  */
-void fsnotify_unmount_inodes(struct list_head *list)
+void fsnotify_unmount_inodes(struct super_block *sb)
 {
 	struct inode *inode, *next_i, *need_iput = NULL;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct list_head *list = sb_inode_list(sb, cpu);
+
+		lg_local_lock_cpu(inode_sb_list_lglock, cpu);
+		list_for_each_entry_safe(inode, next_i, list, i_sb_list) {
+			struct inode *need_iput_tmp;
+
+			/*
+			 * We cannot __iget() an inode in state I_FREEING,
+			 * I_WILL_FREE, or I_NEW which is fine because by that
+			 * point the inode cannot have any associated watches.
+			 */
+			spin_lock(&inode->i_lock);
+			if (inode->i_state & (I_FREEING|I_WILL_FREE|I_NEW)) {
+				spin_unlock(&inode->i_lock);
+				continue;
+			}
 
-	spin_lock(&inode_sb_list_lock);
-	list_for_each_entry_safe(inode, next_i, list, i_sb_list) {
-		struct inode *need_iput_tmp;
+			/*
+			 * If i_count is zero, the inode cannot have any
+			 * watches and doing an __iget/iput with MS_ACTIVE
+			 * clear would actually evict all inodes with zero
+			 * i_count from icache which is unnecessarily violent
+			 * and may in fact be illegal to do.
+			 */
+			if (!atomic_read(&inode->i_count)) {
+				spin_unlock(&inode->i_lock);
+				continue;
+			}
 
-		/*
-		 * We cannot __iget() an inode in state I_FREEING,
-		 * I_WILL_FREE, or I_NEW which is fine because by that point
-		 * the inode cannot have any associated watches.
-		 */
-		spin_lock(&inode->i_lock);
-		if (inode->i_state & (I_FREEING|I_WILL_FREE|I_NEW)) {
-			spin_unlock(&inode->i_lock);
-			continue;
-		}
+			need_iput_tmp = need_iput;
+			need_iput = NULL;
 
-		/*
-		 * If i_count is zero, the inode cannot have any watches and
-		 * doing an __iget/iput with MS_ACTIVE clear would actually
-		 * evict all inodes with zero i_count from icache which is
-		 * unnecessarily violent and may in fact be illegal to do.
-		 */
-		if (!atomic_read(&inode->i_count)) {
+			/* In case fsnotify_inode_delete() drops a reference. */
+			if (inode != need_iput_tmp)
+				__iget(inode);
+			else
+				need_iput_tmp = NULL;
 			spin_unlock(&inode->i_lock);
-			continue;
-		}
 
-		need_iput_tmp = need_iput;
-		need_iput = NULL;
-
-		/* In case fsnotify_inode_delete() drops a reference. */
-		if (inode != need_iput_tmp)
-			__iget(inode);
-		else
-			need_iput_tmp = NULL;
-		spin_unlock(&inode->i_lock);
-
-		/* In case the dropping of a reference would nuke next_i. */
-		if ((&next_i->i_sb_list != list) &&
-		    atomic_read(&next_i->i_count)) {
-			spin_lock(&next_i->i_lock);
-			if (!(next_i->i_state & (I_FREEING | I_WILL_FREE))) {
-				__iget(next_i);
-				need_iput = next_i;
+			/*
+			 * In case the dropping of a reference would nuke
+			 * next_i.
+			 */
+			if ((&next_i->i_sb_list != list) &&
+			    atomic_read(&next_i->i_count)) {
+				spin_lock(&next_i->i_lock);
+				if (!(next_i->i_state &
+				      (I_FREEING | I_WILL_FREE))) {
+					__iget(next_i);
+					need_iput = next_i;
+				}
+				spin_unlock(&next_i->i_lock);
 			}
-			spin_unlock(&next_i->i_lock);
-		}
 
-		/*
-		 * We can safely drop inode_sb_list_lock here because we hold
-		 * references on both inode and next_i.  Also no new inodes
-		 * will be added since the umount has begun.
-		 */
-		spin_unlock(&inode_sb_list_lock);
+			/*
+			 * We can safely drop the list lock here because we
+			 * hold references on both inode and next_i.  Also no
+			 * new inodes will be added since the umount has begun.
+			 */
+			lg_local_unlock_cpu(inode_sb_list_lglock, cpu);
 
-		if (need_iput_tmp)
-			iput(need_iput_tmp);
+			if (need_iput_tmp)
+				iput(need_iput_tmp);
 
-		/* for each watch, send FS_UNMOUNT and then remove it */
-		fsnotify(inode, FS_UNMOUNT, inode, FSNOTIFY_EVENT_INODE, NULL, 0);
+			/* for each watch, send FS_UNMOUNT and then remove it */
+			fsnotify(inode, FS_UNMOUNT, inode, FSNOTIFY_EVENT_INODE,
+				 NULL, 0);
 
-		fsnotify_inode_delete(inode);
+			fsnotify_inode_delete(inode);
 
-		iput(inode);
+			iput(inode);
 
-		spin_lock(&inode_sb_list_lock);
+			lg_local_lock_cpu(inode_sb_list_lglock, cpu);
+		}
+		lg_local_unlock_cpu(inode_sb_list_lglock, cpu);
 	}
-	spin_unlock(&inode_sb_list_lock);
 }
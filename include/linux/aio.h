@@ -6,6 +6,8 @@
 #include <linux/aio_abi.h>
 #include <linux/uio.h>
 #include <linux/rcupdate.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
 
 #include <linux/atomic.h>
 
@@ -119,6 +121,12 @@ struct kiocb {
 						 * for cancellation */
 	struct list_head	ki_batch;	/* batch allocation */
 
+	/*
+	 * Used to kick the iocb from a page's wait queue, see
+	 * filemap_aio_read_wait().
+	 */
+	struct wait_bit_queue	ki_wait;
+
 	/*
 	 * If the aio_resfd field of the userspace iocb is not zero,
 	 * this is the underlying eventfd context to deliver events to.
@@ -173,6 +181,13 @@ struct aio_ring_info {
 
 	unsigned		nr, tail;
 
+	/* submission queue, only set up by io_setup_ring() */
+	struct aio_sq_ring	*sq_ring;	/* vmap()ed sq pages */
+	unsigned long		sq_user;	/* userspace address of sq_ring */
+	long			sq_nr_pages;
+	unsigned		sq_mask, sq_head;
+	struct mutex		sq_mutex;	/* serializes sq consumers */
+
 	struct page		*internal_pages[AIO_RING_PAGES];
 };
 
@@ -200,6 +215,14 @@ struct kioctx {
 
 	struct delayed_work	wq;
 
+	/* AIO_SETUP_SQPOLL: kernel thread consuming the submission queue */
+	unsigned		flags;
+	struct task_struct	*sq_thread;
+	wait_queue_head_t	sq_wait;
+	struct files_struct	*sq_files;
+	const struct cred	*sq_cred;
+	bool			sq_compat;
+
 	struct rcu_head		rcu_head;
 };
 
@@ -104,6 +104,48 @@ struct iocb {
 	__u32	aio_resfd;
 }; /* 64 bytes */
 
+/*
+ * Valid flags for io_setup_ring().
+ *
+ * AIO_SETUP_SQRING - Map a submission queue (struct aio_sq_ring) after the
+ *                    completion events.  iocbs written to it are consumed
+ *                    by io_submit(ctx, nr, NULL).
+ * AIO_SETUP_SQPOLL - Implies AIO_SETUP_SQRING.  A kernel thread polls the
+ *                    submission queue, so no syscall is needed to submit
+ *                    while it is awake.
+ */
+#define AIO_SETUP_SQRING	(1 << 0)
+#define AIO_SETUP_SQPOLL	(1 << 1)
+
+/*
+ * Set in the compat_features of the completion ring when a submission
+ * queue is present.  The struct aio_sq_ring starts at the first page
+ * boundary following the completion events, ie. at
+ *	ctx + round_up(header_length + nr * sizeof(struct io_event), pagesize)
+ */
+#define AIO_RING_COMPAT_SQRING	(1 << 1)
+
+/* aio_sq_ring flags: the polling thread is asleep, call io_submit() */
+#define AIO_SQ_NEED_WAKEUP	(1 << 0)
+
+/*
+ * The submission queue.  Userspace fills iocbs[tail & mask] and then
+ * advances tail; the kernel consumes entries up to tail and advances
+ * head.  Entries that fail before any I/O is started complete with an
+ * io_event carrying the error in res, or bump dropped if the completion
+ * ring had no room for it.
+ */
+struct aio_sq_ring {
+	__u32		head;		/* written by the kernel */
+	__u32		tail;		/* written by userspace */
+	__u32		mask;		/* number of entries - 1 */
+	__u32		flags;		/* AIO_SQ_* */
+	__u32		dropped;
+	__u32		reserved[11];
+
+	struct iocb	iocbs[0];
+}; /* 64 bytes + queue size */
+
 #undef IFBIG
 #undef IFLITTLE
 
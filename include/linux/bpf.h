@@ -0,0 +1,338 @@
+/*
+ * Extended BPF: instruction set, bpf() syscall and in-kernel interfaces
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * Extended BPF reuses the classic instruction encoding from
+ * <linux/filter.h> with eleven 64-bit registers, a 512 byte stack,
+ * calls into kernel helpers and maps shared with user space.  Programs
+ * are loaded with bpf(BPF_PROG_LOAD), checked by the verifier and then
+ * attached by file descriptor, e.g. with SO_ATTACH_BPF or the "bpf"
+ * traffic classifier.
+ */
+#ifndef __LINUX_BPF_H__
+#define __LINUX_BPF_H__
+
+#include <linux/types.h>
+#include <linux/filter.h>
+
+/* Extended instruction set based on top of classic BPF */
+
+/* instruction classes */
+#define BPF_ALU64	0x07	/* alu mode in double word width */
+
+/* ld/ldx fields */
+#define BPF_DW		0x18	/* double word */
+#define BPF_XADD	0xc0	/* exclusive add */
+
+/* alu/jmp fields */
+#define BPF_MOD		0x90
+#define BPF_XOR		0xa0
+#define BPF_MOV		0xb0	/* mov reg to reg */
+#define BPF_ARSH	0xc0	/* sign extending arithmetic shift right */
+
+/* change endianness of a register */
+#define BPF_END		0xd0	/* flags for endianness conversion: */
+#define BPF_TO_LE	0x00	/* convert to little-endian */
+#define BPF_TO_BE	0x08	/* convert to big-endian */
+#define BPF_FROM_LE	BPF_TO_LE
+#define BPF_FROM_BE	BPF_TO_BE
+
+#define BPF_JNE		0x50	/* jump != */
+#define BPF_JSGT	0x60	/* signed '>' */
+#define BPF_JSGE	0x70	/* signed '>=' */
+#define BPF_CALL	0x80	/* function call */
+#define BPF_EXIT	0x90	/* function return */
+
+/* Register numbers */
+enum {
+	BPF_REG_0 = 0,	/* return value of calls and of the program */
+	BPF_REG_1,	/* arguments of calls, R1 is the context on entry */
+	BPF_REG_2,
+	BPF_REG_3,
+	BPF_REG_4,
+	BPF_REG_5,
+	BPF_REG_6,	/* preserved across calls */
+	BPF_REG_7,
+	BPF_REG_8,
+	BPF_REG_9,
+	BPF_REG_10,	/* read-only frame pointer to the stack */
+	__MAX_BPF_REG,
+};
+
+#define MAX_BPF_REG	__MAX_BPF_REG
+#define MAX_BPF_STACK	512
+
+struct bpf_insn {
+	__u8	code;		/* opcode */
+	__u8	dst_reg:4;	/* dest register */
+	__u8	src_reg:4;	/* source register */
+	__s16	off;		/* signed offset */
+	__s32	imm;		/* signed immediate constant */
+};
+
+/*
+ * BPF_LD | BPF_DW | BPF_IMM loads a 64-bit immediate from two
+ * instructions.  With src_reg set to BPF_PSEUDO_MAP_FD the immediate is
+ * a map file descriptor, replaced with the map when the program loads.
+ */
+#define BPF_PSEUDO_MAP_FD	1
+
+/* BPF syscall commands */
+enum bpf_cmd {
+	BPF_MAP_CREATE,		/* returns a map fd */
+	BPF_MAP_LOOKUP_ELEM,
+	BPF_MAP_UPDATE_ELEM,
+	BPF_MAP_DELETE_ELEM,
+	BPF_MAP_GET_NEXT_KEY,
+	BPF_PROG_LOAD,		/* returns a program fd */
+};
+
+enum bpf_map_type {
+	BPF_MAP_TYPE_UNSPEC,
+	BPF_MAP_TYPE_HASH,
+	BPF_MAP_TYPE_ARRAY,
+};
+
+enum bpf_prog_type {
+	BPF_PROG_TYPE_UNSPEC,
+	BPF_PROG_TYPE_SOCKET_FILTER,
+	BPF_PROG_TYPE_SCHED_CLS,
+};
+
+/* flags for BPF_MAP_UPDATE_ELEM command */
+#define BPF_ANY		0	/* create new element or update existing */
+#define BPF_NOEXIST	1	/* create new element if it didn't exist */
+#define BPF_EXIST	2	/* update existing element */
+
+union bpf_attr {
+	struct { /* anonymous struct used by BPF_MAP_CREATE command */
+		__u32	map_type;
+		__u32	key_size;	/* size of key in bytes */
+		__u32	value_size;	/* size of value in bytes */
+		__u32	max_entries;	/* max number of entries in a map */
+	};
+
+	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
+		__u32		map_fd;
+		__aligned_u64	key;
+		union {
+			__aligned_u64 value;
+			__aligned_u64 next_key;
+		};
+		__u64		flags;
+	};
+
+	struct { /* anonymous struct used by BPF_PROG_LOAD command */
+		__u32		prog_type;
+		__u32		insn_cnt;
+		__aligned_u64	insns;
+		__aligned_u64	license;
+		__u32		log_level;	/* verbosity level of verifier */
+		__u32		log_size;	/* size of user buffer */
+		__aligned_u64	log_buf;	/* user supplied buffer */
+	};
+} __attribute__((aligned(8)));
+
+/*
+ * The imm field of a BPF_CALL instruction selects the helper to call.
+ * Arguments are passed in R1-R5, the result is returned in R0.
+ */
+enum bpf_func_id {
+	BPF_FUNC_unspec,
+	BPF_FUNC_map_lookup_elem,	/* void *(&map, &key), NULL if absent */
+	BPF_FUNC_map_update_elem,	/* int (&map, &key, &value, flags) */
+	BPF_FUNC_map_delete_elem,	/* int (&map, &key) */
+	BPF_FUNC_get_prandom_u32,	/* u32 (void) */
+	BPF_FUNC_get_smp_processor_id,	/* u32 (void) */
+	__BPF_FUNC_MAX_ID,
+};
+
+/*
+ * Context of socket filter and classifier programs: loads from these
+ * fields read the corresponding sk_buff fields.  Packet data is read
+ * with BPF_LD | BPF_ABS and BPF_LD | BPF_IND, which take the context
+ * from R6.
+ */
+struct __sk_buff {
+	__u32	len;
+	__u32	mark;
+	__u32	queue_mapping;
+	__u32	protocol;	/* network byte order */
+	__u32	vlan_tci;
+	__u32	priority;
+	__u32	ingress_ifindex;
+	__u32	hash;
+};
+
+#ifdef __KERNEL__
+
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/workqueue.h>
+#include <linux/err.h>
+#include <linux/atomic.h>
+
+struct bpf_map;
+struct sk_buff;
+
+/* map is generic key/value storage optionally accessible by eBPF programs */
+struct bpf_map_ops {
+	/* funcs callable from userspace (via syscall) */
+	struct bpf_map *(*map_alloc)(union bpf_attr *attr);
+	void (*map_free)(struct bpf_map *);
+	int (*map_get_next_key)(struct bpf_map *map, void *key, void *next_key);
+
+	/* funcs callable from userspace and from eBPF programs */
+	void *(*map_lookup_elem)(struct bpf_map *map, void *key);
+	int (*map_update_elem)(struct bpf_map *map, void *key, void *value,
+			       u64 flags);
+	int (*map_delete_elem)(struct bpf_map *map, void *key);
+};
+
+struct bpf_map {
+	atomic_t		refcnt;
+	enum bpf_map_type	map_type;
+	u32			key_size;
+	u32			value_size;
+	u32			max_entries;
+	const struct bpf_map_ops *ops;
+};
+
+struct bpf_map_type_list {
+	struct list_head	list_node;
+	const struct bpf_map_ops *ops;
+	enum bpf_map_type	type;
+};
+
+/* types of values stored in eBPF registers and passed to helpers */
+enum bpf_arg_type {
+	ARG_DONTCARE = 0,	/* unused argument in helper function */
+
+	/* the following constraints used to prototype
+	 * bpf_map_lookup/update/delete_elem() functions
+	 */
+	ARG_CONST_MAP_PTR,	/* const argument used as pointer to bpf_map */
+	ARG_PTR_TO_MAP_KEY,	/* pointer to stack used as map key */
+	ARG_PTR_TO_MAP_VALUE,	/* pointer to stack used as map value */
+
+	ARG_ANYTHING,		/* any (initialized) argument is ok */
+};
+
+/* type of values returned from helper functions */
+enum bpf_return_type {
+	RET_INTEGER,			/* function returns integer */
+	RET_VOID,			/* function doesn't return anything */
+	RET_PTR_TO_MAP_VALUE_OR_NULL,	/* returns a pointer to map elem value or NULL */
+};
+
+/*
+ * eBPF function prototype used by verifier to allow BPF_CALLs from
+ * eBPF programs to in-kernel helper functions and to determine the
+ * types of R0-R5 around the call.
+ */
+struct bpf_func_proto {
+	u64 (*func)(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5);
+	bool gpl_only;
+	enum bpf_return_type ret_type;
+	enum bpf_arg_type arg1_type;
+	enum bpf_arg_type arg2_type;
+	enum bpf_arg_type arg3_type;
+	enum bpf_arg_type arg4_type;
+	enum bpf_arg_type arg5_type;
+};
+
+enum bpf_access_type {
+	BPF_READ = 1,
+	BPF_WRITE = 2
+};
+
+struct bpf_verifier_ops {
+	/* return eBPF function prototype for verification */
+	const struct bpf_func_proto *(*get_func_proto)(enum bpf_func_id func_id);
+
+	/* return true if 'size' wide access at offset 'off' within the
+	 * context is valid for the given type of access
+	 */
+	bool (*is_valid_access)(int off, int size, enum bpf_access_type type);
+
+	/* rewrite a checked context load into a load from the real
+	 * context; the instruction is rewritten in place
+	 */
+	void (*convert_ctx_access)(struct bpf_insn *insn, int ctx_off);
+
+	/* program may use BPF_LD | BPF_ABS and BPF_LD | BPF_IND */
+	bool has_ld_abs;
+};
+
+struct bpf_prog_type_list {
+	struct list_head	list_node;
+	const struct bpf_verifier_ops *ops;
+	enum bpf_prog_type	type;
+};
+
+struct bpf_prog {
+	atomic_t		refcnt;
+	u32			len;		/* number of instructions */
+	enum bpf_prog_type	type;
+	bool			jited;
+	bool			gpl_compatible;
+	const struct bpf_verifier_ops *ops;
+	struct bpf_map		**used_maps;
+	u32			used_map_cnt;
+	struct rcu_head		rcu;
+	struct work_struct	work;
+	unsigned int		(*bpf_func)(const void *ctx,
+					    const struct bpf_insn *insn);
+	struct bpf_insn		insnsi[0];
+};
+
+#define BPF_PROG_RUN(prog, ctx)	(*(prog)->bpf_func)(ctx, (prog)->insnsi)
+
+static inline unsigned int bpf_prog_size(unsigned int len)
+{
+	return sizeof(struct bpf_prog) + len * sizeof(struct bpf_insn);
+}
+
+extern unsigned int __bpf_prog_run(const void *ctx,
+				   const struct bpf_insn *insn);
+extern u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5);
+extern u64 bpf_load_skb(const struct sk_buff *skb, int k, unsigned int size);
+
+/* architecture JIT for eBPF programs, see bpf_jit_enable */
+extern void bpf_int_jit_compile(struct bpf_prog *prog);
+extern void bpf_int_jit_free(struct bpf_prog *prog);
+
+#ifdef CONFIG_BPF_SYSCALL
+extern void bpf_register_map_type(struct bpf_map_type_list *tl);
+extern void bpf_register_prog_type(struct bpf_prog_type_list *tl);
+
+extern struct bpf_prog *bpf_prog_get(u32 ufd);
+extern void bpf_prog_put(struct bpf_prog *prog);
+extern struct bpf_map *bpf_map_get(u32 ufd);
+extern void bpf_map_put(struct bpf_map *map);
+
+extern int bpf_check(struct bpf_prog *prog, union bpf_attr *attr);
+#else
+static inline struct bpf_prog *bpf_prog_get(u32 ufd)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+
+static inline void bpf_prog_put(struct bpf_prog *prog)
+{
+}
+#endif
+
+/* verifier prototypes for helper functions called from eBPF programs */
+extern const struct bpf_func_proto bpf_map_lookup_elem_proto;
+extern const struct bpf_func_proto bpf_map_update_elem_proto;
+extern const struct bpf_func_proto bpf_map_delete_elem_proto;
+extern const struct bpf_func_proto bpf_get_prandom_u32_proto;
+extern const struct bpf_func_proto bpf_get_smp_processor_id_proto;
+
+#endif /* __KERNEL__ */
+
+#endif /* __LINUX_BPF_H__ */
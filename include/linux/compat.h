@@ -429,6 +429,8 @@ asmlinkage long compat_sys_fcntl64(unsigned int fd, unsigned int cmd,
 asmlinkage long compat_sys_fcntl(unsigned int fd, unsigned int cmd,
 				 unsigned long arg);
 asmlinkage long compat_sys_io_setup(unsigned nr_reqs, u32 __user *ctx32p);
+asmlinkage long compat_sys_io_setup_ring(unsigned nr_reqs, unsigned flags,
+					 u32 __user *ctx32p);
 asmlinkage long compat_sys_io_getevents(aio_context_t ctx_id,
 					unsigned long min_nr,
 					unsigned long nr,
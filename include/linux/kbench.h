@@ -0,0 +1,55 @@
+/*
+ * Harness for in-kernel microbenchmark modules
+ *
+ * kbench_run() starts one kernel thread per online CPU, releases them at
+ * the same time and waits for all of them to return from the benchmark
+ * function.  The benchmark itself only provides that function and reports
+ * the result.
+ */
+#ifndef _LINUX_KBENCH_H
+#define _LINUX_KBENCH_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+struct kbench;
+
+struct kbench_thread {
+	struct task_struct	*task;
+	struct kbench		*bench;
+	int			id;	/* 0 .. nr - 1 */
+	u64			ns;	/* time spent in the benchmark */
+	int			err;	/* what the benchmark returned */
+	void			*data;	/* for the benchmark's use */
+};
+
+typedef int (*kbench_fn)(struct kbench_thread *t);
+
+/**
+ * kbench_run - run a benchmark on several CPUs in parallel
+ * @threads: array of @nr threads; ->data is left alone
+ * @nr: number of threads, at most the number of online CPUs
+ * @fn: benchmark run by every thread
+ * @name: thread name prefix
+ * @ns: returns the average time a thread spent in @fn
+ *
+ * The threads are bound to the first @nr online CPUs, so the caller has to
+ * hold get_online_cpus().  All threads are created before any of them
+ * starts, so a failure leaves nothing running.
+ *
+ * Return value: 0, the error of the last thread whose @fn failed, or the
+ * error from creating the threads.
+ */
+int kbench_run(struct kbench_thread *threads, int nr, kbench_fn fn,
+	       const char *name, u64 *ns);
+
+/*
+ * A benchmark module does its work in its init function and then fails
+ * to load with this, so that it can be loaded again.
+ */
+static inline int kbench_init_result(int err)
+{
+	return err ? err : -EAGAIN;
+}
+
+#endif /* _LINUX_KBENCH_H */
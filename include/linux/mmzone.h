@@ -194,13 +194,20 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders up to PCP_MAX_ORDER are cached on the pcp lists as well, one list
+ * per order and migrate type.  count, high and batch are in base pages.
+ */
+#define PCP_MAX_ORDER		PAGE_ALLOC_COSTLY_ORDER
+#define NR_PCP_LISTS		(MIGRATE_PCPTYPES * (PCP_MAX_ORDER + 1))
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
 
-	/* Lists of pages, one per migrate type stored on the pcp-lists */
-	struct list_head lists[MIGRATE_PCPTYPES];
+	/* Lists of pages, one per order and migrate type */
+	struct list_head lists[NR_PCP_LISTS];
 };
 
 struct per_cpu_pageset {
@@ -633,6 +640,12 @@ extern struct page *mem_map;
  * Memory statistics and page replacement data structures are maintained on a
  * per-zone basis.
  */
+/*
+ * Upper limit of vm.kswapd_threads, there is a vmstat counter for each
+ * thread (FOR_ALL_KSWAPD_THREADS).
+ */
+#define MAX_KSWAPD_THREADS	8
+
 struct bootmem_data;
 typedef struct pglist_data {
 	struct zone node_zones[MAX_NR_ZONES];
@@ -663,9 +676,11 @@ typedef struct pglist_data {
 					     range, including holes */
 	int node_id;
 	wait_queue_head_t kswapd_wait;
-	struct task_struct *kswapd;
-	int kswapd_max_order;
-	enum zone_type classzone_idx;
+	struct task_struct *kswapd[MAX_KSWAPD_THREADS];	/* vm.kswapd_threads */
+	/* wakeup requests, one slot per kswapd thread */
+	int kswapd_max_order[MAX_KSWAPD_THREADS];
+	enum zone_type classzone_idx[MAX_KSWAPD_THREADS];
+	int kswapd_awake;	/* threads not asleep, under kswapd_awake_lock */
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
@@ -1254,6 +1254,25 @@ struct sched_rt_entity {
 
 struct rcu_node;
 
+/* Number of mms whose TLB flushes one reclaim batch can defer */
+#define TLB_UBC_NR_MM		8
+
+/*
+ * Unmaps done by reclaim whose TLB flushes are still pending, see
+ * try_to_unmap_flush().
+ */
+struct tlbflush_unmap_batch {
+	/* mms with cleared ptes, each holding an mm_count reference */
+	struct mm_struct *mm[TLB_UBC_NR_MM];
+	unsigned int nr_mm;
+
+	/*
+	 * True if one of the cleared ptes was dirty, so a stale TLB entry
+	 * may still allow writes to the page.
+	 */
+	bool writable;
+};
+
 enum perf_event_task_context {
 	perf_invalid_context = -1,
 	perf_hw_context = 0,
@@ -1341,6 +1360,8 @@ struct task_struct {
 				 * execve */
 	unsigned in_iowait:1;
 
+	/* task may not gain privileges */
+	unsigned no_new_privs:1;
 
 	/* Revert to default priority/policy when forking */
 	unsigned sched_reset_on_fork:1;
@@ -1450,7 +1471,7 @@ struct task_struct {
 	uid_t loginuid;
 	unsigned int sessionid;
 #endif
-	seccomp_t seccomp;
+	struct seccomp seccomp;
 
 /* Thread group tracking */
    	u32 parent_exec_id;
@@ -1511,6 +1532,10 @@ struct task_struct {
 /* VM state */
 	struct reclaim_state *reclaim_state;
 
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	struct tlbflush_unmap_batch tlb_ubc;
+#endif
+
 	struct backing_dev_info *backing_dev_info;
 
 	struct io_context *io_context;
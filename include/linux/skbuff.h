@@ -240,11 +240,31 @@ enum {
  * lower device, the skb last reference should be 0 when calling this.
  * The ctx field is used to track device context.
  * The desc field is used to track userspace buffer index.
+ *
+ * Socket zerocopy (MSG_ZEROCOPY) uses the second layout instead: the
+ * buffer is shared by all skbs holding its pages, each of which holds a
+ * reference, and the callback drops one.  id and len describe the range
+ * of send calls to report on the error queue once the last one is gone.
  */
 struct ubuf_info {
 	void (*callback)(struct ubuf_info *);
-	void *ctx;
-	unsigned long desc;
+	union {
+		struct {
+			void *ctx;
+			unsigned long desc;
+		};
+		struct {
+			u32 id;
+			u16 len;
+			u16 zerocopy:1;
+		};
+	};
+	atomic_t refcnt;
+
+	struct mmpin {
+		struct user_struct *user;
+		unsigned int num_pg;
+	} mmp;
 };
 
 /* This data is invariant across clones and lives at
@@ -373,6 +393,7 @@ typedef unsigned char *sk_buff_data_t;
  *	@no_fcs:  Request NIC to treat last 4 bytes as Ethernet FCS
  *	@dma_cookie: a cookie to one of several possible DMA operations
  *		done by skb DMA functions
+ *	@napi_id: id of the NAPI context this skb was received on
  *	@secmark: security marking
  *	@mark: Generic packet mark
  *	@dropcount: total number of sk_receive_queue overflows
@@ -476,6 +497,9 @@ struct sk_buff {
 #ifdef CONFIG_NET_DMA
 	dma_cookie_t		dma_cookie;
 #endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	unsigned int		napi_id;
+#endif
 #ifdef CONFIG_NETWORK_SECMARK
 	__u32			secmark;
 #endif
@@ -658,6 +682,66 @@ static inline struct skb_shared_hwtstamps *skb_hwtstamps(struct sk_buff *skb)
 	return &skb_shinfo(skb)->hwtstamps;
 }
 
+extern struct ubuf_info *sock_zerocopy_alloc(struct sock *sk, size_t size);
+extern void sock_zerocopy_callback(struct ubuf_info *uarg);
+extern void sock_zerocopy_put_abort(struct ubuf_info *uarg);
+extern int skb_zerocopy_add_frags(struct sock *sk, struct sk_buff *skb,
+				  const void __user *from, int len,
+				  struct ubuf_info *uarg);
+
+static inline struct ubuf_info *skb_zcopy(struct sk_buff *skb)
+{
+	bool is_zcopy = skb && skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY;
+
+	return is_zcopy ? skb_shinfo(skb)->destructor_arg : NULL;
+}
+
+/* True for buffers of MSG_ZEROCOPY sockets, which may be shared by skbs */
+static inline bool skb_zcopy_shared(struct sk_buff *skb)
+{
+	struct ubuf_info *uarg = skb_zcopy(skb);
+
+	return uarg && uarg->callback == sock_zerocopy_callback;
+}
+
+static inline void skb_zcopy_set(struct sk_buff *skb, struct ubuf_info *uarg)
+{
+	atomic_inc(&uarg->refcnt);
+	skb_shinfo(skb)->destructor_arg = uarg;
+	skb_shinfo(skb)->tx_flags |= SKBTX_DEV_ZEROCOPY;
+}
+
+/* Let @nskb, which took references on frags of @orig, share its buffer */
+static inline void skb_zerocopy_clone(struct sk_buff *nskb,
+				      struct sk_buff *orig)
+{
+	if (skb_zcopy_shared(orig) && !skb_zcopy(nskb))
+		skb_zcopy_set(nskb, skb_zcopy(orig));
+}
+
+/* Drop the sender's reference; the last one queues the notification */
+static inline void sock_zerocopy_put(struct ubuf_info *uarg)
+{
+	if (uarg)
+		sock_zerocopy_callback(uarg);
+}
+
+/**
+ *	skb_orphan_frags - make a skb's frags safe to keep or share
+ *	@skb: buffer whose frags may point to user memory
+ *	@gfp_mask: allocation priority
+ *
+ *	Copies frags that point to user memory into kernel pages, unless
+ *	they belong to a MSG_ZEROCOPY socket: those pages are pinned and
+ *	the completion is reference counted, so they can be shared.
+ */
+static inline int skb_orphan_frags(struct sk_buff *skb, gfp_t gfp_mask)
+{
+	if (likely(!skb_zcopy(skb)) || skb_zcopy_shared(skb))
+		return 0;
+	return skb_copy_ubufs(skb, gfp_mask);
+}
+
 /**
  *	skb_queue_empty - check if a queue is empty
  *	@list: queue head
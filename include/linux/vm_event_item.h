@@ -21,6 +21,10 @@
 
 #define FOR_ALL_ZONES(xx) DMA_ZONE(xx) DMA32_ZONE(xx) xx##_NORMAL HIGHMEM_ZONE(xx) , xx##_MOVABLE
 
+/* One counter per kswapd thread of a node, up to MAX_KSWAPD_THREADS */
+#define FOR_ALL_KSWAPD_THREADS(xx) xx##0, xx##1, xx##2, xx##3, \
+		xx##4, xx##5, xx##6, xx##7
+
 enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		FOR_ALL_ZONES(PGALLOC),
 		PGFREE, PGACTIVATE, PGDEACTIVATE,
@@ -35,6 +39,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PGINODESTEAL, SLABS_SCANNED, KSWAPD_STEAL, KSWAPD_INODESTEAL,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
+		FOR_ALL_KSWAPD_THREADS(KSWAPD_STEAL_THREAD),
+		FOR_ALL_KSWAPD_THREADS(KSWAPD_SCAN_THREAD),
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
@@ -25,6 +25,8 @@ enum qdisc_state_t {
 	__QDISC_STATE_SCHED,
 	__QDISC_STATE_DEACTIVATED,
 	__QDISC_STATE_THROTTLED,
+	__QDISC_STATE_RUNNING,	/* TCQ_F_NOLOCK only */
+	__QDISC_STATE_MISSED,	/* TCQ_F_NOLOCK only */
 };
 
 /*
@@ -50,6 +52,7 @@ struct Qdisc {
 #define TCQ_F_INGRESS		2
 #define TCQ_F_CAN_BYPASS	4
 #define TCQ_F_MQROOT		8
+#define TCQ_F_NOLOCK		0x10 /* qdisc does not require locking */
 #define TCQ_F_WARN_NONWC	(1 << 16)
 	int			padded;
 	const struct Qdisc_ops	*ops;
@@ -85,13 +88,27 @@ struct Qdisc {
 	u32			limit;
 };
 
+/*
+ * A TCQ_F_NOLOCK qdisc is entered without qdisc_lock(), so its running
+ * state is an atomic bit of q->state.  A CPU failing to take it sets
+ * __QDISC_STATE_MISSED, telling the owner to have another look at the
+ * queue before it goes, and tries once more in case the owner is gone.
+ */
 static inline bool qdisc_is_running(const struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK)
+		return test_bit(__QDISC_STATE_RUNNING, &qdisc->state);
 	return (qdisc->__state & __QDISC___STATE_RUNNING) ? true : false;
 }
 
 static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		if (!test_and_set_bit(__QDISC_STATE_RUNNING, &qdisc->state))
+			return true;
+		set_bit(__QDISC_STATE_MISSED, &qdisc->state);
+		return !test_and_set_bit(__QDISC_STATE_RUNNING, &qdisc->state);
+	}
 	if (qdisc_is_running(qdisc))
 		return false;
 	qdisc->__state |= __QDISC___STATE_RUNNING;
@@ -100,6 +117,11 @@ static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 
 static inline void qdisc_run_end(struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		smp_mb__before_clear_bit();
+		clear_bit(__QDISC_STATE_RUNNING, &qdisc->state);
+		return;
+	}
 	qdisc->__state &= ~__QDISC___STATE_RUNNING;
 }
 
@@ -303,6 +325,7 @@ static inline void sch_tree_unlock(const struct Qdisc *q)
 extern struct Qdisc noop_qdisc;
 extern struct Qdisc_ops noop_qdisc_ops;
 extern struct Qdisc_ops pfifo_fast_ops;
+extern struct Qdisc_ops pfifo_lockless_ops;
 extern struct Qdisc_ops mq_qdisc_ops;
 
 struct Qdisc_class_common {
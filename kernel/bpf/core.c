@@ -0,0 +1,269 @@
+/*
+ * Extended BPF interpreter
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * Programs reaching the interpreter have been accepted by bpf_check(),
+ * so opcodes, register numbers, jump offsets and memory accesses are
+ * known to be valid and are not checked again here.  The only run time
+ * checks left are division by zero and packet loads past the end of
+ * the skb, both of which make the program return 0.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bpf.h>
+#include <linux/math64.h>
+#include <linux/ratelimit.h>
+#include <asm/byteorder.h>
+
+/* Base function for offset calculation of BPF_CALL: the verifier
+ * rewrites the helper id in insn->imm to the helper's offset from here.
+ */
+noinline u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	return 0;
+}
+EXPORT_SYMBOL_GPL(__bpf_call_base);
+
+#define DST	regs[insn->dst_reg]
+#define SRC	regs[insn->src_reg]
+#define IMM	insn->imm
+
+/**
+ *	__bpf_prog_run - run an eBPF program on a given context
+ *	@ctx: the context, passed in R1
+ *	@insn: the verified program
+ *
+ *	Returns the value of R0 at BPF_EXIT.
+ */
+unsigned int __bpf_prog_run(const void *ctx, const struct bpf_insn *insn)
+{
+	u64 stack[MAX_BPF_STACK / sizeof(u64)];
+	u64 regs[MAX_BPF_REG];
+	u32 off;
+
+	regs[BPF_REG_10] = (unsigned long) &stack[ARRAY_SIZE(stack)];
+	regs[BPF_REG_1] = (unsigned long) ctx;
+
+	for (;; insn++) {
+		switch (insn->code) {
+#define ALU(OPCODE, OP)						\
+		case BPF_ALU64 | BPF_##OPCODE | BPF_X:		\
+			DST = DST OP SRC;			\
+			continue;				\
+		case BPF_ALU | BPF_##OPCODE | BPF_X:		\
+			DST = (u32) DST OP (u32) SRC;		\
+			continue;				\
+		case BPF_ALU64 | BPF_##OPCODE | BPF_K:		\
+			DST = DST OP IMM;			\
+			continue;				\
+		case BPF_ALU | BPF_##OPCODE | BPF_K:		\
+			DST = (u32) DST OP (u32) IMM;		\
+			continue;
+		ALU(ADD,  +)
+		ALU(SUB,  -)
+		ALU(AND,  &)
+		ALU(OR,   |)
+		ALU(LSH, <<)
+		ALU(RSH, >>)
+		ALU(XOR,  ^)
+		ALU(MUL,  *)
+#undef ALU
+		case BPF_ALU | BPF_NEG:
+			DST = (u32) -DST;
+			continue;
+		case BPF_ALU64 | BPF_NEG:
+			DST = -DST;
+			continue;
+		case BPF_ALU | BPF_MOV | BPF_X:
+			DST = (u32) SRC;
+			continue;
+		case BPF_ALU | BPF_MOV | BPF_K:
+			DST = (u32) IMM;
+			continue;
+		case BPF_ALU64 | BPF_MOV | BPF_X:
+			DST = SRC;
+			continue;
+		case BPF_ALU64 | BPF_MOV | BPF_K:
+			DST = IMM;
+			continue;
+		case BPF_ALU | BPF_ARSH | BPF_X:
+			DST = (u32) ((s32) DST >> (SRC & 31));
+			continue;
+		case BPF_ALU | BPF_ARSH | BPF_K:
+			DST = (u32) ((s32) DST >> IMM);
+			continue;
+		case BPF_ALU64 | BPF_ARSH | BPF_X:
+			DST = (s64) DST >> SRC;
+			continue;
+		case BPF_ALU64 | BPF_ARSH | BPF_K:
+			DST = (s64) DST >> IMM;
+			continue;
+		case BPF_ALU64 | BPF_DIV | BPF_X:
+			if (unlikely(SRC == 0))
+				return 0;
+			DST = div64_u64(DST, SRC);
+			continue;
+		case BPF_ALU | BPF_DIV | BPF_X:
+			if (unlikely((u32) SRC == 0))
+				return 0;
+			DST = (u32) DST / (u32) SRC;
+			continue;
+		case BPF_ALU64 | BPF_DIV | BPF_K:
+			DST = div64_u64(DST, (u64) IMM);
+			continue;
+		case BPF_ALU | BPF_DIV | BPF_K:
+			DST = (u32) DST / (u32) IMM;
+			continue;
+		case BPF_ALU64 | BPF_MOD | BPF_X:
+			if (unlikely(SRC == 0))
+				return 0;
+			DST = DST - div64_u64(DST, SRC) * SRC;
+			continue;
+		case BPF_ALU | BPF_MOD | BPF_X:
+			if (unlikely((u32) SRC == 0))
+				return 0;
+			DST = (u32) DST % (u32) SRC;
+			continue;
+		case BPF_ALU64 | BPF_MOD | BPF_K:
+			DST = DST - div64_u64(DST, (u64) IMM) * (u64) IMM;
+			continue;
+		case BPF_ALU | BPF_MOD | BPF_K:
+			DST = (u32) DST % (u32) IMM;
+			continue;
+		case BPF_ALU | BPF_END | BPF_TO_BE:
+			switch (IMM) {
+			case 16:
+				DST = (__force u16) cpu_to_be16(DST);
+				break;
+			case 32:
+				DST = (__force u32) cpu_to_be32(DST);
+				break;
+			case 64:
+				DST = (__force u64) cpu_to_be64(DST);
+				break;
+			}
+			continue;
+		case BPF_ALU | BPF_END | BPF_TO_LE:
+			switch (IMM) {
+			case 16:
+				DST = (__force u16) cpu_to_le16(DST);
+				break;
+			case 32:
+				DST = (__force u32) cpu_to_le32(DST);
+				break;
+			case 64:
+				DST = (__force u64) cpu_to_le64(DST);
+				break;
+			}
+			continue;
+
+		/* 64-bit immediate, the second half is in the next insn */
+		case BPF_LD | BPF_IMM | BPF_DW:
+			DST = (u64) (u32) insn[0].imm | ((u64) (u32) insn[1].imm) << 32;
+			insn++;
+			continue;
+
+		case BPF_JMP | BPF_CALL:
+			/* helper functions take at most 5 arguments, R1-R5 */
+			regs[BPF_REG_0] = (__bpf_call_base + insn->imm)(regs[BPF_REG_1],
+									regs[BPF_REG_2],
+									regs[BPF_REG_3],
+									regs[BPF_REG_4],
+									regs[BPF_REG_5]);
+			continue;
+		case BPF_JMP | BPF_JA:
+			insn += insn->off;
+			continue;
+#define COND_JMP(OPCODE, CMP, TYPE)				\
+		case BPF_JMP | BPF_##OPCODE | BPF_X:		\
+			if ((TYPE) DST CMP (TYPE) SRC)		\
+				insn += insn->off;		\
+			continue;				\
+		case BPF_JMP | BPF_##OPCODE | BPF_K:		\
+			if ((TYPE) DST CMP (TYPE) IMM)		\
+				insn += insn->off;		\
+			continue;
+		COND_JMP(JEQ,  ==, u64)
+		COND_JMP(JNE,  !=, u64)
+		COND_JMP(JGT,  >,  u64)
+		COND_JMP(JGE,  >=, u64)
+		COND_JMP(JSGT, >,  s64)
+		COND_JMP(JSGE, >=, s64)
+#undef COND_JMP
+		case BPF_JMP | BPF_JSET | BPF_X:
+			if (DST & SRC)
+				insn += insn->off;
+			continue;
+		case BPF_JMP | BPF_JSET | BPF_K:
+			if (DST & IMM)
+				insn += insn->off;
+			continue;
+		case BPF_JMP | BPF_EXIT:
+			return regs[BPF_REG_0];
+
+#define LDST(SIZEOP, SIZE)						\
+		case BPF_STX | BPF_MEM | BPF_##SIZEOP:			\
+			*(SIZE *)(unsigned long) (DST + insn->off) = SRC; \
+			continue;					\
+		case BPF_ST | BPF_MEM | BPF_##SIZEOP:			\
+			*(SIZE *)(unsigned long) (DST + insn->off) = IMM; \
+			continue;					\
+		case BPF_LDX | BPF_MEM | BPF_##SIZEOP:			\
+			DST = *(SIZE *)(unsigned long) (SRC + insn->off); \
+			continue;
+		LDST(B,  u8)
+		LDST(H,  u16)
+		LDST(W,  u32)
+		LDST(DW, u64)
+#undef LDST
+		case BPF_STX | BPF_XADD | BPF_W:
+			atomic_add((u32) SRC, (atomic_t *)(unsigned long)
+				   (DST + insn->off));
+			continue;
+		case BPF_STX | BPF_XADD | BPF_DW:
+			atomic64_add((u64) SRC, (atomic64_t *)(unsigned long)
+				     (DST + insn->off));
+			continue;
+
+		/* Packet loads take the skb from R6, clobber R1-R5 like a
+		 * call and return the value in host order in R0.  Loads past
+		 * the end of the packet terminate the program with 0, as in
+		 * classic BPF.
+		 */
+#define LD_PKT(SIZEOP, SIZE)						\
+		case BPF_LD | BPF_ABS | BPF_##SIZEOP:			\
+			off = IMM;					\
+			goto load_##SIZEOP;				\
+		case BPF_LD | BPF_IND | BPF_##SIZEOP:			\
+			off = (u32) SRC + IMM;				\
+load_##SIZEOP:								\
+			regs[BPF_REG_0] = bpf_load_skb((void *)(unsigned long) \
+						       regs[BPF_REG_6],	\
+						       off, SIZE);	\
+			if (regs[BPF_REG_0] == ~0ULL)			\
+				return 0;				\
+			continue;
+		LD_PKT(W, 4)
+		LD_PKT(H, 2)
+		LD_PKT(B, 1)
+#undef LD_PKT
+		default:
+			WARN_RATELIMIT(1, "unknown eBPF opcode %02x\n",
+				       insn->code);
+			return 0;
+		}
+	}
+}
+EXPORT_SYMBOL_GPL(__bpf_prog_run);
+
+/* weak defaults, overridden by architectures with an eBPF JIT */
+void __weak bpf_int_jit_compile(struct bpf_prog *prog)
+{
+}
+
+void __weak bpf_int_jit_free(struct bpf_prog *prog)
+{
+}
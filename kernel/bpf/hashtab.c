@@ -0,0 +1,315 @@
+/*
+ * Hash table map for eBPF programs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * Lookups are lockless under RCU, so programs running from softirq
+ * never wait for user space.  Updates and deletes take the table
+ * spinlock with interrupts disabled and replace elements instead of
+ * modifying them in place: an update allocates the new element, links
+ * it in front of the old one and frees the old one after a grace
+ * period, so a concurrent lookup sees either value in full.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
+#include <linux/bpf.h>
+
+struct bpf_htab {
+	struct bpf_map		map;
+	struct hlist_head	*buckets;
+	spinlock_t		lock;
+	u32			count;		/* number of elements */
+	u32			n_buckets;	/* power of two */
+	u32			elem_size;	/* size of each element */
+};
+
+/* each htab element is struct htab_elem + key + value */
+struct htab_elem {
+	struct hlist_node	hash_node;
+	struct rcu_head		rcu;
+	u32			hash;
+	char			key[0] __aligned(8);
+};
+
+static void *htab_alloc_buckets(size_t size)
+{
+	void *p;
+
+	p = kzalloc(size, GFP_USER | __GFP_NOWARN);
+	if (!p)
+		p = vzalloc(size);
+	return p;
+}
+
+static void htab_free_buckets(void *p)
+{
+	if (is_vmalloc_addr(p))
+		vfree(p);
+	else
+		kfree(p);
+}
+
+static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
+{
+	struct bpf_htab *htab;
+	u32 i;
+
+	if (attr->max_entries == 0 || attr->key_size == 0 ||
+	    attr->value_size == 0)
+		return ERR_PTR(-EINVAL);
+
+	/* keys are passed from the program stack */
+	if (attr->key_size > MAX_BPF_STACK)
+		return ERR_PTR(-E2BIG);
+
+	/* elements are kmalloc'ed one by one */
+	if (attr->value_size >= KMALLOC_MAX_SIZE - MAX_BPF_STACK -
+	    sizeof(struct htab_elem))
+		return ERR_PTR(-E2BIG);
+
+	if (attr->max_entries > 1U << 31)
+		return ERR_PTR(-E2BIG);
+
+	htab = kzalloc(sizeof(*htab), GFP_USER);
+	if (!htab)
+		return ERR_PTR(-ENOMEM);
+
+	htab->map.key_size = attr->key_size;
+	htab->map.value_size = attr->value_size;
+	htab->map.max_entries = attr->max_entries;
+
+	htab->n_buckets = roundup_pow_of_two(htab->map.max_entries);
+	htab->elem_size = sizeof(struct htab_elem) +
+			  round_up(htab->map.key_size, 8) +
+			  htab->map.value_size;
+
+	if ((u64) htab->n_buckets * sizeof(struct hlist_head) > ULONG_MAX)
+		goto free_htab;
+
+	htab->buckets = htab_alloc_buckets(htab->n_buckets *
+					   sizeof(struct hlist_head));
+	if (!htab->buckets)
+		goto free_htab;
+
+	for (i = 0; i < htab->n_buckets; i++)
+		INIT_HLIST_HEAD(&htab->buckets[i]);
+
+	spin_lock_init(&htab->lock);
+	htab->count = 0;
+
+	return &htab->map;
+
+free_htab:
+	kfree(htab);
+	return ERR_PTR(-ENOMEM);
+}
+
+static inline u32 htab_map_hash(const void *key, u32 key_len)
+{
+	return jhash(key, key_len, 0);
+}
+
+static inline struct hlist_head *select_bucket(struct bpf_htab *htab, u32 hash)
+{
+	return &htab->buckets[hash & (htab->n_buckets - 1)];
+}
+
+static struct htab_elem *lookup_elem_raw(struct hlist_head *head, u32 hash,
+					 void *key, u32 key_size)
+{
+	struct hlist_node *node;
+	struct htab_elem *l;
+
+	hlist_for_each_entry_rcu(l, node, head, hash_node)
+		if (l->hash == hash && !memcmp(&l->key, key, key_size))
+			return l;
+
+	return NULL;
+}
+
+/* Called from syscall or from eBPF program, under rcu_read_lock() */
+static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct htab_elem *l;
+	u32 hash;
+
+	hash = htab_map_hash(key, map->key_size);
+	l = lookup_elem_raw(select_bucket(htab, hash), hash, key, map->key_size);
+	if (l)
+		return l->key + round_up(map->key_size, 8);
+
+	return NULL;
+}
+
+/* Called from syscall, under rcu_read_lock() */
+static int htab_map_get_next_key(struct bpf_map *map, void *key, void *next_key)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct hlist_node *next;
+	struct htab_elem *l;
+	u32 hash;
+	int i;
+
+	hash = htab_map_hash(key, map->key_size);
+	l = lookup_elem_raw(select_bucket(htab, hash), hash, key, map->key_size);
+	if (!l) {
+		/* unknown key, start again from the first bucket */
+		i = 0;
+		goto find_first_elem;
+	}
+
+	/* next element in the same bucket */
+	next = rcu_dereference_raw(hlist_next_rcu(&l->hash_node));
+	if (next) {
+		l = hlist_entry(next, struct htab_elem, hash_node);
+		memcpy(next_key, l->key, map->key_size);
+		return 0;
+	}
+
+	/* no more elements in this bucket */
+	i = (hash & (htab->n_buckets - 1)) + 1;
+
+find_first_elem:
+	for (; i < htab->n_buckets; i++) {
+		next = rcu_dereference_raw(hlist_first_rcu(&htab->buckets[i]));
+		if (next) {
+			l = hlist_entry(next, struct htab_elem, hash_node);
+			memcpy(next_key, l->key, map->key_size);
+			return 0;
+		}
+	}
+
+	/* iterated over all buckets and all elements */
+	return -ENOENT;
+}
+
+/* Called from syscall or from eBPF program, under rcu_read_lock() */
+static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
+				u64 map_flags)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct htab_elem *l_new, *l_old;
+	struct hlist_head *head;
+	unsigned long flags;
+	int ret;
+
+	if (map_flags > BPF_EXIST)
+		return -EINVAL;
+
+	/* programs run in softirq, allocate before taking the lock */
+	l_new = kmalloc(htab->elem_size, GFP_ATOMIC | __GFP_NOWARN);
+	if (!l_new)
+		return -ENOMEM;
+
+	memcpy(l_new->key, key, map->key_size);
+	memcpy(l_new->key + round_up(map->key_size, 8), value, map->value_size);
+	l_new->hash = htab_map_hash(key, map->key_size);
+	head = select_bucket(htab, l_new->hash);
+
+	spin_lock_irqsave(&htab->lock, flags);
+
+	l_old = lookup_elem_raw(head, l_new->hash, key, map->key_size);
+
+	if (!l_old && unlikely(htab->count >= map->max_entries)) {
+		ret = -E2BIG;
+		goto err;
+	}
+	if (l_old && map_flags == BPF_NOEXIST) {
+		ret = -EEXIST;
+		goto err;
+	}
+	if (!l_old && map_flags == BPF_EXIST) {
+		ret = -ENOENT;
+		goto err;
+	}
+
+	/* add the new element first, so lookups never miss the key */
+	hlist_add_head_rcu(&l_new->hash_node, head);
+	if (l_old) {
+		hlist_del_rcu(&l_old->hash_node);
+		kfree_rcu(l_old, rcu);
+	} else {
+		htab->count++;
+	}
+	spin_unlock_irqrestore(&htab->lock, flags);
+
+	return 0;
+err:
+	spin_unlock_irqrestore(&htab->lock, flags);
+	kfree(l_new);
+	return ret;
+}
+
+/* Called from syscall or from eBPF program, under rcu_read_lock() */
+static int htab_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct htab_elem *l;
+	unsigned long flags;
+	u32 hash;
+	int ret = -ENOENT;
+
+	hash = htab_map_hash(key, map->key_size);
+
+	spin_lock_irqsave(&htab->lock, flags);
+
+	l = lookup_elem_raw(select_bucket(htab, hash), hash, key, map->key_size);
+	if (l) {
+		hlist_del_rcu(&l->hash_node);
+		htab->count--;
+		kfree_rcu(l, rcu);
+		ret = 0;
+	}
+
+	spin_unlock_irqrestore(&htab->lock, flags);
+	return ret;
+}
+
+/* Called when the last map and program references are gone */
+static void htab_map_free(struct bpf_map *map)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct hlist_node *node, *n;
+	struct htab_elem *l;
+	u32 i;
+
+	for (i = 0; i < htab->n_buckets; i++)
+		hlist_for_each_entry_safe(l, node, n, &htab->buckets[i],
+					  hash_node) {
+			hlist_del_rcu(&l->hash_node);
+			kfree(l);
+		}
+
+	htab_free_buckets(htab->buckets);
+	kfree(htab);
+}
+
+static const struct bpf_map_ops htab_ops = {
+	.map_alloc		= htab_map_alloc,
+	.map_free		= htab_map_free,
+	.map_get_next_key	= htab_map_get_next_key,
+	.map_lookup_elem	= htab_map_lookup_elem,
+	.map_update_elem	= htab_map_update_elem,
+	.map_delete_elem	= htab_map_delete_elem,
+};
+
+static struct bpf_map_type_list htab_type __read_mostly = {
+	.ops	= &htab_ops,
+	.type	= BPF_MAP_TYPE_HASH,
+};
+
+static int __init register_htab_map(void)
+{
+	bpf_register_map_type(&htab_type);
+	return 0;
+}
+late_initcall(register_htab_map);
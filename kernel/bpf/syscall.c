@@ -0,0 +1,489 @@
+/*
+ * bpf() system call: maps and program loading
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * Maps and programs are reference counted objects behind anonymous
+ * inode file descriptors.  A program holds a reference on every map it
+ * uses, and is itself held by each socket or classifier it is attached
+ * to.  Programs run under rcu_read_lock(), so the last reference is
+ * dropped after a grace period and the rest of the teardown, which may
+ * free JIT images and maps, is done from a work item.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/syscalls.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/file.h>
+#include <linux/anon_inodes.h>
+#include <linux/license.h>
+#include <linux/bpf.h>
+#include <asm/uaccess.h>
+
+static LIST_HEAD(bpf_map_types);
+static LIST_HEAD(bpf_prog_types);
+
+/* called at boot only, by the map and program type implementations */
+void bpf_register_map_type(struct bpf_map_type_list *tl)
+{
+	list_add(&tl->list_node, &bpf_map_types);
+}
+
+void bpf_register_prog_type(struct bpf_prog_type_list *tl)
+{
+	list_add(&tl->list_node, &bpf_prog_types);
+}
+
+#define u64_to_ptr(x)	((void __user *)(unsigned long)(x))
+
+/* The fields of union bpf_attr past the last one used by a command
+ * must be zero, so that they can be given a meaning later.
+ */
+#define CHECK_ATTR(CMD)							\
+	(memchr_inv((void *) &attr->CMD##_LAST_FIELD +			\
+		    sizeof(attr->CMD##_LAST_FIELD), 0,			\
+		    sizeof(*attr) -					\
+		    offsetof(union bpf_attr, CMD##_LAST_FIELD) -	\
+		    sizeof(attr->CMD##_LAST_FIELD)) != NULL)
+
+static struct bpf_map *find_and_alloc_map(union bpf_attr *attr)
+{
+	struct bpf_map_type_list *tl;
+	struct bpf_map *map;
+
+	list_for_each_entry(tl, &bpf_map_types, list_node) {
+		if (tl->type == attr->map_type) {
+			map = tl->ops->map_alloc(attr);
+			if (IS_ERR(map))
+				return map;
+			map->ops = tl->ops;
+			map->map_type = attr->map_type;
+			return map;
+		}
+	}
+	return ERR_PTR(-EINVAL);
+}
+
+void bpf_map_put(struct bpf_map *map)
+{
+	if (atomic_dec_and_test(&map->refcnt))
+		map->ops->map_free(map);
+}
+
+static int bpf_map_release(struct inode *inode, struct file *filp)
+{
+	bpf_map_put(filp->private_data);
+	return 0;
+}
+
+static const struct file_operations bpf_map_fops = {
+	.release	= bpf_map_release,
+};
+
+#define BPF_MAP_CREATE_LAST_FIELD max_entries
+
+static int map_create(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_CREATE))
+		return -EINVAL;
+
+	map = find_and_alloc_map(attr);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	atomic_set(&map->refcnt, 1);
+
+	err = anon_inode_getfd("bpf-map", &bpf_map_fops, map, O_RDWR | O_CLOEXEC);
+	if (err < 0)
+		map->ops->map_free(map);
+	return err;
+}
+
+/**
+ *	bpf_map_get - get a reference on the map behind a file descriptor
+ *	@ufd: map file descriptor
+ *
+ *	Returns the map, to be released with bpf_map_put(), or an error
+ *	pointer if @ufd is not a map.
+ */
+struct bpf_map *bpf_map_get(u32 ufd)
+{
+	struct bpf_map *map;
+	struct file *f;
+
+	f = fget(ufd);
+	if (!f)
+		return ERR_PTR(-EBADF);
+	if (f->f_op != &bpf_map_fops) {
+		fput(f);
+		return ERR_PTR(-EINVAL);
+	}
+	map = f->private_data;
+	atomic_inc(&map->refcnt);
+	fput(f);
+	return map;
+}
+
+#define BPF_MAP_LOOKUP_ELEM_LAST_FIELD value
+
+static int map_lookup_elem(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	void *key, *value, *ptr;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_LOOKUP_ELEM))
+		return -EINVAL;
+
+	map = bpf_map_get(attr->map_fd);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	err = -ENOMEM;
+	key = kmalloc(map->key_size, GFP_USER);
+	value = kmalloc(map->value_size, GFP_USER);
+	if (!key || !value)
+		goto free;
+
+	err = -EFAULT;
+	if (copy_from_user(key, u64_to_ptr(attr->key), map->key_size))
+		goto free;
+
+	err = -ENOENT;
+	rcu_read_lock();
+	ptr = map->ops->map_lookup_elem(map, key);
+	if (ptr)
+		memcpy(value, ptr, map->value_size);
+	rcu_read_unlock();
+	if (!ptr)
+		goto free;
+
+	err = 0;
+	if (copy_to_user(u64_to_ptr(attr->value), value, map->value_size))
+		err = -EFAULT;
+free:
+	kfree(value);
+	kfree(key);
+	bpf_map_put(map);
+	return err;
+}
+
+#define BPF_MAP_UPDATE_ELEM_LAST_FIELD flags
+
+static int map_update_elem(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	void *key, *value;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_UPDATE_ELEM))
+		return -EINVAL;
+
+	map = bpf_map_get(attr->map_fd);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	err = -ENOMEM;
+	key = kmalloc(map->key_size, GFP_USER);
+	value = kmalloc(map->value_size, GFP_USER);
+	if (!key || !value)
+		goto free;
+
+	err = -EFAULT;
+	if (copy_from_user(key, u64_to_ptr(attr->key), map->key_size) ||
+	    copy_from_user(value, u64_to_ptr(attr->value), map->value_size))
+		goto free;
+
+	/* programs may be looking at the map at the same time */
+	rcu_read_lock();
+	err = map->ops->map_update_elem(map, key, value, attr->flags);
+	rcu_read_unlock();
+free:
+	kfree(value);
+	kfree(key);
+	bpf_map_put(map);
+	return err;
+}
+
+#define BPF_MAP_DELETE_ELEM_LAST_FIELD key
+
+static int map_delete_elem(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	void *key;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_DELETE_ELEM))
+		return -EINVAL;
+
+	map = bpf_map_get(attr->map_fd);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	err = -ENOMEM;
+	key = kmalloc(map->key_size, GFP_USER);
+	if (!key)
+		goto out;
+
+	err = -EFAULT;
+	if (copy_from_user(key, u64_to_ptr(attr->key), map->key_size))
+		goto free;
+
+	rcu_read_lock();
+	err = map->ops->map_delete_elem(map, key);
+	rcu_read_unlock();
+free:
+	kfree(key);
+out:
+	bpf_map_put(map);
+	return err;
+}
+
+#define BPF_MAP_GET_NEXT_KEY_LAST_FIELD next_key
+
+static int map_get_next_key(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	void *key, *next_key;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_GET_NEXT_KEY))
+		return -EINVAL;
+
+	map = bpf_map_get(attr->map_fd);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	err = -ENOMEM;
+	key = kmalloc(map->key_size, GFP_USER);
+	next_key = kmalloc(map->key_size, GFP_USER);
+	if (!key || !next_key)
+		goto free;
+
+	err = -EFAULT;
+	if (copy_from_user(key, u64_to_ptr(attr->key), map->key_size))
+		goto free;
+
+	rcu_read_lock();
+	err = map->ops->map_get_next_key(map, key, next_key);
+	rcu_read_unlock();
+	if (err)
+		goto free;
+
+	if (copy_to_user(u64_to_ptr(attr->next_key), next_key, map->key_size))
+		err = -EFAULT;
+free:
+	kfree(next_key);
+	kfree(key);
+	bpf_map_put(map);
+	return err;
+}
+
+static const struct bpf_verifier_ops *find_prog_type(enum bpf_prog_type type)
+{
+	struct bpf_prog_type_list *tl;
+
+	list_for_each_entry(tl, &bpf_prog_types, list_node)
+		if (tl->type == type)
+			return tl->ops;
+	return NULL;
+}
+
+static void bpf_prog_free_deferred(struct work_struct *work)
+{
+	struct bpf_prog *prog = container_of(work, struct bpf_prog, work);
+	u32 i;
+
+	if (prog->jited)
+		bpf_int_jit_free(prog);
+	for (i = 0; i < prog->used_map_cnt; i++)
+		bpf_map_put(prog->used_maps[i]);
+	kfree(prog->used_maps);
+	vfree(prog);
+}
+
+/* runs from softirq, JIT images and maps are freed from process context */
+static void bpf_prog_free_rcu(struct rcu_head *rcu)
+{
+	struct bpf_prog *prog = container_of(rcu, struct bpf_prog, rcu);
+
+	INIT_WORK(&prog->work, bpf_prog_free_deferred);
+	schedule_work(&prog->work);
+}
+
+/**
+ *	bpf_prog_put - release a program reference
+ *	@prog: program
+ *
+ *	May be called from any context.  The program is freed once the
+ *	last reference is gone and all running instances have finished.
+ */
+void bpf_prog_put(struct bpf_prog *prog)
+{
+	if (atomic_dec_and_test(&prog->refcnt))
+		call_rcu(&prog->rcu, bpf_prog_free_rcu);
+}
+EXPORT_SYMBOL_GPL(bpf_prog_put);
+
+static int bpf_prog_release(struct inode *inode, struct file *filp)
+{
+	bpf_prog_put(filp->private_data);
+	return 0;
+}
+
+static const struct file_operations bpf_prog_fops = {
+	.release	= bpf_prog_release,
+};
+
+/**
+ *	bpf_prog_get - get a reference on the program behind a descriptor
+ *	@ufd: program file descriptor
+ *
+ *	Returns the program, to be released with bpf_prog_put(), or an
+ *	error pointer if @ufd is not a program.
+ */
+struct bpf_prog *bpf_prog_get(u32 ufd)
+{
+	struct bpf_prog *prog;
+	struct file *f;
+
+	f = fget(ufd);
+	if (!f)
+		return ERR_PTR(-EBADF);
+	if (f->f_op != &bpf_prog_fops) {
+		fput(f);
+		return ERR_PTR(-EINVAL);
+	}
+	prog = f->private_data;
+	atomic_inc(&prog->refcnt);
+	fput(f);
+	return prog;
+}
+EXPORT_SYMBOL_GPL(bpf_prog_get);
+
+#define BPF_PROG_LOAD_LAST_FIELD log_buf
+
+static int bpf_prog_load(union bpf_attr *attr)
+{
+	const struct bpf_verifier_ops *ops;
+	struct bpf_prog *prog;
+	char license[128];
+	int err;
+
+	if (CHECK_ATTR(BPF_PROG_LOAD))
+		return -EINVAL;
+
+	ops = find_prog_type(attr->prog_type);
+	if (!ops)
+		return -EINVAL;
+
+	if (attr->insn_cnt == 0 || attr->insn_cnt > BPF_MAXINSNS)
+		return -E2BIG;
+
+	/* helpers may only be offered to GPL compatible programs */
+	if (strncpy_from_user(license, u64_to_ptr(attr->license),
+			      sizeof(license) - 1) < 0)
+		return -EFAULT;
+	license[sizeof(license) - 1] = 0;
+
+	prog = vzalloc(bpf_prog_size(attr->insn_cnt));
+	if (!prog)
+		return -ENOMEM;
+
+	atomic_set(&prog->refcnt, 1);
+	prog->len = attr->insn_cnt;
+	prog->type = attr->prog_type;
+	prog->ops = ops;
+	prog->gpl_compatible = license_is_gpl_compatible(license);
+
+	err = -EFAULT;
+	if (copy_from_user(prog->insnsi, u64_to_ptr(attr->insns),
+			   prog->len * sizeof(struct bpf_insn)))
+		goto free;
+
+	/* takes references on the maps used by the program */
+	err = bpf_check(prog, attr);
+	if (err < 0)
+		goto free;
+
+	prog->bpf_func = __bpf_prog_run;
+	bpf_int_jit_compile(prog);
+
+	err = anon_inode_getfd("bpf-prog", &bpf_prog_fops, prog, O_RDWR | O_CLOEXEC);
+	if (err < 0)
+		goto free;
+	return err;
+
+free:
+	/* not visible to anyone yet, no grace period needed */
+	bpf_prog_free_deferred(&prog->work);
+	return err;
+}
+
+SYSCALL_DEFINE3(bpf, int, cmd, union bpf_attr __user *, uattr, unsigned int, size)
+{
+	union bpf_attr attr = {};
+	int err;
+
+	/* programs run in kernel context and may read kernel memory */
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (!access_ok(VERIFY_READ, uattr, 1))
+		return -EFAULT;
+
+	if (size > PAGE_SIZE)
+		return -E2BIG;
+
+	/* a newer binary may pass a larger attr, accept it as long as
+	 * the fields this kernel does not know about are zero
+	 */
+	if (size > sizeof(attr)) {
+		unsigned char __user *addr = (unsigned char __user *) uattr;
+		unsigned char val;
+
+		for (addr += sizeof(attr); addr < (unsigned char __user *) uattr + size; addr++) {
+			err = get_user(val, addr);
+			if (err)
+				return err;
+			if (val)
+				return -E2BIG;
+		}
+		size = sizeof(attr);
+	}
+
+	if (copy_from_user(&attr, uattr, size) != 0)
+		return -EFAULT;
+
+	switch (cmd) {
+	case BPF_MAP_CREATE:
+		err = map_create(&attr);
+		break;
+	case BPF_MAP_LOOKUP_ELEM:
+		err = map_lookup_elem(&attr);
+		break;
+	case BPF_MAP_UPDATE_ELEM:
+		err = map_update_elem(&attr);
+		break;
+	case BPF_MAP_DELETE_ELEM:
+		err = map_delete_elem(&attr);
+		break;
+	case BPF_MAP_GET_NEXT_KEY:
+		err = map_get_next_key(&attr);
+		break;
+	case BPF_PROG_LOAD:
+		err = bpf_prog_load(&attr);
+		break;
+	default:
+		err = -EINVAL;
+		break;
+	}
+
+	return err;
+}
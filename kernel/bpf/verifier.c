@@ -0,0 +1,1685 @@
+/*
+ * eBPF program verifier
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * sk_chk_filter() can check a classic BPF program in one linear pass,
+ * because classic programs only jump forward, have two registers and
+ * no pointers.  eBPF programs hold pointers in registers and on the
+ * stack and call into the kernel, so bpf_check() does two passes:
+ *
+ * check_cfg() walks the control flow graph depth first and rejects
+ * loops (back edges), jumps out of the program and unreachable
+ * instructions, so every program is a DAG and terminates.
+ *
+ * do_check() then simulates every path through the program, tracking
+ * the type of each register and of each stack byte:
+ *
+ *  - registers and stack slots must be written before they are read;
+ *  - R1 starts as PTR_TO_CTX and R10 as FRAME_PTR (read only);
+ *  - loads and stores are only allowed through a pointer, within the
+ *    bounds of the object it points to: the stack, a map value or the
+ *    fields of the context the program type allows;
+ *  - calls are only allowed to the helpers the program type offers,
+ *    with arguments of the types in the helper's bpf_func_proto, and
+ *    clobber R1-R5;
+ *  - bpf_map_lookup_elem() returns PTR_TO_MAP_VALUE_OR_NULL, which must
+ *    be compared against 0 before it can be dereferenced;
+ *  - pointers may be spilled to the stack and filled again with 8 byte
+ *    aligned stores and loads.
+ *
+ * At a conditional jump the state of the other branch is pushed on a
+ * stack and explored later.  To keep this from growing exponentially,
+ * the states seen at every jump target are remembered, and a path is
+ * pruned when it reaches a jump target in a state that is at least as
+ * constrained as one already found safe there.
+ *
+ * Once the program is known to be safe, map file descriptors in
+ * BPF_LD | BPF_IMM | BPF_DW are replaced by the maps, context loads are
+ * rewritten by the program type to loads from the real context, and
+ * helper ids in BPF_CALL are replaced by the helper's offset from
+ * __bpf_call_base.
+ */
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/stddef.h>
+#include <linux/bpf.h>
+#include <asm/uaccess.h>
+
+/* types of values stored in eBPF registers */
+enum bpf_reg_type {
+	NOT_INIT = 0,		 /* nothing was written into register */
+	UNKNOWN_VALUE,		 /* reg doesn't contain a valid pointer */
+	PTR_TO_CTX,		 /* reg points to the program context */
+	CONST_PTR_TO_MAP,	 /* reg points to struct bpf_map */
+	PTR_TO_MAP_VALUE,	 /* reg points to map element value */
+	PTR_TO_MAP_VALUE_OR_NULL,/* points to map elem value or NULL */
+	FRAME_PTR,		 /* reg == frame_pointer */
+	PTR_TO_STACK,		 /* reg == frame_pointer + imm */
+	CONST_IMM,		 /* constant integer value */
+};
+
+struct reg_state {
+	enum bpf_reg_type type;
+	union {
+		/* valid when type == CONST_IMM | PTR_TO_STACK, as wide
+		 * as map_ptr so that states can be compared with memcmp()
+		 */
+		long imm;
+
+		/* valid when type == CONST_PTR_TO_MAP | PTR_TO_MAP_VALUE |
+		 *   PTR_TO_MAP_VALUE_OR_NULL
+		 */
+		struct bpf_map *map_ptr;
+	};
+};
+
+enum bpf_stack_slot_type {
+	STACK_INVALID,	/* nothing was stored in this stack slot */
+	STACK_SPILL,	/* register spilled into stack */
+	STACK_MISC	/* BPF program wrote some data into this slot */
+};
+
+#define BPF_REG_SIZE 8	/* size of eBPF register in bytes */
+
+/* state of the program at one instruction */
+struct verifier_state {
+	struct reg_state regs[MAX_BPF_REG];
+	u8 stack_slot_type[MAX_BPF_STACK];
+	struct reg_state spilled_regs[MAX_BPF_STACK / BPF_REG_SIZE];
+};
+
+/* linked list of verifier states used to prune the search */
+struct verifier_state_list {
+	struct verifier_state state;
+	struct verifier_state_list *next;
+};
+
+/* branch not explored yet */
+struct verifier_stack_elem {
+	struct verifier_state st;
+	int insn_idx;
+	struct verifier_stack_elem *next;
+};
+
+/* how a load or store instruction was seen to access memory */
+enum {
+	MEM_ACCESS_NONE,
+	MEM_ACCESS_CTX,
+	MEM_ACCESS_OTHER,
+};
+
+#define MAX_USED_MAPS	64	/* max number of maps accessed by one program */
+#define BPF_COMPLEXITY_LIMIT_INSNS	32768
+#define BPF_COMPLEXITY_LIMIT_STACK	1024
+
+#define STATE_LIST_MARK ((struct verifier_state_list *) -1L)
+
+/* single container for all structs, one per bpf_check() call */
+struct verifier_env {
+	struct bpf_prog *prog;
+	struct verifier_stack_elem *head;	/* stack of branches */
+	int stack_size;				/* number of pushed branches */
+	struct verifier_state cur_state;
+	struct verifier_state_list **explored_states; /* search pruning */
+	u8 *mem_access;				/* per insn MEM_ACCESS_* */
+	int *insn_state;			/* check_cfg() DFS state */
+	int *insn_stack;			/* stack of insns to process */
+	int cur_stack;				/* current stack index */
+	struct bpf_map *used_maps[MAX_USED_MAPS];
+	u32 used_map_cnt;
+	char *log_buf;
+	u32 log_size;
+	u32 log_len;
+};
+
+/* verbose verifier prints what it's seeing, into the user's log buffer */
+static __printf(2, 3) void verbose(struct verifier_env *env,
+				   const char *fmt, ...)
+{
+	va_list args;
+
+	if (!env->log_buf || env->log_len >= env->log_size - 1)
+		return;
+
+	va_start(args, fmt);
+	env->log_len += vscnprintf(env->log_buf + env->log_len,
+				   env->log_size - env->log_len, fmt, args);
+	va_end(args);
+}
+
+static const char * const reg_type_str[] = {
+	[NOT_INIT]		= "?",
+	[UNKNOWN_VALUE]		= "inv",
+	[PTR_TO_CTX]		= "ctx",
+	[CONST_PTR_TO_MAP]	= "map_ptr",
+	[PTR_TO_MAP_VALUE]	= "map_value",
+	[PTR_TO_MAP_VALUE_OR_NULL] = "map_value_or_null",
+	[FRAME_PTR]		= "fp",
+	[PTR_TO_STACK]		= "fp",
+	[CONST_IMM]		= "imm",
+};
+
+static int pop_stack(struct verifier_env *env)
+{
+	struct verifier_stack_elem *elem;
+	int insn_idx;
+
+	if (!env->head)
+		return -1;
+
+	memcpy(&env->cur_state, &env->head->st, sizeof(env->cur_state));
+	insn_idx = env->head->insn_idx;
+	elem = env->head->next;
+	kfree(env->head);
+	env->head = elem;
+	env->stack_size--;
+	return insn_idx;
+}
+
+static int push_stack(struct verifier_env *env, int insn_idx)
+{
+	struct verifier_stack_elem *elem;
+
+	elem = kmalloc(sizeof(*elem), GFP_KERNEL);
+	if (!elem)
+		return -ENOMEM;
+
+	memcpy(&elem->st, &env->cur_state, sizeof(env->cur_state));
+	elem->insn_idx = insn_idx;
+	elem->next = env->head;
+	env->head = elem;
+	if (++env->stack_size > BPF_COMPLEXITY_LIMIT_STACK) {
+		verbose(env, "BPF program is too complex\n");
+		return -E2BIG;
+	}
+	return 0;
+}
+
+static void free_stack(struct verifier_env *env)
+{
+	while (pop_stack(env) >= 0)
+		;
+}
+
+static const int caller_saved[] = {
+	BPF_REG_0, BPF_REG_1, BPF_REG_2, BPF_REG_3, BPF_REG_4, BPF_REG_5
+};
+
+static void init_reg_state(struct reg_state *regs)
+{
+	int i;
+
+	for (i = 0; i < MAX_BPF_REG; i++) {
+		regs[i].type = NOT_INIT;
+		regs[i].imm = 0;
+	}
+
+	/* frame pointer */
+	regs[BPF_REG_10].type = FRAME_PTR;
+
+	/* 1st arg to a function */
+	regs[BPF_REG_1].type = PTR_TO_CTX;
+}
+
+static void mark_reg_unknown_value(struct reg_state *regs, u32 regno)
+{
+	regs[regno].type = UNKNOWN_VALUE;
+	regs[regno].imm = 0;
+}
+
+enum reg_arg_type {
+	SRC_OP,		/* register is used as source operand */
+	DST_OP,		/* register is used as destination operand */
+	DST_OP_NO_MARK	/* same as above, check only, don't mark */
+};
+
+static int check_reg_arg(struct verifier_env *env, u32 regno,
+			 enum reg_arg_type t)
+{
+	struct reg_state *regs = env->cur_state.regs;
+
+	if (regno >= MAX_BPF_REG) {
+		verbose(env, "R%d is invalid\n", regno);
+		return -EINVAL;
+	}
+
+	if (t == SRC_OP) {
+		/* check whether register used as source operand can be read */
+		if (regs[regno].type == NOT_INIT) {
+			verbose(env, "R%d !read_ok\n", regno);
+			return -EACCES;
+		}
+	} else {
+		/* check whether register used as dest operand can be written to */
+		if (regno == BPF_REG_10) {
+			verbose(env, "frame pointer is read only\n");
+			return -EACCES;
+		}
+		if (t == DST_OP)
+			mark_reg_unknown_value(regs, regno);
+	}
+	return 0;
+}
+
+static int bpf_size_to_bytes(int bpf_size)
+{
+	if (bpf_size == BPF_W)
+		return 4;
+	else if (bpf_size == BPF_H)
+		return 2;
+	else if (bpf_size == BPF_B)
+		return 1;
+	else if (bpf_size == BPF_DW)
+		return 8;
+	else
+		return -EINVAL;
+}
+
+static bool is_spillable(enum bpf_reg_type type)
+{
+	return type != NOT_INIT && type != UNKNOWN_VALUE && type != CONST_IMM;
+}
+
+/* check_stack_read/write functions track spill/fill of registers,
+ * stack boundary and alignment are checked in check_mem_access()
+ */
+static int check_stack_write(struct verifier_env *env, int off, int size,
+			     int value_regno)
+{
+	struct verifier_state *state = &env->cur_state;
+	int i, slot = (MAX_BPF_STACK + off) / BPF_REG_SIZE;
+
+	if (value_regno >= 0 &&
+	    is_spillable(state->regs[value_regno].type)) {
+
+		/* register containing pointer is being spilled into stack */
+		if (size != BPF_REG_SIZE) {
+			verbose(env, "invalid size of register spill\n");
+			return -EACCES;
+		}
+
+		/* save register state */
+		state->spilled_regs[slot] = state->regs[value_regno];
+
+		for (i = 0; i < BPF_REG_SIZE; i++)
+			state->stack_slot_type[MAX_BPF_STACK + off + i] = STACK_SPILL;
+	} else {
+		/* regular write of data into stack, clobbers a spilled
+		 * register in the same slot
+		 */
+		if (state->stack_slot_type[slot * BPF_REG_SIZE] == STACK_SPILL) {
+			for (i = 0; i < BPF_REG_SIZE; i++)
+				state->stack_slot_type[slot * BPF_REG_SIZE + i] =
+					STACK_MISC;
+			state->spilled_regs[slot] = (struct reg_state) {};
+		}
+
+		for (i = 0; i < size; i++)
+			state->stack_slot_type[MAX_BPF_STACK + off + i] = STACK_MISC;
+	}
+	return 0;
+}
+
+static int check_stack_read(struct verifier_env *env, int off, int size,
+			    int value_regno)
+{
+	struct verifier_state *state = &env->cur_state;
+	u8 *slot_type;
+	int i;
+
+	slot_type = &state->stack_slot_type[MAX_BPF_STACK + off];
+
+	if (slot_type[0] == STACK_SPILL) {
+		if (size != BPF_REG_SIZE) {
+			verbose(env, "invalid size of register spill\n");
+			return -EACCES;
+		}
+		for (i = 1; i < BPF_REG_SIZE; i++) {
+			if (slot_type[i] != STACK_SPILL) {
+				verbose(env, "corrupted spill memory\n");
+				return -EACCES;
+			}
+		}
+
+		if (value_regno >= 0)
+			/* restore register state from stack */
+			state->regs[value_regno] =
+				state->spilled_regs[(MAX_BPF_STACK + off) / BPF_REG_SIZE];
+		return 0;
+	}
+
+	for (i = 0; i < size; i++) {
+		if (slot_type[i] != STACK_MISC) {
+			verbose(env, "invalid read from stack off %d+%d size %d\n",
+				off, i, size);
+			return -EACCES;
+		}
+	}
+	if (value_regno >= 0)
+		/* have read misc data from the stack */
+		mark_reg_unknown_value(state->regs, value_regno);
+	return 0;
+}
+
+/* check read/write into map element returned by bpf_map_lookup_elem() */
+static int check_map_access(struct verifier_env *env, u32 regno, int off,
+			    int size)
+{
+	struct bpf_map *map = env->cur_state.regs[regno].map_ptr;
+
+	if (off < 0 || off + size > map->value_size) {
+		verbose(env, "invalid access to map value, value_size=%d off=%d size=%d\n",
+			map->value_size, off, size);
+		return -EACCES;
+	}
+	return 0;
+}
+
+/* check access to 'struct bpf_context' fields */
+static int check_ctx_access(struct verifier_env *env, int off, int size,
+			    enum bpf_access_type t)
+{
+	if (env->prog->ops->is_valid_access &&
+	    env->prog->ops->is_valid_access(off, size, t))
+		return 0;
+
+	verbose(env, "invalid bpf_context access off=%d size=%d\n", off, size);
+	return -EACCES;
+}
+
+/* check whether memory at (regno + off) is accessible for t = (read | write)
+ * if t==write, value_regno is a register which value is stored into memory
+ * if t==read, value_regno is a register which will receive the value from memory
+ * if t==write && value_regno==-1, some unknown value is stored into memory
+ * if t==read && value_regno==-1, don't care what we read from memory
+ */
+static int check_mem_access(struct verifier_env *env, int insn_idx, u32 regno,
+			    int off, int bpf_size, enum bpf_access_type t,
+			    int value_regno)
+{
+	struct verifier_state *state = &env->cur_state;
+	struct reg_state *reg = &state->regs[regno];
+	int size, err, access = MEM_ACCESS_OTHER;
+
+	size = bpf_size_to_bytes(bpf_size);
+	if (size < 0)
+		return size;
+
+	if (reg->type == PTR_TO_STACK)
+		off += reg->imm;
+
+	if (off % size != 0) {
+		verbose(env, "misaligned access off %d size %d\n", off, size);
+		return -EACCES;
+	}
+
+	if (reg->type == PTR_TO_MAP_VALUE) {
+		err = check_map_access(env, regno, off, size);
+		if (!err && t == BPF_READ && value_regno >= 0)
+			mark_reg_unknown_value(state->regs, value_regno);
+
+	} else if (reg->type == PTR_TO_CTX) {
+		access = MEM_ACCESS_CTX;
+		err = check_ctx_access(env, off, size, t);
+		if (!err && t == BPF_READ && value_regno >= 0)
+			mark_reg_unknown_value(state->regs, value_regno);
+
+	} else if (reg->type == FRAME_PTR || reg->type == PTR_TO_STACK) {
+		if (off >= 0 || off < -MAX_BPF_STACK) {
+			verbose(env, "invalid stack off=%d size=%d\n", off, size);
+			return -EACCES;
+		}
+		if (t == BPF_WRITE)
+			err = check_stack_write(env, off, size, value_regno);
+		else
+			err = check_stack_read(env, off, size, value_regno);
+	} else {
+		verbose(env, "R%d invalid mem access '%s'\n",
+			regno, reg_type_str[reg->type]);
+		return -EACCES;
+	}
+	if (err)
+		return err;
+
+	/* context accesses are rewritten after verification, so one
+	 * instruction must not access both the context and other memory
+	 */
+	if (env->mem_access[insn_idx] == MEM_ACCESS_NONE) {
+		env->mem_access[insn_idx] = access;
+	} else if (env->mem_access[insn_idx] != access) {
+		verbose(env, "same insn cannot be used with different pointers\n");
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int check_xadd(struct verifier_env *env, int insn_idx,
+		      struct bpf_insn *insn)
+{
+	int err;
+
+	if ((BPF_SIZE(insn->code) != BPF_W && BPF_SIZE(insn->code) != BPF_DW) ||
+	    insn->imm != 0) {
+		verbose(env, "BPF_XADD uses reserved fields\n");
+		return -EINVAL;
+	}
+
+	/* check src1 operand */
+	err = check_reg_arg(env, insn->src_reg, SRC_OP);
+	if (err)
+		return err;
+
+	/* check src2 operand */
+	err = check_reg_arg(env, insn->dst_reg, SRC_OP);
+	if (err)
+		return err;
+
+	if (env->cur_state.regs[insn->dst_reg].type == PTR_TO_CTX) {
+		verbose(env, "BPF_XADD into context is not allowed\n");
+		return -EACCES;
+	}
+
+	/* check whether atomic_add can read the memory */
+	err = check_mem_access(env, insn_idx, insn->dst_reg, insn->off,
+			       BPF_SIZE(insn->code), BPF_READ, -1);
+	if (err)
+		return err;
+
+	/* check whether atomic_add can write into the same memory */
+	return check_mem_access(env, insn_idx, insn->dst_reg, insn->off,
+				BPF_SIZE(insn->code), BPF_WRITE, -1);
+}
+
+/* when register 'regno' is passed into function that will read 'access_size'
+ * bytes from that pointer, make sure that it's within stack boundary
+ * and all elements of stack are initialized
+ */
+static int check_stack_boundary(struct verifier_env *env, int regno,
+				int access_size)
+{
+	struct verifier_state *state = &env->cur_state;
+	struct reg_state *regs = state->regs;
+	int off, i;
+
+	if (regs[regno].type != PTR_TO_STACK) {
+		verbose(env, "R%d type=%s expected=fp\n", regno,
+			reg_type_str[regs[regno].type]);
+		return -EACCES;
+	}
+
+	off = regs[regno].imm;
+	if (off >= 0 || off < -MAX_BPF_STACK || off + access_size > 0 ||
+	    access_size <= 0) {
+		verbose(env, "invalid stack type R%d off=%d access_size=%d\n",
+			regno, off, access_size);
+		return -EACCES;
+	}
+
+	for (i = 0; i < access_size; i++) {
+		if (state->stack_slot_type[MAX_BPF_STACK + off + i] != STACK_MISC) {
+			verbose(env, "invalid indirect read from stack off %d+%d size %d\n",
+				off, i, access_size);
+			return -EACCES;
+		}
+	}
+	return 0;
+}
+
+static int check_func_arg(struct verifier_env *env, u32 regno,
+			  enum bpf_arg_type arg_type, struct bpf_map **mapp)
+{
+	struct reg_state *reg = env->cur_state.regs + regno;
+
+	if (arg_type == ARG_DONTCARE)
+		return 0;
+
+	if (reg->type == NOT_INIT) {
+		verbose(env, "R%d !read_ok\n", regno);
+		return -EACCES;
+	}
+
+	switch (arg_type) {
+	case ARG_ANYTHING:
+		return 0;
+
+	case ARG_CONST_MAP_PTR:
+		if (reg->type != CONST_PTR_TO_MAP) {
+			verbose(env, "R%d type=%s expected=map_ptr\n", regno,
+				reg_type_str[reg->type]);
+			return -EACCES;
+		}
+		/* remember the map for the key and value checks */
+		*mapp = reg->map_ptr;
+		return 0;
+
+	case ARG_PTR_TO_MAP_KEY:
+		/* bpf_map_xxx(..., map_ptr, ..., key) call:
+		 * check that [key, key + map->key_size) are within
+		 * stack limits and initialized
+		 */
+		if (!*mapp) {
+			verbose(env, "invalid map_ptr to access map->key\n");
+			return -EACCES;
+		}
+		return check_stack_boundary(env, regno, (*mapp)->key_size);
+
+	case ARG_PTR_TO_MAP_VALUE:
+		/* bpf_map_xxx(..., map_ptr, ..., value) call:
+		 * check [value, value + map->value_size) validity
+		 */
+		if (!*mapp) {
+			verbose(env, "invalid map_ptr to access map->value\n");
+			return -EACCES;
+		}
+		return check_stack_boundary(env, regno, (*mapp)->value_size);
+
+	default:
+		verbose(env, "unsupported arg_type %d\n", arg_type);
+		return -EFAULT;
+	}
+}
+
+static int check_call(struct verifier_env *env, int func_id)
+{
+	struct verifier_state *state = &env->cur_state;
+	const struct bpf_func_proto *fn = NULL;
+	struct reg_state *regs = state->regs;
+	struct bpf_map *map = NULL;
+	int i, err;
+
+	/* find function prototype */
+	if (func_id <= BPF_FUNC_unspec || func_id >= __BPF_FUNC_MAX_ID) {
+		verbose(env, "invalid func %d\n", func_id);
+		return -EINVAL;
+	}
+
+	if (env->prog->ops->get_func_proto)
+		fn = env->prog->ops->get_func_proto(func_id);
+
+	if (!fn) {
+		verbose(env, "unknown func %d\n", func_id);
+		return -EINVAL;
+	}
+
+	/* eBPF programs must be GPL compatible to use GPL-ed functions */
+	if (!env->prog->gpl_compatible && fn->gpl_only) {
+		verbose(env, "cannot call GPL only function from proprietary program\n");
+		return -EINVAL;
+	}
+
+	/* check args */
+	err = check_func_arg(env, BPF_REG_1, fn->arg1_type, &map);
+	if (err)
+		return err;
+	err = check_func_arg(env, BPF_REG_2, fn->arg2_type, &map);
+	if (err)
+		return err;
+	err = check_func_arg(env, BPF_REG_3, fn->arg3_type, &map);
+	if (err)
+		return err;
+	err = check_func_arg(env, BPF_REG_4, fn->arg4_type, &map);
+	if (err)
+		return err;
+	err = check_func_arg(env, BPF_REG_5, fn->arg5_type, &map);
+	if (err)
+		return err;
+
+	/* reset caller saved regs */
+	for (i = 0; i < ARRAY_SIZE(caller_saved); i++) {
+		regs[caller_saved[i]].type = NOT_INIT;
+		regs[caller_saved[i]].imm = 0;
+	}
+
+	/* update return register */
+	if (fn->ret_type == RET_INTEGER) {
+		regs[BPF_REG_0].type = UNKNOWN_VALUE;
+	} else if (fn->ret_type == RET_VOID) {
+		regs[BPF_REG_0].type = NOT_INIT;
+	} else if (fn->ret_type == RET_PTR_TO_MAP_VALUE_OR_NULL) {
+		regs[BPF_REG_0].type = PTR_TO_MAP_VALUE_OR_NULL;
+		/* remember map_ptr, so that check_map_access()
+		 * can check 'value_size' boundary of memory access
+		 * to map element returned from bpf_map_lookup_elem()
+		 */
+		if (!map) {
+			verbose(env, "kernel subsystem misconfigured verifier\n");
+			return -EINVAL;
+		}
+		regs[BPF_REG_0].map_ptr = map;
+	} else {
+		verbose(env, "unknown return type %d of func %d\n",
+			fn->ret_type, func_id);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* check validity of 32-bit and 64-bit arithmetic operations */
+static int check_alu_op(struct verifier_env *env, struct bpf_insn *insn)
+{
+	struct reg_state *regs = env->cur_state.regs;
+	u8 opcode = BPF_OP(insn->code);
+	int err;
+
+	if (opcode == BPF_END || opcode == BPF_NEG) {
+		if (opcode == BPF_NEG) {
+			if (BPF_SRC(insn->code) != 0 ||
+			    insn->src_reg != BPF_REG_0 ||
+			    insn->off != 0 || insn->imm != 0) {
+				verbose(env, "BPF_NEG uses reserved fields\n");
+				return -EINVAL;
+			}
+		} else {
+			if (insn->src_reg != BPF_REG_0 || insn->off != 0 ||
+			    (insn->imm != 16 && insn->imm != 32 && insn->imm != 64) ||
+			    BPF_CLASS(insn->code) == BPF_ALU64) {
+				verbose(env, "BPF_END uses reserved fields\n");
+				return -EINVAL;
+			}
+		}
+
+		/* check src operand */
+		err = check_reg_arg(env, insn->dst_reg, SRC_OP);
+		if (err)
+			return err;
+
+		/* check dest operand */
+		return check_reg_arg(env, insn->dst_reg, DST_OP);
+
+	} else if (opcode == BPF_MOV) {
+
+		if (BPF_SRC(insn->code) == BPF_X) {
+			if (insn->imm != 0 || insn->off != 0) {
+				verbose(env, "BPF_MOV uses reserved fields\n");
+				return -EINVAL;
+			}
+
+			/* check src operand */
+			err = check_reg_arg(env, insn->src_reg, SRC_OP);
+			if (err)
+				return err;
+		} else {
+			if (insn->src_reg != BPF_REG_0 || insn->off != 0) {
+				verbose(env, "BPF_MOV uses reserved fields\n");
+				return -EINVAL;
+			}
+		}
+
+		/* check dest operand */
+		err = check_reg_arg(env, insn->dst_reg, DST_OP);
+		if (err)
+			return err;
+
+		if (BPF_SRC(insn->code) == BPF_X) {
+			if (BPF_CLASS(insn->code) == BPF_ALU64) {
+				/* case: R1 = R2
+				 * copy register state to dest reg
+				 */
+				regs[insn->dst_reg] = regs[insn->src_reg];
+			} else {
+				/* 32-bit move truncates pointers */
+				mark_reg_unknown_value(regs, insn->dst_reg);
+			}
+		} else {
+			/* case: R = imm
+			 * remember the value we stored into this reg; a 32-bit
+			 * move zero-extends imm instead of sign-extending it
+			 */
+			regs[insn->dst_reg].type = CONST_IMM;
+			if (BPF_CLASS(insn->code) == BPF_ALU64)
+				regs[insn->dst_reg].imm = insn->imm;
+			else
+				regs[insn->dst_reg].imm = (u32) insn->imm;
+		}
+
+	} else if (opcode > BPF_END) {
+		verbose(env, "invalid BPF_ALU opcode %x\n", opcode);
+		return -EINVAL;
+
+	} else {	/* all other ALU ops: and, sub, xor, add, ... */
+
+		bool stack_relative = false;
+
+		if (BPF_SRC(insn->code) == BPF_X) {
+			if (insn->imm != 0 || insn->off != 0) {
+				verbose(env, "BPF_ALU uses reserved fields\n");
+				return -EINVAL;
+			}
+			/* check src1 operand */
+			err = check_reg_arg(env, insn->src_reg, SRC_OP);
+			if (err)
+				return err;
+		} else {
+			if (insn->src_reg != BPF_REG_0 || insn->off != 0) {
+				verbose(env, "BPF_ALU uses reserved fields\n");
+				return -EINVAL;
+			}
+		}
+
+		/* check src2 operand */
+		err = check_reg_arg(env, insn->dst_reg, SRC_OP);
+		if (err)
+			return err;
+
+		if ((opcode == BPF_MOD || opcode == BPF_DIV) &&
+		    BPF_SRC(insn->code) == BPF_K && insn->imm == 0) {
+			verbose(env, "div by zero\n");
+			return -EINVAL;
+		}
+
+		if ((opcode == BPF_LSH || opcode == BPF_RSH ||
+		     opcode == BPF_ARSH) && BPF_SRC(insn->code) == BPF_K) {
+			int size = BPF_CLASS(insn->code) == BPF_ALU64 ? 64 : 32;
+
+			if (insn->imm < 0 || insn->imm >= size) {
+				verbose(env, "invalid shift %d\n", insn->imm);
+				return -EINVAL;
+			}
+		}
+
+		/* pattern match 'bpf_add Rx, imm' instruction */
+		if (opcode == BPF_ADD && BPF_CLASS(insn->code) == BPF_ALU64 &&
+		    regs[insn->dst_reg].type == FRAME_PTR &&
+		    BPF_SRC(insn->code) == BPF_K)
+			stack_relative = true;
+
+		/* check dest operand */
+		err = check_reg_arg(env, insn->dst_reg, DST_OP);
+		if (err)
+			return err;
+
+		if (stack_relative) {
+			regs[insn->dst_reg].type = PTR_TO_STACK;
+			regs[insn->dst_reg].imm = insn->imm;
+		}
+	}
+
+	return 0;
+}
+
+static int check_cond_jmp_op(struct verifier_env *env,
+			     struct bpf_insn *insn, int *insn_idx)
+{
+	struct reg_state *regs = env->cur_state.regs;
+	struct reg_state *dst = &regs[insn->dst_reg];
+	u8 opcode = BPF_OP(insn->code);
+	int err, other = *insn_idx + insn->off + 1;
+
+	if (opcode > BPF_EXIT) {
+		verbose(env, "invalid BPF_JMP opcode %x\n", opcode);
+		return -EINVAL;
+	}
+
+	if (BPF_SRC(insn->code) == BPF_X) {
+		if (insn->imm != 0) {
+			verbose(env, "BPF_JMP uses reserved fields\n");
+			return -EINVAL;
+		}
+
+		/* check src1 operand */
+		err = check_reg_arg(env, insn->src_reg, SRC_OP);
+		if (err)
+			return err;
+	} else {
+		if (insn->src_reg != BPF_REG_0) {
+			verbose(env, "BPF_JMP uses reserved fields\n");
+			return -EINVAL;
+		}
+	}
+
+	/* check src2 operand */
+	err = check_reg_arg(env, insn->dst_reg, SRC_OP);
+	if (err)
+		return err;
+
+	/* detect if R == imm where both are known constants */
+	if (BPF_SRC(insn->code) == BPF_K &&
+	    (opcode == BPF_JEQ || opcode == BPF_JNE) &&
+	    dst->type == CONST_IMM) {
+		if ((opcode == BPF_JEQ && dst->imm == insn->imm) ||
+		    (opcode == BPF_JNE && dst->imm != insn->imm))
+			/* only follow the goto, ignore fall-through */
+			*insn_idx += insn->off;
+		/* else only follow fall-through */
+		return 0;
+	}
+
+	err = push_stack(env, other);
+	if (err)
+		return err;
+
+	/* detect if R == 0 where R is returned from bpf_map_lookup_elem() */
+	if (BPF_SRC(insn->code) == BPF_K && insn->imm == 0 &&
+	    (opcode == BPF_JEQ || opcode == BPF_JNE) &&
+	    dst->type == PTR_TO_MAP_VALUE_OR_NULL) {
+		struct reg_state *other_dst = &env->head->st.regs[insn->dst_reg];
+
+		if (opcode == BPF_JEQ) {
+			/* next fallthrough insn can access memory via
+			 * this register
+			 */
+			dst->type = PTR_TO_MAP_VALUE;
+			/* branch targer cannot access it, since reg == 0 */
+			other_dst->type = CONST_IMM;
+			other_dst->imm = 0;
+		} else {
+			other_dst->type = PTR_TO_MAP_VALUE;
+			dst->type = CONST_IMM;
+			dst->imm = 0;
+		}
+	}
+	return 0;
+}
+
+/* return the map pointer stored in a BPF_LD | BPF_IMM | BPF_DW pair */
+static struct bpf_map *ld_imm64_to_map_ptr(struct bpf_insn *insn)
+{
+	u64 imm64 = ((u64) (u32) insn[0].imm) | ((u64) (u32) insn[1].imm) << 32;
+
+	return (struct bpf_map *) (unsigned long) imm64;
+}
+
+/* verify BPF_LD_IMM64 instruction */
+static int check_ld_imm(struct verifier_env *env, struct bpf_insn *insn)
+{
+	struct reg_state *regs = env->cur_state.regs;
+	int err;
+
+	err = check_reg_arg(env, insn->dst_reg, DST_OP);
+	if (err)
+		return err;
+
+	if (insn->src_reg == BPF_PSEUDO_MAP_FD) {
+		regs[insn->dst_reg].type = CONST_PTR_TO_MAP;
+		regs[insn->dst_reg].map_ptr = ld_imm64_to_map_ptr(insn);
+	}
+	return 0;
+}
+
+/* verify safety of LD_ABS|LD_IND instructions:
+ * - they can only appear in programs whose context is an sk_buff
+ * - they implicitly take the sk_buff from R6
+ * - they clobber R1-R5 like a call and return the value in R0
+ */
+static int check_ld_abs(struct verifier_env *env, struct bpf_insn *insn)
+{
+	struct reg_state *regs = env->cur_state.regs;
+	u8 mode = BPF_MODE(insn->code);
+	int i, err;
+
+	if (!env->prog->ops->has_ld_abs) {
+		verbose(env, "BPF_LD_ABS|IND instructions not allowed for this program type\n");
+		return -EINVAL;
+	}
+
+	if (insn->dst_reg != BPF_REG_0 || insn->off != 0 ||
+	    BPF_SIZE(insn->code) == BPF_DW ||
+	    (mode == BPF_ABS && insn->src_reg != BPF_REG_0)) {
+		verbose(env, "BPF_LD_ABS uses reserved fields\n");
+		return -EINVAL;
+	}
+
+	/* check whether implicit source operand (register R6) is readable */
+	err = check_reg_arg(env, BPF_REG_6, SRC_OP);
+	if (err)
+		return err;
+
+	if (regs[BPF_REG_6].type != PTR_TO_CTX) {
+		verbose(env, "at the time of BPF_LD_ABS|IND R6 != pointer to skb\n");
+		return -EINVAL;
+	}
+
+	if (mode == BPF_IND) {
+		/* check explicit source operand */
+		err = check_reg_arg(env, insn->src_reg, SRC_OP);
+		if (err)
+			return err;
+	}
+
+	/* reset caller saved regs to unreadable */
+	for (i = 0; i < ARRAY_SIZE(caller_saved); i++) {
+		regs[caller_saved[i]].type = NOT_INIT;
+		regs[caller_saved[i]].imm = 0;
+	}
+
+	/* mark destination R0 register as readable, since it contains
+	 * the value fetched from the packet
+	 */
+	regs[BPF_REG_0].type = UNKNOWN_VALUE;
+	return 0;
+}
+
+/* non-recursive DFS pseudo code
+ * 1  procedure DFS-iterative(G,v):
+ * 2      label v as discovered
+ * 3      let S be a stack
+ * 4      S.push(v)
+ * 5      while S is not empty
+ * 6            t <- S.pop()
+ * 7            if t is what we're looking for:
+ * 8                return t
+ * 9            for all edges e in G.adjacentEdges(t) do
+ * 10               if edge e is already labelled
+ * 11                   continue with the next edge
+ * 12               w <- G.adjacentVertex(t,e)
+ * 13               if vertex w is not discovered and not explored
+ * 14                   label e as tree-edge
+ * 15                   label w as discovered
+ * 16                   S.push(w)
+ * 17                   continue at 5
+ * 18               else if vertex w is discovered
+ * 19                   label e as back-edge
+ * 20               else
+ * 21                   // vertex w is explored
+ * 22                   label e as forward- or cross-edge
+ * 23           label t as explored
+ * 24           S.pop()
+ *
+ * convention:
+ * 0x10 - discovered
+ * 0x11 - discovered and fall-through edge labelled
+ * 0x12 - discovered and fall-through and branch edges labelled
+ * 0x20 - explored
+ */
+
+enum {
+	DISCOVERED = 0x10,
+	EXPLORED = 0x20,
+	FALLTHROUGH = 1,
+	BRANCH = 2,
+};
+
+/* t, w, e - match pseudo-code above:
+ * t - index of current instruction
+ * w - next instruction
+ * e - edge
+ */
+static int push_insn(struct verifier_env *env, int t, int w, int e)
+{
+	if (e == FALLTHROUGH && env->insn_state[t] >= (DISCOVERED | FALLTHROUGH))
+		return 0;
+
+	if (e == BRANCH && env->insn_state[t] >= (DISCOVERED | BRANCH))
+		return 0;
+
+	if (w < 0 || w >= env->prog->len) {
+		verbose(env, "jump out of range from insn %d to %d\n", t, w);
+		return -EINVAL;
+	}
+
+	if (e == BRANCH)
+		/* mark branch target for state pruning */
+		env->explored_states[w] = STATE_LIST_MARK;
+
+	if (env->insn_state[w] == 0) {
+		/* tree-edge */
+		env->insn_state[t] = DISCOVERED | e;
+		env->insn_state[w] = DISCOVERED;
+		if (env->cur_stack >= env->prog->len)
+			return -E2BIG;
+		env->insn_stack[env->cur_stack++] = w;
+		return 1;
+	} else if ((env->insn_state[w] & 0xF0) == DISCOVERED) {
+		verbose(env, "back-edge from insn %d to %d\n", t, w);
+		return -EINVAL;
+	} else if (env->insn_state[w] == EXPLORED) {
+		/* forward- or cross-edge */
+		env->insn_state[t] = DISCOVERED | e;
+	} else {
+		verbose(env, "insn state internal bug\n");
+		return -EFAULT;
+	}
+	return 0;
+}
+
+/* non-recursive depth-first-search to detect loops in BPF program
+ * loop == back-edge in directed graph
+ */
+static int check_cfg(struct verifier_env *env)
+{
+	struct bpf_insn *insns = env->prog->insnsi;
+	int insn_cnt = env->prog->len;
+	int ret = 0;
+	int i, t;
+
+	env->insn_state = kcalloc(insn_cnt, sizeof(int), GFP_KERNEL);
+	if (!env->insn_state)
+		return -ENOMEM;
+
+	env->insn_stack = kcalloc(insn_cnt, sizeof(int), GFP_KERNEL);
+	if (!env->insn_stack) {
+		kfree(env->insn_state);
+		return -ENOMEM;
+	}
+
+	env->insn_state[0] = DISCOVERED; /* mark 1st insn as discovered */
+	env->insn_stack[0] = 0; /* 0 is the first instruction */
+	env->cur_stack = 1;
+
+peek_stack:
+	if (env->cur_stack == 0)
+		goto check_state;
+	t = env->insn_stack[env->cur_stack - 1];
+
+	if (BPF_CLASS(insns[t].code) == BPF_JMP) {
+		u8 opcode = BPF_OP(insns[t].code);
+
+		if (opcode == BPF_EXIT) {
+			goto mark_explored;
+		} else if (opcode == BPF_CALL) {
+			ret = push_insn(env, t, t + 1, FALLTHROUGH);
+			if (ret == 1)
+				goto peek_stack;
+			else if (ret < 0)
+				goto err_free;
+		} else if (opcode == BPF_JA) {
+			if (BPF_SRC(insns[t].code) != BPF_K) {
+				ret = -EINVAL;
+				goto err_free;
+			}
+			/* unconditional jump with single edge */
+			ret = push_insn(env, t, t + insns[t].off + 1,
+					FALLTHROUGH);
+			if (ret == 1)
+				goto peek_stack;
+			else if (ret < 0)
+				goto err_free;
+			/* tell verifier to check for equivalent states
+			 * after every call and jump
+			 */
+			if (t + 1 < insn_cnt)
+				env->explored_states[t + 1] = STATE_LIST_MARK;
+		} else {
+			/* conditional jump with two edges */
+			ret = push_insn(env, t, t + 1, FALLTHROUGH);
+			if (ret == 1)
+				goto peek_stack;
+			else if (ret < 0)
+				goto err_free;
+
+			ret = push_insn(env, t, t + insns[t].off + 1, BRANCH);
+			if (ret == 1)
+				goto peek_stack;
+			else if (ret < 0)
+				goto err_free;
+		}
+	} else {
+		/* all other non-branch instructions with single
+		 * fall-through edge, BPF_LD_IMM64 takes two slots
+		 */
+		int next = t + 1;
+
+		if (insns[t].code == (BPF_LD | BPF_IMM | BPF_DW))
+			next++;
+		ret = push_insn(env, t, next, FALLTHROUGH);
+		if (ret == 1)
+			goto peek_stack;
+		else if (ret < 0)
+			goto err_free;
+	}
+
+mark_explored:
+	env->insn_state[t] = EXPLORED;
+	if (env->cur_stack-- <= 0) {
+		verbose(env, "pop stack internal bug\n");
+		ret = -EFAULT;
+		goto err_free;
+	}
+	goto peek_stack;
+
+check_state:
+	for (i = 0; i < insn_cnt; i++) {
+		if (env->insn_state[i] != EXPLORED) {
+			/* the second half of BPF_LD_IMM64 is never visited */
+			if (i > 0 && insns[i - 1].code == (BPF_LD | BPF_IMM | BPF_DW) &&
+			    env->insn_state[i - 1] == EXPLORED && env->insn_state[i] == 0)
+				continue;
+			verbose(env, "unreachable insn %d\n", i);
+			ret = -EINVAL;
+			goto err_free;
+		}
+	}
+	ret = 0; /* cfg looks good */
+
+err_free:
+	kfree(env->insn_state);
+	kfree(env->insn_stack);
+	return ret;
+}
+
+/* compare two verifier states
+ *
+ * all states stored in state_list are known to be valid, since
+ * verifier reached 'bpf_exit' instruction through them
+ *
+ * this function is called when verifier exploring different branches of
+ * execution popped from the state stack. If it sees an old state that has
+ * more strict register state and more strict stack state then this execution
+ * branch doesn't need to be explored further, since verifier already
+ * concluded that more strict state leads to valid finish.
+ *
+ * Therefore two states are equivalent if register state is more conservative
+ * and explored stack state is more conservative than the current one.
+ * Example:
+ *       explored                   current
+ * (slot1=INV slot2=MISC) == (slot1=MISC slot2=MISC)
+ * (slot1=MISC slot2=MISC) != (slot1=INV slot2=MISC)
+ *
+ * In other words if current stack state (one being explored) has more
+ * valid slots than old one that already passed validation, it means
+ * the verifier can stop exploring and conclude that current state is valid too
+ */
+static bool states_equal(struct verifier_state *old, struct verifier_state *cur)
+{
+	int i;
+
+	for (i = 0; i < MAX_BPF_REG; i++) {
+		if (memcmp(&old->regs[i], &cur->regs[i],
+			   sizeof(old->regs[0])) != 0) {
+			if (old->regs[i].type == NOT_INIT ||
+			    (old->regs[i].type == UNKNOWN_VALUE &&
+			     cur->regs[i].type != NOT_INIT))
+				continue;
+			return false;
+		}
+	}
+
+	for (i = 0; i < MAX_BPF_STACK; i++) {
+		if (old->stack_slot_type[i] == STACK_INVALID)
+			continue;
+		if (old->stack_slot_type[i] != cur->stack_slot_type[i])
+			/* Ex: old explored (safe) state has STACK_SPILL in
+			 * this stack slot, but current has has STACK_MISC ->
+			 * this verifier states are not equivalent,
+			 * return false to continue verification of this path
+			 */
+			return false;
+		if (i % BPF_REG_SIZE)
+			continue;
+		if (memcmp(&old->spilled_regs[i / BPF_REG_SIZE],
+			   &cur->spilled_regs[i / BPF_REG_SIZE],
+			   sizeof(old->spilled_regs[0])))
+			/* when explored and current stack slot types are
+			 * the same, check that stored pointers types
+			 * are the same as well.
+			 */
+			return false;
+	}
+	return true;
+}
+
+static int is_state_visited(struct verifier_env *env, int insn_idx)
+{
+	struct verifier_state_list *new_sl;
+	struct verifier_state_list *sl;
+
+	sl = env->explored_states[insn_idx];
+	if (!sl)
+		/* this 'insn_idx' instruction wasn't marked, so we will not
+		 * be doing state search here
+		 */
+		return 0;
+
+	while (sl != STATE_LIST_MARK) {
+		if (states_equal(&sl->state, &env->cur_state))
+			/* reached equivalent register/stack state,
+			 * prune the search
+			 */
+			return 1;
+		sl = sl->next;
+	}
+
+	/* there were no equivalent states, remember current one.
+	 * technically the current state is not proven to be safe yet,
+	 * but it will either reach bpf_exit (which means it's safe) or
+	 * it will be rejected. Since there are no loops, we won't be
+	 * seeing this 'insn_idx' instruction again on the way to bpf_exit
+	 */
+	new_sl = kmalloc(sizeof(struct verifier_state_list), GFP_USER);
+	if (!new_sl)
+		return -ENOMEM;
+
+	/* add new state to the head of linked list */
+	memcpy(&new_sl->state, &env->cur_state, sizeof(env->cur_state));
+	new_sl->next = env->explored_states[insn_idx];
+	env->explored_states[insn_idx] = new_sl;
+	return 0;
+}
+
+static int do_check(struct verifier_env *env)
+{
+	struct verifier_state *state = &env->cur_state;
+	struct bpf_insn *insns = env->prog->insnsi;
+	struct reg_state *regs = state->regs;
+	int insn_cnt = env->prog->len;
+	int insn_idx;
+	int insn_processed = 0;
+	int err;
+
+	init_reg_state(regs);
+	insn_idx = 0;
+	for (;;) {
+		struct bpf_insn *insn;
+		u8 class;
+
+		if (insn_idx >= insn_cnt) {
+			verbose(env, "invalid insn idx %d insn_cnt %d\n",
+				insn_idx, insn_cnt);
+			return -EFAULT;
+		}
+
+		insn = &insns[insn_idx];
+		class = BPF_CLASS(insn->code);
+
+		if (++insn_processed > BPF_COMPLEXITY_LIMIT_INSNS) {
+			verbose(env, "BPF program is too large. Proccessed %d insn\n",
+				insn_processed);
+			return -E2BIG;
+		}
+
+		err = is_state_visited(env, insn_idx);
+		if (err < 0)
+			return err;
+		if (err == 1) {
+			/* found equivalent state, can prune the search */
+			goto process_bpf_exit;
+		}
+
+		if (class == BPF_ALU || class == BPF_ALU64) {
+			err = check_alu_op(env, insn);
+			if (err)
+				return err;
+
+		} else if (class == BPF_LDX) {
+			if (BPF_MODE(insn->code) != BPF_MEM ||
+			    insn->imm != 0) {
+				verbose(env, "BPF_LDX uses reserved fields\n");
+				return -EINVAL;
+			}
+			/* check src operand */
+			err = check_reg_arg(env, insn->src_reg, SRC_OP);
+			if (err)
+				return err;
+
+			err = check_reg_arg(env, insn->dst_reg, DST_OP_NO_MARK);
+			if (err)
+				return err;
+
+			/* check that memory (src_reg + off) is readable,
+			 * the state of dst_reg will be updated by this func
+			 */
+			err = check_mem_access(env, insn_idx, insn->src_reg,
+					       insn->off, BPF_SIZE(insn->code),
+					       BPF_READ, insn->dst_reg);
+			if (err)
+				return err;
+
+		} else if (class == BPF_STX) {
+			if (BPF_MODE(insn->code) == BPF_XADD) {
+				err = check_xadd(env, insn_idx, insn);
+				if (err)
+					return err;
+				insn_idx++;
+				continue;
+			}
+
+			if (BPF_MODE(insn->code) != BPF_MEM ||
+			    insn->imm != 0) {
+				verbose(env, "BPF_STX uses reserved fields\n");
+				return -EINVAL;
+			}
+			/* check src1 operand */
+			err = check_reg_arg(env, insn->src_reg, SRC_OP);
+			if (err)
+				return err;
+			/* check src2 operand */
+			err = check_reg_arg(env, insn->dst_reg, SRC_OP);
+			if (err)
+				return err;
+
+			/* check that memory (dst_reg + off) is writeable */
+			err = check_mem_access(env, insn_idx, insn->dst_reg,
+					       insn->off, BPF_SIZE(insn->code),
+					       BPF_WRITE, insn->src_reg);
+			if (err)
+				return err;
+
+		} else if (class == BPF_ST) {
+			if (BPF_MODE(insn->code) != BPF_MEM ||
+			    insn->src_reg != BPF_REG_0) {
+				verbose(env, "BPF_ST uses reserved fields\n");
+				return -EINVAL;
+			}
+			/* check src operand */
+			err = check_reg_arg(env, insn->dst_reg, SRC_OP);
+			if (err)
+				return err;
+
+			/* check that memory (dst_reg + off) is writeable */
+			err = check_mem_access(env, insn_idx, insn->dst_reg,
+					       insn->off, BPF_SIZE(insn->code),
+					       BPF_WRITE, -1);
+			if (err)
+				return err;
+
+		} else if (class == BPF_JMP) {
+			u8 opcode = BPF_OP(insn->code);
+
+			if (opcode == BPF_CALL) {
+				if (BPF_SRC(insn->code) != BPF_K ||
+				    insn->off != 0 ||
+				    insn->src_reg != BPF_REG_0 ||
+				    insn->dst_reg != BPF_REG_0) {
+					verbose(env, "BPF_CALL uses reserved fields\n");
+					return -EINVAL;
+				}
+
+				err = check_call(env, insn->imm);
+				if (err)
+					return err;
+
+			} else if (opcode == BPF_JA) {
+				if (BPF_SRC(insn->code) != BPF_K ||
+				    insn->imm != 0 ||
+				    insn->src_reg != BPF_REG_0 ||
+				    insn->dst_reg != BPF_REG_0) {
+					verbose(env, "BPF_JA uses reserved fields\n");
+					return -EINVAL;
+				}
+
+				insn_idx += insn->off + 1;
+				continue;
+
+			} else if (opcode == BPF_EXIT) {
+				if (BPF_SRC(insn->code) != BPF_K ||
+				    insn->imm != 0 ||
+				    insn->src_reg != BPF_REG_0 ||
+				    insn->dst_reg != BPF_REG_0) {
+					verbose(env, "BPF_EXIT uses reserved fields\n");
+					return -EINVAL;
+				}
+
+				/* eBPF calling convention is such that R0 is used
+				 * to return the value from eBPF program.
+				 * Make sure that it's readable at this time
+				 * of bpf_exit, which means that program wrote
+				 * something into it earlier
+				 */
+				err = check_reg_arg(env, BPF_REG_0, SRC_OP);
+				if (err)
+					return err;
+
+process_bpf_exit:
+				insn_idx = pop_stack(env);
+				if (insn_idx < 0) {
+					break;
+				} else {
+					continue;
+				}
+			} else {
+				err = check_cond_jmp_op(env, insn, &insn_idx);
+				if (err)
+					return err;
+			}
+		} else if (class == BPF_LD) {
+			u8 mode = BPF_MODE(insn->code);
+
+			if (mode == BPF_ABS || mode == BPF_IND) {
+				err = check_ld_abs(env, insn);
+				if (err)
+					return err;
+
+			} else if (mode == BPF_IMM && BPF_SIZE(insn->code) == BPF_DW) {
+				err = check_ld_imm(env, insn);
+				if (err)
+					return err;
+
+				insn_idx++;
+			} else {
+				verbose(env, "invalid BPF_LD mode\n");
+				return -EINVAL;
+			}
+		} else {
+			verbose(env, "unknown insn class %d\n", class);
+			return -EINVAL;
+		}
+
+		insn_idx++;
+	}
+	return 0;
+}
+
+/* look for pseudo eBPF instructions that access map FDs and
+ * replace them with actual map pointers
+ */
+static int replace_map_fd_with_map_ptr(struct verifier_env *env)
+{
+	struct bpf_insn *insn = env->prog->insnsi;
+	int insn_cnt = env->prog->len;
+	int i, j;
+
+	for (i = 0; i < insn_cnt; i++, insn++) {
+		struct bpf_map *map;
+		u64 addr;
+
+		if (insn[0].code != (BPF_LD | BPF_IMM | BPF_DW))
+			continue;
+
+		if (i == insn_cnt - 1 || insn[1].code != 0 ||
+		    insn[1].dst_reg != 0 || insn[1].src_reg != 0 ||
+		    insn[1].off != 0) {
+			verbose(env, "invalid bpf_ld_imm64 insn\n");
+			return -EINVAL;
+		}
+
+		if (insn->src_reg == 0) {
+			/* valid generic load 64-bit imm */
+			goto next_insn;
+		}
+
+		if (insn->src_reg != BPF_PSEUDO_MAP_FD) {
+			verbose(env, "unrecognized bpf_ld_imm64 insn\n");
+			return -EINVAL;
+		}
+
+		map = bpf_map_get(insn->imm);
+		if (IS_ERR(map)) {
+			verbose(env, "fd %d is not pointing to valid bpf_map\n",
+				insn->imm);
+			return PTR_ERR(map);
+		}
+
+		/* store map pointer inside BPF_LD_IMM64 instruction */
+		addr = (unsigned long) map;
+		insn[0].imm = (u32) addr;
+		insn[1].imm = addr >> 32;
+
+		/* check whether we recorded this map already */
+		for (j = 0; j < env->used_map_cnt; j++)
+			if (env->used_maps[j] == map) {
+				bpf_map_put(map);
+				goto next_insn;
+			}
+
+		if (env->used_map_cnt >= MAX_USED_MAPS) {
+			bpf_map_put(map);
+			return -E2BIG;
+		}
+
+		/* remember this map, the reference taken above is
+		 * dropped when the program is freed
+		 */
+		env->used_maps[env->used_map_cnt++] = map;
+next_insn:
+		insn++;
+		i++;
+	}
+
+	/* now all pseudo BPF_LD_IMM64 instructions load valid
+	 * 'struct bpf_map *' into a register instead of user map_fd.
+	 * These pointers will be used later by verifier to validate map access.
+	 */
+	return 0;
+}
+
+/* drop refcnt of maps used by the rejected program */
+static void release_maps(struct verifier_env *env)
+{
+	int i;
+
+	for (i = 0; i < env->used_map_cnt; i++)
+		bpf_map_put(env->used_maps[i]);
+}
+
+/* the program is safe, rewrite it for execution:
+ * - map loads become plain 64-bit immediate loads,
+ * - context loads are converted by the program type,
+ * - helper ids become offsets from __bpf_call_base
+ */
+static int fixup_bpf_insns(struct verifier_env *env)
+{
+	struct bpf_prog *prog = env->prog;
+	struct bpf_insn *insn = prog->insnsi;
+	const struct bpf_func_proto *fn;
+	int i;
+
+	for (i = 0; i < prog->len; i++, insn++) {
+		if (insn->code == (BPF_LD | BPF_IMM | BPF_DW)) {
+			insn->src_reg = 0;
+			insn++;
+			i++;
+			continue;
+		}
+
+		if (env->mem_access[i] == MEM_ACCESS_CTX) {
+			int ctx_off = insn->off;
+
+			if (BPF_CLASS(insn->code) != BPF_LDX ||
+			    !prog->ops->convert_ctx_access) {
+				verbose(env, "bpf_context access cannot be converted\n");
+				return -EINVAL;
+			}
+			prog->ops->convert_ctx_access(insn, ctx_off);
+			continue;
+		}
+
+		if (insn->code == (BPF_JMP | BPF_CALL)) {
+			fn = prog->ops->get_func_proto(insn->imm);
+			insn->imm = fn->func - __bpf_call_base;
+		}
+	}
+	return 0;
+}
+
+/**
+ *	bpf_check - verify an eBPF program
+ *	@prog: program to check, with insnsi, len and ops set
+ *	@attr: BPF_PROG_LOAD attributes, for the verifier log
+ *
+ *	Returns 0 if the program is safe to run, after rewriting it for
+ *	execution and taking references on the maps it uses, or a
+ *	negative errno with an explanation in the user's log buffer.
+ */
+int bpf_check(struct bpf_prog *prog, union bpf_attr *attr)
+{
+	char __user *log_ubuf = NULL;
+	struct verifier_env *env;
+	int ret = -EINVAL, i;
+
+	if (prog->len <= 0 || prog->len > BPF_MAXINSNS)
+		return -E2BIG;
+
+	/* 'struct verifier_env' can be global, but since it's not small,
+	 * allocate/free it every time bpf_check() is called
+	 */
+	env = kzalloc(sizeof(struct verifier_env), GFP_KERNEL);
+	if (!env)
+		return -ENOMEM;
+
+	env->prog = prog;
+
+	if (attr->log_level) {
+		log_ubuf = (char __user *) (unsigned long) attr->log_buf;
+		env->log_size = attr->log_size;
+
+		/* log_* values have to be sane */
+		if (env->log_size < 128 || env->log_size > UINT_MAX >> 8 ||
+		    !log_ubuf)
+			goto free_env;
+
+		ret = -ENOMEM;
+		env->log_buf = vmalloc(env->log_size);
+		if (!env->log_buf)
+			goto free_env;
+		env->log_buf[0] = 0;
+	}
+
+	ret = -ENOMEM;
+	env->explored_states = kcalloc(prog->len,
+				       sizeof(struct verifier_state_list *),
+				       GFP_USER);
+	env->mem_access = kzalloc(prog->len, GFP_USER);
+	if (!env->explored_states || !env->mem_access)
+		goto free_log_buf;
+
+	ret = replace_map_fd_with_map_ptr(env);
+	if (ret < 0)
+		goto skip_full_check;
+
+	ret = check_cfg(env);
+	if (ret < 0)
+		goto skip_full_check;
+
+	ret = do_check(env);
+	free_stack(env);
+	if (ret == 0)
+		ret = fixup_bpf_insns(env);
+
+skip_full_check:
+	if (env->log_buf) {
+		if (env->log_len >= env->log_size - 1 && ret == 0)
+			/* verification passed, but the log is truncated */
+			ret = -ENOSPC;
+		if (copy_to_user(log_ubuf, env->log_buf, env->log_len + 1) != 0)
+			ret = -EFAULT;
+	}
+
+	if (ret == 0 && env->used_map_cnt) {
+		/* program holds references on the maps until it's freed */
+		prog->used_maps = kmemdup(env->used_maps,
+					  sizeof(env->used_maps[0]) *
+					  env->used_map_cnt, GFP_KERNEL);
+		if (!prog->used_maps)
+			ret = -ENOMEM;
+		else
+			prog->used_map_cnt = env->used_map_cnt;
+	}
+
+	if (ret < 0)
+		release_maps(env);
+
+	for (i = 0; i < prog->len; i++) {
+		struct verifier_state_list *sl, *sln;
+
+		sl = env->explored_states[i];
+		if (sl)
+			while (sl != STATE_LIST_MARK) {
+				sln = sl->next;
+				kfree(sl);
+				sl = sln;
+			}
+	}
+
+free_log_buf:
+	vfree(env->log_buf);
+	kfree(env->explored_states);
+	kfree(env->mem_access);
+free_env:
+	kfree(env);
+	return ret;
+}
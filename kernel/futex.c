@@ -60,6 +60,9 @@
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
 #include <linux/ptrace.h>
+#include <linux/bootmem.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -67,7 +70,14 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/*
+ * Give new processes their own hash table for PROCESS_PRIVATE futexes,
+ * see futex_mm_init().
+ */
+int __read_mostly futex_private_hash;
+
+/* Smallest private hash table, grown with the thread count. */
+#define FUTEX_PRIVATE_HASHSIZE	16
 
 /*
  * Futex flags used to encode options to functions and preserve them across
@@ -145,20 +155,296 @@ static const struct futex_q futex_q_init = {
  */
 struct futex_hash_bucket {
 	spinlock_t lock;
+	int dead;
 	struct plist_head chain;
+} ____cacheline_aligned_in_smp;
+
+/*
+ * The global hash is sized by the number of possible CPUs at boot, see
+ * futex_init().
+ */
+static struct futex_hash_bucket *futex_queues;
+static unsigned long __read_mostly futex_hashsize;
+
+/*
+ * A process-private hash table for PROCESS_PRIVATE futexes, hung off the
+ * mm so that unrelated processes never contend on the same bucket.  It
+ * is replaced by a larger table as threads are added; the buckets of
+ * the old table are marked dead while their waiters are moved, and the
+ * old table is freed after an RCU grace period.
+ */
+struct futex_hash {
+	unsigned long mask;
+	struct futex_hash_bucket buckets[0];
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/* Serializes private hash resizing, waited on when a dead bucket is hit. */
+static DEFINE_MUTEX(futex_hash_mutex);
+
+static inline int futex_key_private(union futex_key *key)
+{
+	return !(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED));
+}
+
+static inline u32 futex_hash_val(union futex_key *key)
+{
+	return jhash2((u32*)&key->both.word,
+		      (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
+		      key->both.offset);
+}
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
+ *
+ * Must be called under rcu_read_lock() so that a private table cannot
+ * be freed under us, and the bucket must be checked for ->dead once
+ * locked; see futex_hash_lock().
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
-	u32 hash = jhash2((u32*)&key->both.word,
-			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
-			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+	u32 hash = futex_hash_val(key);
+
+	if (futex_key_private(key)) {
+		struct futex_hash *fh = rcu_dereference(key->private.mm->futex_hash);
+
+		if (fh)
+			return &fh->buckets[hash & fh->mask];
+	}
+	return &futex_queues[hash & (futex_hashsize - 1)];
+}
+
+/*
+ * Wait for a concurrent resize of a private hash table to complete.
+ */
+static void futex_hash_wait_resize(void)
+{
+	mutex_lock(&futex_hash_mutex);
+	mutex_unlock(&futex_hash_mutex);
+}
+
+/*
+ * Express the locking dependencies for lockdep:
+ */
+static inline void
+double_lock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
+{
+	if (hb1 <= hb2) {
+		spin_lock(&hb1->lock);
+		if (hb1 < hb2)
+			spin_lock_nested(&hb2->lock, SINGLE_DEPTH_NESTING);
+	} else { /* hb1 > hb2 */
+		spin_lock(&hb2->lock);
+		spin_lock_nested(&hb1->lock, SINGLE_DEPTH_NESTING);
+	}
+}
+
+static inline void
+double_unlock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
+{
+	spin_unlock(&hb1->lock);
+	if (hb1 != hb2)
+		spin_unlock(&hb2->lock);
+}
+
+/*
+ * Look up and lock the hash bucket for @key.  Once the lock is held
+ * and the bucket is not dead, the bucket (and its table) stays valid
+ * until the lock is dropped.
+ */
+static struct futex_hash_bucket *futex_hash_lock(union futex_key *key)
+{
+	struct futex_hash_bucket *hb;
+
+	for (;;) {
+		rcu_read_lock();
+		hb = hash_futex(key);
+		spin_lock(&hb->lock);
+		if (likely(!hb->dead)) {
+			rcu_read_unlock();
+			return hb;
+		}
+		spin_unlock(&hb->lock);
+		rcu_read_unlock();
+		futex_hash_wait_resize();
+	}
+}
+
+/*
+ * Look up and lock the hash buckets for two keys, as futex_hash_lock().
+ */
+static void futex_hash_lock2(union futex_key *key1, union futex_key *key2,
+			     struct futex_hash_bucket **hb1,
+			     struct futex_hash_bucket **hb2)
+{
+	for (;;) {
+		rcu_read_lock();
+		*hb1 = hash_futex(key1);
+		*hb2 = hash_futex(key2);
+		double_lock_hb(*hb1, *hb2);
+		if (likely(!(*hb1)->dead && !(*hb2)->dead)) {
+			rcu_read_unlock();
+			return;
+		}
+		double_unlock_hb(*hb1, *hb2);
+		rcu_read_unlock();
+		futex_hash_wait_resize();
+	}
+}
+
+/*
+ * Lock the hash bucket a queued futex_q currently sits on.  Returns the
+ * lock taken, or NULL if the futex_q has already been woken.
+ *
+ * q->lock_ptr can change between reading it and spin_lock(), causing us
+ * to take the wrong lock, either because of a requeue or because the
+ * private hash was resized.  This corrects the race condition.
+ *
+ * Reasoning goes like this: if we have the wrong lock, q->lock_ptr must
+ * have changed (maybe several times) between reading it and the
+ * spin_lock().  It can change again after the spin_lock() but only if
+ * it was already changed before the spin_lock().  It cannot, however,
+ * change back to the original value.  Therefore we can detect whether
+ * we acquired the correct lock.  RCU keeps a lock in a replaced private
+ * table valid until we notice.
+ */
+static spinlock_t *futex_q_lock(struct futex_q *q)
+{
+	spinlock_t *lock_ptr;
+
+	rcu_read_lock();
+retry:
+	lock_ptr = q->lock_ptr;
+	barrier();
+	if (lock_ptr != NULL) {
+		spin_lock(lock_ptr);
+		if (unlikely(lock_ptr != q->lock_ptr)) {
+			spin_unlock(lock_ptr);
+			goto retry;
+		}
+	}
+	rcu_read_unlock();
+	return lock_ptr;
+}
+
+static struct futex_hash *futex_hash_alloc(unsigned long size)
+{
+	size_t bytes = sizeof(struct futex_hash) +
+		       size * sizeof(struct futex_hash_bucket);
+	struct futex_hash *fh;
+	unsigned long i;
+
+	if (bytes <= PAGE_SIZE)
+		fh = kzalloc(bytes, GFP_KERNEL | __GFP_NOWARN);
+	else
+		fh = vzalloc(bytes);
+	if (!fh)
+		return NULL;
+
+	fh->mask = size - 1;
+	for (i = 0; i < size; i++) {
+		plist_head_init(&fh->buckets[i].chain);
+		spin_lock_init(&fh->buckets[i].lock);
+	}
+	return fh;
+}
+
+static void futex_hash_free(struct futex_hash *fh)
+{
+	if (is_vmalloc_addr(fh))
+		vfree(fh);
+	else
+		kfree(fh);
+}
+
+/*
+ * Move all waiters of @mm's private hash into a table of @size buckets.
+ */
+static void futex_private_hash_resize(struct mm_struct *mm, unsigned long size)
+{
+	struct futex_hash *old, *new;
+	unsigned long i;
+
+	mutex_lock(&futex_hash_mutex);
+	old = rcu_dereference_protected(mm->futex_hash,
+					lockdep_is_held(&futex_hash_mutex));
+	if (!old || old->mask + 1 >= size)
+		goto out_unlock;
+
+	new = futex_hash_alloc(size);
+	if (!new)
+		goto out_unlock;
+
+	for (i = 0; i <= old->mask; i++) {
+		struct futex_hash_bucket *hb = &old->buckets[i], *nhb;
+		struct futex_q *this, *next;
+
+		spin_lock(&hb->lock);
+		plist_for_each_entry_safe(this, next, &hb->chain, list) {
+			nhb = &new->buckets[futex_hash_val(&this->key) & new->mask];
+			spin_lock_nested(&nhb->lock, SINGLE_DEPTH_NESTING);
+			plist_del(&this->list, &hb->chain);
+			plist_add(&this->list, &nhb->chain);
+			this->lock_ptr = &nhb->lock;
+			spin_unlock(&nhb->lock);
+		}
+		hb->dead = 1;
+		spin_unlock(&hb->lock);
+	}
+	rcu_assign_pointer(mm->futex_hash, new);
+	mutex_unlock(&futex_hash_mutex);
+
+	synchronize_rcu();
+	futex_hash_free(old);
+	return;
+
+out_unlock:
+	mutex_unlock(&futex_hash_mutex);
+}
+
+/*
+ * Grow the private hash once the process has more than half as many
+ * threads as it has buckets.  No bigger than the global hash.
+ */
+static void futex_private_hash_grow(struct mm_struct *mm)
+{
+	unsigned long size, threads = get_nr_threads(current);
+	struct futex_hash *fh;
+
+	rcu_read_lock();
+	fh = rcu_dereference(mm->futex_hash);
+	size = fh ? fh->mask + 1 : 0;
+	rcu_read_unlock();
+
+	if (likely(!size || size >= 2 * threads || size >= futex_hashsize))
+		return;
+
+	size = min_t(unsigned long, roundup_pow_of_two(4 * threads),
+		     futex_hashsize);
+	futex_private_hash_resize(mm, size);
+}
+
+/*
+ * Called for every new mm.  The private hash has to exist before the
+ * first PROCESS_PRIVATE futex is queued, as waiters are never moved
+ * out of the global hash.
+ */
+void futex_mm_init(struct mm_struct *mm)
+{
+	RCU_INIT_POINTER(mm->futex_hash, NULL);
+	if (futex_private_hash)
+		RCU_INIT_POINTER(mm->futex_hash,
+				 futex_hash_alloc(min_t(unsigned long,
+							FUTEX_PRIVATE_HASHSIZE,
+							futex_hashsize)));
+}
+
+/* Called when the last reference to the mm is dropped. */
+void futex_mm_free(struct mm_struct *mm)
+{
+	struct futex_hash *fh = rcu_dereference_protected(mm->futex_hash, 1);
+
+	if (fh)
+		futex_hash_free(fh);
 }
 
 /*
@@ -260,6 +546,7 @@ get_futex_key(u32 __user *uaddr, int fshared, union futex_key *key, int rw)
 		key->private.mm = mm;
 		key->private.address = address;
 		get_futex_key_refs(key);
+		futex_private_hash_grow(mm);
 		return 0;
 	}
 
@@ -557,10 +844,9 @@ void exit_pi_state_list(struct task_struct *curr)
 		next = head->next;
 		pi_state = list_entry(next, struct futex_pi_state, list);
 		key = pi_state->key;
-		hb = hash_futex(&key);
 		raw_spin_unlock_irq(&curr->pi_lock);
 
-		spin_lock(&hb->lock);
+		hb = futex_hash_lock(&key);
 
 		raw_spin_lock_irq(&curr->pi_lock);
 		/*
@@ -943,30 +1229,6 @@ static int unlock_futex_pi(u32 __user *uaddr, u32 uval)
 	return 0;
 }
 
-/*
- * Express the locking dependencies for lockdep:
- */
-static inline void
-double_lock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
-{
-	if (hb1 <= hb2) {
-		spin_lock(&hb1->lock);
-		if (hb1 < hb2)
-			spin_lock_nested(&hb2->lock, SINGLE_DEPTH_NESTING);
-	} else { /* hb1 > hb2 */
-		spin_lock(&hb2->lock);
-		spin_lock_nested(&hb1->lock, SINGLE_DEPTH_NESTING);
-	}
-}
-
-static inline void
-double_unlock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
-{
-	spin_unlock(&hb1->lock);
-	if (hb1 != hb2)
-		spin_unlock(&hb2->lock);
-}
-
 /*
  * Wake up waiters matching bitset queued on this futex (uaddr).
  */
@@ -986,8 +1248,7 @@ futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 	if (unlikely(ret != 0))
 		goto out;
 
-	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	hb = futex_hash_lock(&key);
 	head = &hb->chain;
 
 	plist_for_each_entry_safe(this, next, head, list) {
@@ -1035,11 +1296,8 @@ retry:
 	if (unlikely(ret != 0))
 		goto out_put_key1;
 
-	hb1 = hash_futex(&key1);
-	hb2 = hash_futex(&key2);
-
 retry_private:
-	double_lock_hb(hb1, hb2);
+	futex_hash_lock2(&key1, &key2, &hb1, &hb2);
 	op_ret = futex_atomic_op_inuser(op, uaddr2);
 	if (unlikely(op_ret < 0)) {
 
@@ -1293,11 +1551,8 @@ retry:
 	if (unlikely(ret != 0))
 		goto out_put_key1;
 
-	hb1 = hash_futex(&key1);
-	hb2 = hash_futex(&key2);
-
 retry_private:
-	double_lock_hb(hb1, hb2);
+	futex_hash_lock2(&key1, &key2, &hb1, &hb2);
 
 	if (likely(cmpval != NULL)) {
 		u32 curval;
@@ -1462,10 +1717,8 @@ static inline struct futex_hash_bucket *queue_lock(struct futex_q *q)
 {
 	struct futex_hash_bucket *hb;
 
-	hb = hash_futex(&q->key);
+	hb = futex_hash_lock(&q->key);
 	q->lock_ptr = &hb->lock;
-
-	spin_lock(&hb->lock);
 	return hb;
 }
 
@@ -1526,28 +1779,8 @@ static int unqueue_me(struct futex_q *q)
 	int ret = 0;
 
 	/* In the common case we don't take the spinlock, which is nice. */
-retry:
-	lock_ptr = q->lock_ptr;
-	barrier();
+	lock_ptr = futex_q_lock(q);
 	if (lock_ptr != NULL) {
-		spin_lock(lock_ptr);
-		/*
-		 * q->lock_ptr can change between reading it and
-		 * spin_lock(), causing us to take the wrong lock.  This
-		 * corrects the race condition.
-		 *
-		 * Reasoning goes like this: if we have the wrong lock,
-		 * q->lock_ptr must have changed (maybe several times)
-		 * between reading it and the spin_lock().  It can
-		 * change again after the spin_lock() but only if it was
-		 * already changed before the spin_lock().  It cannot,
-		 * however, change back to the original value.  Therefore
-		 * we can detect whether we acquired the correct lock.
-		 */
-		if (unlikely(lock_ptr != q->lock_ptr)) {
-			spin_unlock(lock_ptr);
-			goto retry;
-		}
 		__unqueue_futex(q);
 
 		BUG_ON(q->pi_state);
@@ -1661,7 +1894,7 @@ handle_fault:
 
 	ret = fault_in_user_writeable(uaddr);
 
-	spin_lock(q->lock_ptr);
+	futex_q_lock(q);
 
 	/*
 	 * Check if someone else fixed it for us:
@@ -2031,7 +2264,7 @@ retry_private:
 		ret = ret ? 0 : -EWOULDBLOCK;
 	}
 
-	spin_lock(q.lock_ptr);
+	futex_q_lock(&q);
 	/*
 	 * Fixup the pi_state owner and possibly acquire the lock if we
 	 * haven't already.
@@ -2107,8 +2340,7 @@ retry:
 	if (unlikely(ret != 0))
 		goto out;
 
-	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	hb = futex_hash_lock(&key);
 
 	/*
 	 * To avoid races, try to do the TID -> 0 atomic transition
@@ -2173,7 +2405,6 @@ pi_faulted:
 
 /**
  * handle_early_requeue_pi_wakeup() - Detect early wakeup on the initial futex
- * @hb:		the hash_bucket futex_q was original enqueued on
  * @q:		the futex_q woken while waiting to be requeued
  * @key2:	the futex_key of the requeue target futex
  * @timeout:	the timeout associated with the wait (NULL if none)
@@ -2181,15 +2412,14 @@ pi_faulted:
  * Detect if the task was woken on the initial futex as opposed to the requeue
  * target futex.  If so, determine if it was a timeout or a signal that caused
  * the wakeup and return the appropriate error code to the caller.  Must be
- * called with the hb lock held.
+ * called with the q->lock_ptr held.
  *
  * Returns
  *  0 - no early wakeup detected
  * <0 - -ETIMEDOUT or -ERESTARTNOINTR
  */
 static inline
-int handle_early_requeue_pi_wakeup(struct futex_hash_bucket *hb,
-				   struct futex_q *q, union futex_key *key2,
+int handle_early_requeue_pi_wakeup(struct futex_q *q, union futex_key *key2,
 				   struct hrtimer_sleeper *timeout)
 {
 	int ret = 0;
@@ -2202,12 +2432,11 @@ int handle_early_requeue_pi_wakeup(struct futex_hash_bucket *hb,
 	 * support a PI aware source futex for requeue.
 	 */
 	if (!match_futex(&q->key, key2)) {
-		WARN_ON(q->lock_ptr && (&hb->lock != q->lock_ptr));
 		/*
 		 * We were woken prior to requeue by a timeout or a signal.
 		 * Unqueue the futex_q and determine which it was.
 		 */
-		plist_del(&q->list, &hb->chain);
+		__unqueue_futex(q);
 
 		/* Handle spurious wakeups gracefully */
 		ret = -EWOULDBLOCK;
@@ -2311,9 +2540,9 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags,
 	/* Queue the futex_q, drop the hb lock, wait for wakeup. */
 	futex_wait_queue_me(hb, &q, to);
 
-	spin_lock(&hb->lock);
-	ret = handle_early_requeue_pi_wakeup(hb, &q, &key2, to);
-	spin_unlock(&hb->lock);
+	futex_q_lock(&q);
+	ret = handle_early_requeue_pi_wakeup(&q, &key2, to);
+	spin_unlock(q.lock_ptr);
 	if (ret)
 		goto out_put_keys;
 
@@ -2333,7 +2562,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags,
 		 * did a lock-steal - fix up the PI-state in that case.
 		 */
 		if (q.pi_state && (q.pi_state->owner != current)) {
-			spin_lock(q.lock_ptr);
+			futex_q_lock(&q);
 			ret = fixup_pi_state_owner(uaddr2, &q, current);
 			spin_unlock(q.lock_ptr);
 		}
@@ -2348,7 +2577,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags,
 		ret = rt_mutex_finish_proxy_lock(pi_mutex, to, &rt_waiter, 1);
 		debug_rt_mutex_free_waiter(&rt_waiter);
 
-		spin_lock(q.lock_ptr);
+		futex_q_lock(&q);
 		/*
 		 * Fixup the pi_state owner and possibly acquire the lock if we
 		 * haven't already.
@@ -2709,8 +2938,9 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
+	unsigned long i;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2725,9 +2955,21 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0, 0,
+					       &futex_shift, NULL, futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
+
+	for (i = 0; i < futex_hashsize; i++) {
 		plist_head_init(&futex_queues[i].chain);
 		spin_lock_init(&futex_queues[i].lock);
+		futex_queues[i].dead = 0;
 	}
 
 	return 0;
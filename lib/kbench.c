@@ -0,0 +1,96 @@
+/*
+ * lib/kbench.c - harness for in-kernel microbenchmark modules
+ *
+ * See include/linux/kbench.h.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpumask.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/kbench.h>
+
+struct kbench {
+	kbench_fn		fn;
+	struct completion	start;
+	struct completion	done;
+	atomic_t		running;
+};
+
+static int kbench_thread_fn(void *data)
+{
+	struct kbench_thread *t = data;
+	struct kbench *b = t->bench;
+	ktime_t start;
+
+	wait_for_completion(&b->start);
+
+	start = ktime_get();
+	t->err = b->fn(t);
+	t->ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_dec_and_test(&b->running))
+		complete(&b->done);
+
+	/* wait for kthread_stop() */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+int kbench_run(struct kbench_thread *threads, int nr, kbench_fn fn,
+	       const char *name, u64 *ns)
+{
+	struct kbench b = { .fn = fn };
+	u64 total = 0;
+	int cpu, i, err = 0;
+
+	init_completion(&b.start);
+	init_completion(&b.done);
+	atomic_set(&b.running, nr);
+
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < nr; i++) {
+		struct kbench_thread *t = &threads[i];
+
+		t->bench = &b;
+		t->id = i;
+		t->ns = 0;
+		t->err = 0;
+		t->task = kthread_create(kbench_thread_fn, t, "%s/%d",
+					 name, cpu);
+		if (IS_ERR(t->task)) {
+			err = PTR_ERR(t->task);
+			while (i--)
+				kthread_stop(threads[i].task);
+			return err;
+		}
+		kthread_bind(t->task, cpu);
+		cpu = cpumask_next(cpu, cpu_online_mask);
+	}
+
+	for (i = 0; i < nr; i++)
+		wake_up_process(threads[i].task);
+	complete_all(&b.start);
+	wait_for_completion(&b.done);
+
+	for (i = 0; i < nr; i++) {
+		kthread_stop(threads[i].task);
+		if (threads[i].err)
+			err = threads[i].err;
+		total += threads[i].ns;
+	}
+
+	*ns = div64_u64(total, nr);
+	return err;
+}
+EXPORT_SYMBOL_GPL(kbench_run);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Harness for in-kernel microbenchmarks");
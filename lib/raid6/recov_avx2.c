@@ -0,0 +1,255 @@
+/* -*- linux-c -*- ------------------------------------------------------- *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 53 Temple Place Ste 330,
+ *   Boston MA 02111-1307, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * raid6/recov_avx2.c
+ *
+ * AVX2 implementation of RAID-6 dual failure recovery.  Same nibble
+ * table scheme as the SSSE3 version, with the 16-byte tables broadcast
+ * to both lanes so VPSHUFB handles 32 bytes at a time.
+ */
+
+#if (defined(__i386__) || defined(__x86_64__)) && !defined(__arch_um__)
+
+#ifdef CONFIG_AS_AVX2
+
+#include <linux/raid/pq.h>
+#include "x86.h"
+
+static const u8 raid6_avx2_x0f[32] __attribute__((aligned(32))) = {
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+};
+
+static int raid6_has_avx2(void)
+{
+	return boot_cpu_has(X86_FEATURE_AVX2) &&
+		boot_cpu_has(X86_FEATURE_AVX);
+}
+
+/* Recover two failed data blocks. */
+static void raid6_2data_recov_avx2(int disks, size_t bytes, int faila,
+		int failb, void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	const u8 *pbmul;	/* P multiplier table for B data */
+	const u8 *qmul;		/* Q multiplier table (for both) */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/* Compute syndrome with zero for the missing data pages
+	   Use the dead data pages as temporary storage for
+	   delta p and delta q */
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dp;
+	ptrs[failb]   = dq;
+	ptrs[disks-2] = p;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data tables */
+	pbmul = raid6_vgfmul[raid6_gfexi[failb-faila]];
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila] ^
+		raid6_gfexp[failb]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("vmovdqa %0,%%ymm7" : : "m" (raid6_avx2_x0f[0]));
+
+#ifdef __x86_64__
+	/* Keep the tables in registers and do two blocks at a time */
+	asm volatile("vbroadcasti128 %0,%%ymm8" : : "m" (qmul[0]));
+	asm volatile("vbroadcasti128 %0,%%ymm9" : : "m" (qmul[16]));
+	asm volatile("vbroadcasti128 %0,%%ymm10" : : "m" (pbmul[0]));
+	asm volatile("vbroadcasti128 %0,%%ymm11" : : "m" (pbmul[16]));
+
+	while (bytes) {
+		/* ymm0/ymm12 = px = p ^ dp, ymm1/ymm13 = q ^ dq */
+		asm volatile("vmovdqa %0,%%ymm0" : : "m" (p[0]));
+		asm volatile("vmovdqa %0,%%ymm12" : : "m" (p[32]));
+		asm volatile("vmovdqa %0,%%ymm1" : : "m" (q[0]));
+		asm volatile("vmovdqa %0,%%ymm13" : : "m" (q[32]));
+		asm volatile("vpxor %0,%%ymm0,%%ymm0" : : "m" (dp[0]));
+		asm volatile("vpxor %0,%%ymm12,%%ymm12" : : "m" (dp[32]));
+		asm volatile("vpxor %0,%%ymm1,%%ymm1" : : "m" (dq[0]));
+		asm volatile("vpxor %0,%%ymm13,%%ymm13" : : "m" (dq[32]));
+
+		/* ymm5/ymm15 = qx = qmul[q ^ dq] */
+		asm volatile("vpsraw $4,%ymm1,%ymm3");
+		asm volatile("vpsraw $4,%ymm13,%ymm6");
+		asm volatile("vpand %ymm7,%ymm1,%ymm1");
+		asm volatile("vpand %ymm7,%ymm13,%ymm13");
+		asm volatile("vpand %ymm7,%ymm3,%ymm3");
+		asm volatile("vpand %ymm7,%ymm6,%ymm6");
+		asm volatile("vpshufb %ymm1,%ymm8,%ymm4");
+		asm volatile("vpshufb %ymm13,%ymm8,%ymm14");
+		asm volatile("vpshufb %ymm3,%ymm9,%ymm5");
+		asm volatile("vpshufb %ymm6,%ymm9,%ymm15");
+		asm volatile("vpxor %ymm4,%ymm5,%ymm5");
+		asm volatile("vpxor %ymm14,%ymm15,%ymm15");
+
+		/* ymm1/ymm13 = db = pbmul[px] ^ qx */
+		asm volatile("vpsraw $4,%ymm0,%ymm2");
+		asm volatile("vpsraw $4,%ymm12,%ymm6");
+		asm volatile("vpand %ymm7,%ymm0,%ymm3");
+		asm volatile("vpand %ymm7,%ymm12,%ymm13");
+		asm volatile("vpand %ymm7,%ymm2,%ymm2");
+		asm volatile("vpand %ymm7,%ymm6,%ymm6");
+		asm volatile("vpshufb %ymm3,%ymm10,%ymm4");
+		asm volatile("vpshufb %ymm13,%ymm10,%ymm14");
+		asm volatile("vpshufb %ymm2,%ymm11,%ymm1");
+		asm volatile("vpshufb %ymm6,%ymm11,%ymm13");
+		asm volatile("vpxor %ymm4,%ymm1,%ymm1");
+		asm volatile("vpxor %ymm14,%ymm13,%ymm13");
+		asm volatile("vpxor %ymm5,%ymm1,%ymm1");
+		asm volatile("vpxor %ymm15,%ymm13,%ymm13");
+
+		asm volatile("vmovdqa %%ymm1,%0" : "=m" (dq[0]));
+		asm volatile("vmovdqa %%ymm13,%0" : "=m" (dq[32]));
+
+		/* da = db ^ px */
+		asm volatile("vpxor %ymm1,%ymm0,%ymm0");
+		asm volatile("vpxor %ymm13,%ymm12,%ymm12");
+		asm volatile("vmovdqa %%ymm0,%0" : "=m" (dp[0]));
+		asm volatile("vmovdqa %%ymm12,%0" : "=m" (dp[32]));
+
+		bytes -= 64;
+		p += 64;
+		q += 64;
+		dp += 64;
+		dq += 64;
+	}
+#else
+	while (bytes) {
+		/* ymm0 = px = p ^ dp, ymm1 = q ^ dq */
+		asm volatile("vmovdqa %0,%%ymm0" : : "m" (p[0]));
+		asm volatile("vmovdqa %0,%%ymm1" : : "m" (q[0]));
+		asm volatile("vpxor %0,%%ymm0,%%ymm0" : : "m" (dp[0]));
+		asm volatile("vpxor %0,%%ymm1,%%ymm1" : : "m" (dq[0]));
+
+		/* ymm5 = qx = qmul[q ^ dq] */
+		asm volatile("vbroadcasti128 %0,%%ymm4" : : "m" (qmul[0]));
+		asm volatile("vbroadcasti128 %0,%%ymm5" : : "m" (qmul[16]));
+		asm volatile("vpsraw $4,%ymm1,%ymm3");
+		asm volatile("vpand %ymm7,%ymm1,%ymm1");
+		asm volatile("vpand %ymm7,%ymm3,%ymm3");
+		asm volatile("vpshufb %ymm1,%ymm4,%ymm4");
+		asm volatile("vpshufb %ymm3,%ymm5,%ymm5");
+		asm volatile("vpxor %ymm4,%ymm5,%ymm5");
+
+		/* ymm1 = db = pbmul[px] ^ qx */
+		asm volatile("vbroadcasti128 %0,%%ymm4" : : "m" (pbmul[0]));
+		asm volatile("vbroadcasti128 %0,%%ymm1" : : "m" (pbmul[16]));
+		asm volatile("vpsraw $4,%ymm0,%ymm2");
+		asm volatile("vpand %ymm7,%ymm0,%ymm3");
+		asm volatile("vpand %ymm7,%ymm2,%ymm2");
+		asm volatile("vpshufb %ymm3,%ymm4,%ymm4");
+		asm volatile("vpshufb %ymm2,%ymm1,%ymm1");
+		asm volatile("vpxor %ymm4,%ymm1,%ymm1");
+		asm volatile("vpxor %ymm5,%ymm1,%ymm1");
+
+		asm volatile("vmovdqa %%ymm1,%0" : "=m" (dq[0]));
+
+		/* da = db ^ px */
+		asm volatile("vpxor %ymm1,%ymm0,%ymm0");
+		asm volatile("vmovdqa %%ymm0,%0" : "=m" (dp[0]));
+
+		bytes -= 32;
+		p += 32;
+		q += 32;
+		dp += 32;
+		dq += 32;
+	}
+#endif
+
+	kernel_fpu_end();
+}
+
+/* Recover failure of one data block plus the P block */
+static void raid6_datap_recov_avx2(int disks, size_t bytes, int faila,
+		void **ptrs)
+{
+	u8 *p, *q, *dq;
+	const u8 *qmul;		/* Q multiplier table */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/* Compute syndrome with zero for the missing data page
+	   Use the dead data page as temporary storage for delta q */
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dq;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data tables */
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("vmovdqa %0,%%ymm7" : : "m" (raid6_avx2_x0f[0]));
+	asm volatile("vbroadcasti128 %0,%%ymm5" : : "m" (qmul[0]));
+	asm volatile("vbroadcasti128 %0,%%ymm6" : : "m" (qmul[16]));
+
+	while (bytes) {
+		/* ymm3 = q ^ dq */
+		asm volatile("vmovdqa %0,%%ymm3" : : "m" (dq[0]));
+		asm volatile("vpxor %0,%%ymm3,%%ymm3" : : "m" (q[0]));
+
+		/* ymm1 = dq = qmul[q ^ dq] */
+		asm volatile("vpsraw $4,%ymm3,%ymm2");
+		asm volatile("vpand %ymm7,%ymm3,%ymm3");
+		asm volatile("vpand %ymm7,%ymm2,%ymm2");
+		asm volatile("vpshufb %ymm3,%ymm5,%ymm0");
+		asm volatile("vpshufb %ymm2,%ymm6,%ymm1");
+		asm volatile("vpxor %ymm0,%ymm1,%ymm1");
+
+		asm volatile("vmovdqa %%ymm1,%0" : "=m" (dq[0]));
+
+		/* p ^= dq */
+		asm volatile("vpxor %0,%%ymm1,%%ymm1" : : "m" (p[0]));
+		asm volatile("vmovdqa %%ymm1,%0" : "=m" (p[0]));
+
+		bytes -= 32;
+		p += 32;
+		q += 32;
+		dq += 32;
+	}
+
+	kernel_fpu_end();
+}
+
+const struct raid6_recov_calls raid6_recov_avx2 = {
+	.data2 = raid6_2data_recov_avx2,
+	.datap = raid6_datap_recov_avx2,
+	.valid = raid6_has_avx2,
+	.name = "avx2",
+	.priority = 2,
+};
+
+#endif /* CONFIG_AS_AVX2 */
+
+#endif
@@ -0,0 +1,271 @@
+/* -*- linux-c -*- ------------------------------------------------------- *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 53 Temple Place Ste 330,
+ *   Boston MA 02111-1307, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * raid6/recov_ssse3.c
+ *
+ * SSSE3 implementation of RAID-6 dual failure recovery.  The GF(2^8)
+ * multiplications are done sixteen bytes at a time with PSHUFB, looking
+ * up the products of the low and high nibbles in the raid6_vgfmul
+ * tables and xoring them together.
+ */
+
+#if (defined(__i386__) || defined(__x86_64__)) && !defined(__arch_um__)
+
+#include <linux/raid/pq.h>
+#include "x86.h"
+
+static const u8 raid6_ssse3_x0f[16] __attribute__((aligned(16))) = {
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+};
+
+static int raid6_has_ssse3(void)
+{
+	return boot_cpu_has(X86_FEATURE_XMM) &&
+		boot_cpu_has(X86_FEATURE_XMM2) &&
+		boot_cpu_has(X86_FEATURE_SSSE3);
+}
+
+/* Recover two failed data blocks. */
+static void raid6_2data_recov_ssse3(int disks, size_t bytes, int faila,
+		int failb, void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	const u8 *pbmul;	/* P multiplier table for B data */
+	const u8 *qmul;		/* Q multiplier table (for both) */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/* Compute syndrome with zero for the missing data pages
+	   Use the dead data pages as temporary storage for
+	   delta p and delta q */
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dp;
+	ptrs[failb]   = dq;
+	ptrs[disks-2] = p;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data tables */
+	pbmul = raid6_vgfmul[raid6_gfexi[failb-faila]];
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila] ^
+		raid6_gfexp[failb]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("movdqa %0,%%xmm7" : : "m" (raid6_ssse3_x0f[0]));
+
+#ifdef __x86_64__
+	/* Keep the tables in registers and do two blocks at a time */
+	asm volatile("movdqa %0,%%xmm8" : : "m" (qmul[0]));
+	asm volatile("movdqa %0,%%xmm9" : : "m" (qmul[16]));
+	asm volatile("movdqa %0,%%xmm10" : : "m" (pbmul[0]));
+	asm volatile("movdqa %0,%%xmm11" : : "m" (pbmul[16]));
+
+	while (bytes) {
+		/* xmm0/xmm12 = px = p ^ dp, xmm1/xmm13 = q ^ dq */
+		asm volatile("movdqa %0,%%xmm0" : : "m" (p[0]));
+		asm volatile("movdqa %0,%%xmm12" : : "m" (p[16]));
+		asm volatile("movdqa %0,%%xmm1" : : "m" (q[0]));
+		asm volatile("movdqa %0,%%xmm13" : : "m" (q[16]));
+		asm volatile("pxor %0,%%xmm0" : : "m" (dp[0]));
+		asm volatile("pxor %0,%%xmm12" : : "m" (dp[16]));
+		asm volatile("pxor %0,%%xmm1" : : "m" (dq[0]));
+		asm volatile("pxor %0,%%xmm13" : : "m" (dq[16]));
+
+		/* xmm5/xmm15 = qx = qmul[q ^ dq] */
+		asm volatile("movdqa %xmm8,%xmm4");
+		asm volatile("movdqa %xmm9,%xmm5");
+		asm volatile("movdqa %xmm8,%xmm14");
+		asm volatile("movdqa %xmm9,%xmm15");
+		asm volatile("movdqa %xmm1,%xmm3");
+		asm volatile("movdqa %xmm13,%xmm6");
+		asm volatile("psraw $4,%xmm1");
+		asm volatile("psraw $4,%xmm13");
+		asm volatile("pand %xmm7,%xmm3");
+		asm volatile("pand %xmm7,%xmm6");
+		asm volatile("pand %xmm7,%xmm1");
+		asm volatile("pand %xmm7,%xmm13");
+		asm volatile("pshufb %xmm3,%xmm4");
+		asm volatile("pshufb %xmm6,%xmm14");
+		asm volatile("pshufb %xmm1,%xmm5");
+		asm volatile("pshufb %xmm13,%xmm15");
+		asm volatile("pxor %xmm4,%xmm5");
+		asm volatile("pxor %xmm14,%xmm15");
+
+		/* xmm1/xmm13 = db = pbmul[px] ^ qx */
+		asm volatile("movdqa %xmm10,%xmm4");
+		asm volatile("movdqa %xmm11,%xmm1");
+		asm volatile("movdqa %xmm10,%xmm14");
+		asm volatile("movdqa %xmm11,%xmm13");
+		asm volatile("movdqa %xmm0,%xmm2");
+		asm volatile("movdqa %xmm0,%xmm3");
+		asm volatile("psraw $4,%xmm2");
+		asm volatile("pand %xmm7,%xmm3");
+		asm volatile("pand %xmm7,%xmm2");
+		asm volatile("pshufb %xmm3,%xmm4");
+		asm volatile("pshufb %xmm2,%xmm1");
+		asm volatile("movdqa %xmm12,%xmm2");
+		asm volatile("movdqa %xmm12,%xmm3");
+		asm volatile("psraw $4,%xmm2");
+		asm volatile("pand %xmm7,%xmm3");
+		asm volatile("pand %xmm7,%xmm2");
+		asm volatile("pshufb %xmm3,%xmm14");
+		asm volatile("pshufb %xmm2,%xmm13");
+		asm volatile("pxor %xmm4,%xmm1");
+		asm volatile("pxor %xmm14,%xmm13");
+		asm volatile("pxor %xmm5,%xmm1");
+		asm volatile("pxor %xmm15,%xmm13");
+
+		asm volatile("movdqa %%xmm1,%0" : "=m" (dq[0]));
+		asm volatile("movdqa %%xmm13,%0" : "=m" (dq[16]));
+
+		/* da = db ^ px */
+		asm volatile("pxor %xmm1,%xmm0");
+		asm volatile("pxor %xmm13,%xmm12");
+		asm volatile("movdqa %%xmm0,%0" : "=m" (dp[0]));
+		asm volatile("movdqa %%xmm12,%0" : "=m" (dp[16]));
+
+		bytes -= 32;
+		p += 32;
+		q += 32;
+		dp += 32;
+		dq += 32;
+	}
+#else
+	while (bytes) {
+		/* xmm0 = px = p ^ dp, xmm1 = q ^ dq */
+		asm volatile("movdqa %0,%%xmm0" : : "m" (p[0]));
+		asm volatile("movdqa %0,%%xmm1" : : "m" (q[0]));
+		asm volatile("pxor %0,%%xmm0" : : "m" (dp[0]));
+		asm volatile("pxor %0,%%xmm1" : : "m" (dq[0]));
+
+		/* xmm5 = qx = qmul[q ^ dq] */
+		asm volatile("movdqa %0,%%xmm4" : : "m" (qmul[0]));
+		asm volatile("movdqa %0,%%xmm5" : : "m" (qmul[16]));
+		asm volatile("movdqa %xmm1,%xmm3");
+		asm volatile("psraw $4,%xmm1");
+		asm volatile("pand %xmm7,%xmm3");
+		asm volatile("pand %xmm7,%xmm1");
+		asm volatile("pshufb %xmm3,%xmm4");
+		asm volatile("pshufb %xmm1,%xmm5");
+		asm volatile("pxor %xmm4,%xmm5");
+
+		/* xmm1 = db = pbmul[px] ^ qx */
+		asm volatile("movdqa %0,%%xmm4" : : "m" (pbmul[0]));
+		asm volatile("movdqa %0,%%xmm1" : : "m" (pbmul[16]));
+		asm volatile("movdqa %xmm0,%xmm2");
+		asm volatile("movdqa %xmm0,%xmm3");
+		asm volatile("psraw $4,%xmm2");
+		asm volatile("pand %xmm7,%xmm3");
+		asm volatile("pand %xmm7,%xmm2");
+		asm volatile("pshufb %xmm3,%xmm4");
+		asm volatile("pshufb %xmm2,%xmm1");
+		asm volatile("pxor %xmm4,%xmm1");
+		asm volatile("pxor %xmm5,%xmm1");
+
+		asm volatile("movdqa %%xmm1,%0" : "=m" (dq[0]));
+
+		/* da = db ^ px */
+		asm volatile("pxor %xmm1,%xmm0");
+		asm volatile("movdqa %%xmm0,%0" : "=m" (dp[0]));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dp += 16;
+		dq += 16;
+	}
+#endif
+
+	kernel_fpu_end();
+}
+
+/* Recover failure of one data block plus the P block */
+static void raid6_datap_recov_ssse3(int disks, size_t bytes, int faila,
+		void **ptrs)
+{
+	u8 *p, *q, *dq;
+	const u8 *qmul;		/* Q multiplier table */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/* Compute syndrome with zero for the missing data page
+	   Use the dead data page as temporary storage for delta q */
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dq;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data tables */
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("movdqa %0,%%xmm7" : : "m" (raid6_ssse3_x0f[0]));
+	asm volatile("movdqa %0,%%xmm5" : : "m" (qmul[0]));
+	asm volatile("movdqa %0,%%xmm6" : : "m" (qmul[16]));
+
+	while (bytes) {
+		/* xmm3 = q ^ dq */
+		asm volatile("movdqa %0,%%xmm3" : : "m" (dq[0]));
+		asm volatile("pxor %0,%%xmm3" : : "m" (q[0]));
+
+		/* xmm1 = dq = qmul[q ^ dq] */
+		asm volatile("movdqa %xmm5,%xmm0");
+		asm volatile("movdqa %xmm6,%xmm1");
+		asm volatile("movdqa %xmm3,%xmm2");
+		asm volatile("psraw $4,%xmm3");
+		asm volatile("pand %xmm7,%xmm2");
+		asm volatile("pand %xmm7,%xmm3");
+		asm volatile("pshufb %xmm2,%xmm0");
+		asm volatile("pshufb %xmm3,%xmm1");
+		asm volatile("pxor %xmm0,%xmm1");
+
+		asm volatile("movdqa %%xmm1,%0" : "=m" (dq[0]));
+
+		/* p ^= dq */
+		asm volatile("pxor %0,%%xmm1" : : "m" (p[0]));
+		asm volatile("movdqa %%xmm1,%0" : "=m" (p[0]));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dq += 16;
+	}
+
+	kernel_fpu_end();
+}
+
+const struct raid6_recov_calls raid6_recov_ssse3 = {
+	.data2 = raid6_2data_recov_ssse3,
+	.datap = raid6_datap_recov_ssse3,
+	.valid = raid6_has_ssse3,
+	.name = "ssse3",
+	.priority = 1,
+};
+
+#endif
@@ -1478,6 +1478,101 @@ out:
 }
 EXPORT_SYMBOL(generic_file_aio_read);
 
+static int filemap_aio_wake_function(wait_queue_t *wait, unsigned mode,
+				     int sync, void *arg)
+{
+	struct wait_bit_key *key = arg;
+	struct wait_bit_queue *wait_bit
+		= container_of(wait, struct wait_bit_queue, wait);
+	struct kiocb *iocb = container_of(wait_bit, struct kiocb, ki_wait);
+
+	if (wait_bit->key.flags != key->flags ||
+			wait_bit->key.bit_nr != key->bit_nr ||
+			test_bit(key->bit_nr, key->flags))
+		return 0;
+
+	list_del_init(&wait->task_list);
+	kick_iocb(iocb);
+	return 1;
+}
+
+/**
+ * filemap_aio_read_wait - get the page cache ready for an async buffered read
+ * @iocb:	the kiocb doing the read
+ * @pos:	file position the read starts at
+ * @count:	number of bytes to be read
+ *
+ * Starts readahead for whatever part of [@pos, @pos + @count) is not in
+ * the page cache yet.  Returns 0 when the pages are uptodate, so that the
+ * read can be done without waiting for I/O.  Otherwise returns -EIOCBRETRY
+ * after arranging for kick_iocb() to be called when the first page still
+ * under read I/O is unlocked; the read is then retried from the aio
+ * workqueue.  Pages that are missing or failed to read are left to the
+ * read path, which will block on them and report the error as usual.
+ */
+int filemap_aio_read_wait(struct kiocb *iocb, loff_t pos, size_t count)
+{
+	struct file *filp = iocb->ki_filp;
+	struct address_space *mapping = filp->f_mapping;
+	struct file_ra_state *ra = &filp->f_ra;
+	struct wait_bit_queue *wait = &iocb->ki_wait;
+	pgoff_t index, last_index;
+	loff_t isize;
+
+	isize = i_size_read(mapping->host);
+	if (!count || pos >= isize)
+		return 0;
+	if (count > isize - pos)
+		count = isize - pos;
+
+	index = pos >> PAGE_CACHE_SHIFT;
+	last_index = (pos + count - 1) >> PAGE_CACHE_SHIFT;
+
+	for (; index <= last_index; index++) {
+		wait_queue_head_t *q;
+		struct page *page;
+
+		page = find_get_page(mapping, index);
+		if (!page) {
+			page_cache_sync_readahead(mapping, ra, filp, index,
+						  last_index - index + 1);
+			page = find_get_page(mapping, index);
+			if (unlikely(!page))
+				return 0;
+		}
+		if (PageReadahead(page))
+			page_cache_async_readahead(mapping, ra, filp, page,
+						   index, last_index - index + 1);
+		if (PageUptodate(page)) {
+			page_cache_release(page);
+			continue;
+		}
+
+		/*
+		 * Queue up before looking at PG_locked, so that an unlock
+		 * racing with us is either seen here or kicks the iocb.
+		 */
+		q = page_waitqueue(page);
+		wait->key.flags = &page->flags;
+		wait->key.bit_nr = PG_locked;
+		init_waitqueue_func_entry(&wait->wait, filemap_aio_wake_function);
+		add_wait_queue(q, &wait->wait);
+		if (PageLocked(page)) {
+			page_cache_release(page);
+			return -EIOCBRETRY;
+		}
+		remove_wait_queue(q, &wait->wait);
+
+		if (!PageUptodate(page)) {
+			page_cache_release(page);
+			return 0;
+		}
+		page_cache_release(page);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(filemap_aio_read_wait);
+
 static ssize_t
 do_readahead(struct address_space *mapping, struct file *filp,
 	     pgoff_t index, unsigned long nr)
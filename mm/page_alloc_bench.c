@@ -0,0 +1,137 @@
+/*
+ * mm/page_alloc_bench.c
+ *
+ * Page allocator microbenchmark.  One kernel thread per CPU allocates
+ * batches of pages of a given order and frees them again, and the cost
+ * of an alloc/free pair is reported per order.  Running it with an
+ * increasing number of cpus shows how the allocator scales, e.g.
+ *
+ *	modprobe page_alloc_bench order=2 batch=16 cpus=8
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/kbench.h>
+#include <linux/sched.h>
+
+static int order = -1;
+module_param(order, int, 0);
+MODULE_PARM_DESC(order, "Order to test (default: 0 up to PCP_MAX_ORDER + 1)");
+
+static int cpus;
+module_param(cpus, int, 0);
+MODULE_PARM_DESC(cpus, "Number of CPUs to run on (default: all online)");
+
+static int loops = 100000;
+module_param(loops, int, 0);
+MODULE_PARM_DESC(loops, "Number of batches each thread allocates and frees");
+
+static int batch = 1;
+module_param(batch, int, 0);
+MODULE_PARM_DESC(batch, "Number of pages held before they are freed");
+
+/* order of the current run */
+static unsigned int bench_order;
+
+static int bench_fn(struct kbench_thread *t)
+{
+	struct page **pages = t->data;
+	int i, j, err = 0;
+
+	for (i = 0; i < loops && !err; i++) {
+		for (j = 0; j < batch; j++) {
+			pages[j] = alloc_pages(GFP_KERNEL, bench_order);
+			if (!pages[j]) {
+				err = -ENOMEM;
+				break;
+			}
+		}
+		while (j--)
+			__free_pages(pages[j], bench_order);
+		cond_resched();
+	}
+	return err;
+}
+
+static int bench_run(struct kbench_thread *threads, int nr, unsigned int o)
+{
+	u64 ns, ops;
+	int err;
+
+	bench_order = o;
+	err = kbench_run(threads, nr, bench_fn, "page_alloc_bench", &ns);
+	if (err) {
+		printk(KERN_ERR "page_alloc_bench: order %u: allocation failed\n",
+		       o);
+		return err;
+	}
+
+	ops = (u64)loops * batch;
+	printk(KERN_INFO "page_alloc_bench: order %u: %d threads, "
+	       "%llu ns per alloc+free, %llu pairs/sec\n", o, nr,
+	       div64_u64(ns, ops),
+	       ns ? div64_u64(ops * nr * NSEC_PER_SEC, ns) : 0);
+	return 0;
+}
+
+static int __init page_alloc_bench_init(void)
+{
+	struct kbench_thread *threads;
+	int nr, o, first, last, i, err = 0;
+
+	if (order >= MAX_ORDER || loops <= 0 || batch <= 0 || cpus < 0)
+		return -EINVAL;
+
+	if (order < 0) {
+		first = 0;
+		/* one order past the pcp lists, for comparison */
+		last = min(PCP_MAX_ORDER + 1, MAX_ORDER - 1);
+	} else
+		first = last = order;
+
+	get_online_cpus();
+
+	nr = num_online_cpus();
+	if (cpus && cpus < nr)
+		nr = cpus;
+
+	threads = kcalloc(nr, sizeof(*threads), GFP_KERNEL);
+	if (!threads) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < nr; i++) {
+		threads[i].data = kcalloc(batch, sizeof(struct page *),
+					  GFP_KERNEL);
+		if (!threads[i].data) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	for (o = first; o <= last && !err; o++)
+		err = bench_run(threads, nr, o);
+
+out_free:
+	for (i = 0; i < nr; i++)
+		kfree(threads[i].data);
+	kfree(threads);
+out:
+	put_online_cpus();
+
+	return kbench_init_result(err);
+}
+
+module_init(page_alloc_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Page allocator microbenchmark");
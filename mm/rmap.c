@@ -1224,6 +1224,105 @@ out:
 		mem_cgroup_end_update_page_stat(page, &locked, &flags);
 }
 
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+/*
+ * Flush the TLB for all mms whose ptes were cleared by TTU_BATCH_FLUSH
+ * unmaps.  This is one flush_tlb_mm() per mm instead of one IPI per
+ * page, and must be done before the unmapped pages are freed.
+ */
+void try_to_unmap_flush(void)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+	unsigned int i;
+
+	for (i = 0; i < tlb_ubc->nr_mm; i++) {
+		flush_tlb_mm(tlb_ubc->mm[i]);
+		mmdrop(tlb_ubc->mm[i]);
+	}
+	tlb_ubc->nr_mm = 0;
+	tlb_ubc->writable = false;
+}
+
+/*
+ * Flush if a stale TLB entry could still write to an unmapped page, which
+ * must not happen once the page is under writeback.
+ */
+void try_to_unmap_flush_dirty(void)
+{
+	if (current->tlb_ubc.writable)
+		try_to_unmap_flush();
+}
+
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+	unsigned int i;
+
+	for (i = 0; i < tlb_ubc->nr_mm; i++)
+		if (tlb_ubc->mm[i] == mm)
+			goto found;
+
+	if (tlb_ubc->nr_mm == TLB_UBC_NR_MM)
+		try_to_unmap_flush();
+	atomic_inc(&mm->mm_count);
+	tlb_ubc->mm[tlb_ubc->nr_mm++] = mm;
+found:
+	if (writable)
+		tlb_ubc->writable = true;
+
+	/*
+	 * Tell zap_pte_range() and friends, which may find the pte already
+	 * cleared and skip their own flush, that one is outstanding.  Set
+	 * under the pte lock, which they take as well.
+	 */
+	mm->tlb_flush_batched = true;
+}
+
+/*
+ * Only defer the flush if other CPUs would have to be interrupted for it,
+ * a local flush is cheap enough.
+ */
+static bool should_defer_flush(struct mm_struct *mm, enum ttu_flags flags)
+{
+	bool should_defer = false;
+
+	if (!(flags & TTU_BATCH_FLUSH))
+		return false;
+
+	if (cpumask_any_but(mm_cpumask(mm), get_cpu()) < nr_cpu_ids)
+		should_defer = true;
+	put_cpu();
+
+	return should_defer;
+}
+
+/*
+ * Reclaim may have cleared ptes of @mm and not yet flushed the TLB.  A
+ * caller which finds such a pte_none() entry under the pte lock, and
+ * relies on the TLB being clean for it afterwards (munmap, mprotect,
+ * mremap), calls this first.
+ */
+void flush_tlb_batched_pending(struct mm_struct *mm)
+{
+	if (mm->tlb_flush_batched) {
+		flush_tlb_mm(mm);
+
+		/* the flush must be done before the flag is cleared */
+		barrier();
+		mm->tlb_flush_batched = false;
+	}
+}
+#else
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+}
+
+static bool should_defer_flush(struct mm_struct *mm, enum ttu_flags flags)
+{
+	return false;
+}
+#endif /* CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH */
+
 /*
  * Subfunctions of try_to_unmap: try_to_unmap_one called
  * repeatedly from try_to_unmap_ksm, try_to_unmap_anon or try_to_unmap_file.
@@ -1262,7 +1361,19 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 
 	/* Nuke the page table entry. */
 	flush_cache_page(vma, address, page_to_pfn(page));
-	pteval = ptep_clear_flush_notify(vma, address, pte);
+	if (should_defer_flush(mm, flags)) {
+		/*
+		 * Clear the pte now and flush the TLB later, together with
+		 * the other pages of this reclaim batch.  A stale entry can
+		 * still write to the page only if the pte was dirty, in
+		 * which case the page is dirtied below and the flush is
+		 * done before it is written back.
+		 */
+		pteval = ptep_get_and_clear(mm, address, pte);
+		set_tlb_ubc_flush_pending(mm, pte_dirty(pteval));
+		mmu_notifier_invalidate_page(mm, address);
+	} else
+		pteval = ptep_clear_flush_notify(vma, address, pte);
 
 	/* Move the dirty bit to the physical page now the pte is gone. */
 	if (pte_dirty(pteval))
@@ -42,6 +42,7 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/memory_hotplug.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -113,6 +114,12 @@ struct scan_control {
 	 * are scanned.
 	 */
 	nodemask_t	*nodemask;
+
+	/*
+	 * Number of kswapd threads sharing the scanning of the node, each
+	 * scans its share of the LRU lists.  0 for direct reclaim.
+	 */
+	int kswapd_threads;
 };
 
 struct mem_cgroup_zone {
@@ -156,6 +163,12 @@ struct mem_cgroup_zone {
 int vm_swappiness = 60;
 long vm_total_pages;	/* The total number of pages which the VM controls */
 
+/* kswapd threads per node, protected by kswapd_threads_lock */
+int kswapd_threads = 1;
+static DEFINE_MUTEX(kswapd_threads_lock);
+/* protects pgdat->kswapd_awake and the per-cpu threshold switching */
+static DEFINE_MUTEX(kswapd_awake_lock);
+
 static LIST_HEAD(shrinker_list);
 static DECLARE_RWSEM(shrinker_rwsem);
 
@@ -536,12 +549,17 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
  * Same as remove_mapping, but if the page is removed from the mapping, it
  * gets returned with a refcount of 0.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+/*
+ * Detach a locked page from its mapping, with mapping->tree_lock held.
+ * Returns 1 with the refcount frozen if the page was detached; the caller
+ * completes that with __remove_mapping_finish() after dropping the lock.
+ */
+static int __remove_mapping_locked(struct address_space *mapping,
+				   struct page *page)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
 
-	spin_lock_irq(&mapping->tree_lock);
 	/*
 	 * The non racy check for a busy page.
 	 *
@@ -568,36 +586,57 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 	 * and thus under tree_lock, then this ordering is not required.
 	 */
 	if (!page_freeze_refs(page, 2))
-		goto cannot_free;
+		return 0;
 	/* note: atomic_cmpxchg in page_freeze_refs provides the smp_rmb */
 	if (unlikely(PageDirty(page))) {
 		page_unfreeze_refs(page, 2);
-		goto cannot_free;
+		return 0;
 	}
 
 	if (PageSwapCache(page)) {
 		swp_entry_t swap = { .val = page_private(page) };
 		__delete_from_swap_cache(page);
-		spin_unlock_irq(&mapping->tree_lock);
-		swapcache_free(swap, page);
-	} else {
-		void (*freepage)(struct page *);
+		/* keep the entry for swapcache_free() */
+		set_page_private(page, swap.val);
+	} else
+		__delete_from_page_cache(page);
 
-		freepage = mapping->a_ops->freepage;
+	return 1;
+}
 
-		__delete_from_page_cache(page);
-		spin_unlock_irq(&mapping->tree_lock);
+/*
+ * The parts of removing a page from its mapping which are done without
+ * tree_lock.  @freepage has to be looked up before the page was detached,
+ * as nothing pins the mapping afterwards.
+ */
+static void __remove_mapping_finish(struct page *page, int swapcache,
+				    void (*freepage)(struct page *))
+{
+	if (swapcache) {
+		swp_entry_t swap = { .val = page_private(page) };
+		set_page_private(page, 0);
+		swapcache_free(swap, page);
+	} else {
 		mem_cgroup_uncharge_cache_page(page);
 
 		if (freepage != NULL)
 			freepage(page);
 	}
+}
 
-	return 1;
+static int __remove_mapping(struct address_space *mapping, struct page *page)
+{
+	void (*freepage)(struct page *) = mapping->a_ops->freepage;
+	int swapcache = PageSwapCache(page);
+	int ret;
 
-cannot_free:
+	spin_lock_irq(&mapping->tree_lock);
+	ret = __remove_mapping_locked(mapping, page);
 	spin_unlock_irq(&mapping->tree_lock);
-	return 0;
+
+	if (ret)
+		__remove_mapping_finish(page, swapcache, freepage);
+	return ret;
 }
 
 /*
@@ -759,6 +798,70 @@ static enum page_references page_check_references(struct page *page,
 	return PAGEREF_RECLAIM;
 }
 
+/*
+ * Detach a run of locked pages of one mapping, queued up by
+ * shrink_page_list(), under a single tree_lock hold.  Detached pages are
+ * moved to @free_pages, the others are unlocked and moved to @ret_pages.
+ * Returns the number of pages detached.
+ */
+static unsigned long remove_mapping_batch(struct list_head *remove_pages,
+					  struct list_head *ret_pages,
+					  struct list_head *free_pages,
+					  struct scan_control *sc)
+{
+	void (*freepage)(struct page *);
+	struct address_space *mapping;
+	LIST_HEAD(detached);
+	LIST_HEAD(kept);
+	unsigned long nr_detached = 0;
+	struct page *page;
+	int swapcache;
+
+	if (list_empty(remove_pages))
+		return 0;
+
+	page = lru_to_page(remove_pages);
+	mapping = page_mapping(page);
+	swapcache = PageSwapCache(page);
+	freepage = mapping->a_ops->freepage;
+
+	spin_lock_irq(&mapping->tree_lock);
+	while (!list_empty(remove_pages)) {
+		page = lru_to_page(remove_pages);
+		if (__remove_mapping_locked(mapping, page))
+			list_move(&page->lru, &detached);
+		else
+			list_move(&page->lru, &kept);
+	}
+	spin_unlock_irq(&mapping->tree_lock);
+
+	mem_cgroup_uncharge_start();
+	list_for_each_entry(page, &detached, lru) {
+		__remove_mapping_finish(page, swapcache, freepage);
+		/*
+		 * At this point, we have no other references and there is
+		 * no way to pick any more up (removed from LRU, removed
+		 * from pagecache). Can use non-atomic bitops now (and
+		 * we obviously don't have to worry about waking up a process
+		 * waiting on the page lock, because there are no references.
+		 */
+		__clear_page_locked(page);
+		nr_detached++;
+	}
+	mem_cgroup_uncharge_end();
+	list_splice(&detached, free_pages);
+
+	while (!list_empty(&kept)) {
+		page = lru_to_page(&kept);
+		unlock_page(page);
+		reset_reclaim_mode(sc);
+		list_move(&page->lru, ret_pages);
+		VM_BUG_ON(PageLRU(page) || PageUnevictable(page));
+	}
+
+	return nr_detached;
+}
+
 /*
  * shrink_page_list() returns the number of reclaimed pages
  */
@@ -771,6 +874,8 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 {
 	LIST_HEAD(ret_pages);
 	LIST_HEAD(free_pages);
+	LIST_HEAD(remove_pages);
+	struct address_space *remove_pages_mapping = NULL;
 	int pgactivate = 0;
 	unsigned long nr_dirty = 0;
 	unsigned long nr_congested = 0;
@@ -820,9 +925,13 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			 * for the IO to complete.
 			 */
 			if ((sc->reclaim_mode & RECLAIM_MODE_SYNC) &&
-			    may_enter_fs)
+			    may_enter_fs) {
+				/* don't sit on the queued page locks */
+				nr_reclaimed += remove_mapping_batch(
+					&remove_pages, &ret_pages,
+					&free_pages, sc);
 				wait_on_page_writeback(page);
-			else {
+			} else {
 				unlock_page(page);
 				goto keep_lumpy;
 			}
@@ -846,6 +955,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		if (PageAnon(page) && !PageSwapCache(page)) {
 			if (!(sc->gfp_mask & __GFP_IO))
 				goto keep_locked;
+			/*
+			 * add_to_swap() can take fs and page locks, so it
+			 * must not run with the queued pages still locked.
+			 */
+			nr_reclaimed += remove_mapping_batch(&remove_pages,
+					&ret_pages, &free_pages, sc);
 			if (!add_to_swap(page))
 				goto activate_locked;
 			may_enter_fs = 1;
@@ -858,7 +973,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * processes. Try to unmap it here.
 		 */
 		if (page_mapped(page) && mapping) {
-			switch (try_to_unmap(page, TTU_UNMAP)) {
+			switch (try_to_unmap(page, TTU_UNMAP | TTU_BATCH_FLUSH)) {
 			case SWAP_FAIL:
 				goto activate_locked;
 			case SWAP_AGAIN:
@@ -899,7 +1014,15 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			if (!sc->may_writepage)
 				goto keep_locked;
 
-			/* Page is dirty, try to write it out here */
+			/*
+			 * Page is dirty, try to write it out here.  A stale
+			 * TLB entry must not write to it once the IO has
+			 * started, and the queued pages should not stay
+			 * locked across the IO either.
+			 */
+			try_to_unmap_flush_dirty();
+			nr_reclaimed += remove_mapping_batch(&remove_pages,
+					&ret_pages, &free_pages, sc);
 			switch (pageout(page, mapping, sc)) {
 			case PAGE_KEEP:
 				nr_congested++;
@@ -948,6 +1071,9 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * Otherwise, leave the page on the LRU so it is swappable.
 		 */
 		if (page_has_private(page)) {
+			/* ->releasepage can take fs locks, see add_to_swap() */
+			nr_reclaimed += remove_mapping_batch(&remove_pages,
+					&ret_pages, &free_pages, sc);
 			if (!try_to_release_page(page, sc->gfp_mask))
 				goto activate_locked;
 			if (!mapping && page_count(page) == 1) {
@@ -968,17 +1094,23 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping)
 			goto keep_locked;
 
 		/*
-		 * At this point, we have no other references and there is
-		 * no way to pick any more up (removed from LRU, removed
-		 * from pagecache). Can use non-atomic bitops now (and
-		 * we obviously don't have to worry about waking up a process
-		 * waiting on the page lock, because there are no references.
+		 * Queue the page to be removed from its mapping together
+		 * with its neighbours on the list, which usually belong to
+		 * the same file, under a single tree_lock hold.  It stays
+		 * locked until then.
 		 */
-		__clear_page_locked(page);
+		if (mapping != remove_pages_mapping) {
+			nr_reclaimed += remove_mapping_batch(&remove_pages,
+					&ret_pages, &free_pages, sc);
+			remove_pages_mapping = mapping;
+		}
+		list_add(&page->lru, &remove_pages);
+		continue;
+
 free_it:
 		nr_reclaimed++;
 
@@ -1022,6 +1154,11 @@ keep_lumpy:
 	if (nr_dirty && nr_dirty == nr_congested && global_reclaim(sc))
 		zone_set_flag(mz->zone, ZONE_CONGESTED);
 
+	nr_reclaimed += remove_mapping_batch(&remove_pages, &ret_pages,
+					     &free_pages, sc);
+
+	/* no stale TLB entries may be left once the pages are freed */
+	try_to_unmap_flush();
 	free_hot_cold_page_list(&free_pages, 1);
 
 	list_splice(&ret_pages, page_list);
@@ -1996,6 +2133,8 @@ out:
 		scan = zone_nr_lru_pages(mz, lru);
 		if (priority || noswap) {
 			scan >>= priority;
+			if (sc->kswapd_threads > 1)
+				scan = DIV_ROUND_UP(scan, sc->kswapd_threads);
 			if (!scan && force_scan)
 				scan = SWAP_CLUSTER_MAX;
 			scan = div64_u64(scan * fraction[file], denominator);
@@ -2357,12 +2496,15 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		 */
 		if (global_reclaim(sc)) {
 			unsigned long lru_pages = 0;
+
+			nodes_clear(shrink->nodes_to_scan);
 			for_each_zone_zonelist(zone, z, zonelist,
 					gfp_zone(sc->gfp_mask)) {
 				if (!cpuset_zone_allowed_hardwall(zone, GFP_KERNEL))
 					continue;
 
 				lru_pages += zone_reclaimable_pages(zone);
+				node_set(zone_to_nid(zone), shrink->nodes_to_scan);
 			}
 
 			shrink_slab(shrink, sc->nr_scanned, lru_pages);
@@ -2663,7 +2805,7 @@ static bool sleeping_prematurely(pg_data_t *pgdat, int order, long remaining,
  * of pages is balanced across the zones.
  */
 static unsigned long balance_pgdat(pg_data_t *pgdat, int order,
-							int *classzone_idx)
+					int *classzone_idx, int kswapd_id)
 {
 	int all_zones_ok;
 	unsigned long balanced;
@@ -2689,10 +2831,14 @@ static unsigned long balance_pgdat(pg_data_t *pgdat, int order,
 	struct shrink_control shrink = {
 		.gfp_mask = sc.gfp_mask,
 	};
+
+	nodes_clear(shrink.nodes_to_scan);
+	node_set(pgdat->node_id, shrink.nodes_to_scan);
 loop_again:
 	total_scanned = 0;
 	sc.nr_reclaimed = 0;
 	sc.may_writepage = !laptop_mode;
+	sc.kswapd_threads = ACCESS_ONCE(kswapd_threads);
 	count_vm_event(PAGEOUTRUN);
 
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
@@ -2815,6 +2961,8 @@ loop_again:
 				    !zone_watermark_ok_safe(zone, testorder,
 					high_wmark_pages(zone) + balance_gap,
 					end_zone, 0)) {
+				unsigned long nr_reclaimed = sc.nr_reclaimed;
+
 				shrink_zone(priority, zone, &sc);
 
 				reclaim_state->reclaimed_slab = 0;
@@ -2822,6 +2970,11 @@ loop_again:
 				sc.nr_reclaimed += reclaim_state->reclaimed_slab;
 				total_scanned += sc.nr_scanned;
 
+				count_vm_events(KSWAPD_STEAL_THREAD0 + kswapd_id,
+						sc.nr_reclaimed - nr_reclaimed);
+				count_vm_events(KSWAPD_SCAN_THREAD0 + kswapd_id,
+						sc.nr_scanned);
+
 				if (nr_slab == 0 && !zone_reclaimable(zone))
 					zone->all_unreclaimable = 1;
 			}
@@ -2975,6 +3128,30 @@ out:
 	return order;
 }
 
+/*
+ * vmstat counters are not perfectly accurate and the estimated value for
+ * counters such as NR_FREE_PAGES can deviate from the true value by
+ * nr_online_cpus * threshold. To avoid the zone watermarks being breached
+ * while under pressure, we reduce the per-cpu vmstat threshold while kswapd
+ * is awake and restore them before going back to sleep.  With several kswapd
+ * threads per node, the thresholds stay reduced until the last of them goes
+ * to sleep.
+ */
+static void kswapd_set_awake(pg_data_t *pgdat, bool awake)
+{
+	mutex_lock(&kswapd_awake_lock);
+	if (awake) {
+		if (!pgdat->kswapd_awake++)
+			set_pgdat_percpu_threshold(pgdat,
+						   calculate_pressure_threshold);
+	} else {
+		if (!--pgdat->kswapd_awake)
+			set_pgdat_percpu_threshold(pgdat,
+						   calculate_normal_threshold);
+	}
+	mutex_unlock(&kswapd_awake_lock);
+}
+
 static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 {
 	long remaining = 0;
@@ -2999,17 +3176,9 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 	if (!sleeping_prematurely(pgdat, order, remaining, classzone_idx)) {
 		trace_mm_vmscan_kswapd_sleep(pgdat->node_id);
 
-		/*
-		 * vmstat counters are not perfectly accurate and the estimated
-		 * value for counters such as NR_FREE_PAGES can deviate from the
-		 * true value by nr_online_cpus * threshold. To avoid the zone
-		 * watermarks being breached while under pressure, we reduce the
-		 * per-cpu vmstat threshold while kswapd is awake and restore
-		 * them before going back to sleep.
-		 */
-		set_pgdat_percpu_threshold(pgdat, calculate_normal_threshold);
+		kswapd_set_awake(pgdat, false);
 		schedule();
-		set_pgdat_percpu_threshold(pgdat, calculate_pressure_threshold);
+		kswapd_set_awake(pgdat, true);
 	} else {
 		if (remaining)
 			count_vm_event(KSWAPD_LOW_WMARK_HIT_QUICKLY);
@@ -3045,6 +3214,11 @@ static int kswapd(void *p)
 		.reclaimed_slab = 0,
 	};
 	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	int kswapd_id;
+
+	/* kswapd_update() set our slot before waking us up */
+	for (kswapd_id = 0; pgdat->kswapd[kswapd_id] != tsk; kswapd_id++)
+		;
 
 	lockdep_set_current_reclaim_state(GFP_KERNEL);
 
@@ -3066,6 +3240,7 @@ static int kswapd(void *p)
 	 */
 	tsk->flags |= PF_MEMALLOC | PF_SWAPWRITE | PF_KSWAPD;
 	set_freezable();
+	kswapd_set_awake(pgdat, true);
 
 	order = new_order = 0;
 	balanced_order = 0;
@@ -3081,10 +3256,10 @@ static int kswapd(void *p)
 		 */
 		if (balanced_classzone_idx >= new_classzone_idx &&
 					balanced_order == new_order) {
-			new_order = pgdat->kswapd_max_order;
-			new_classzone_idx = pgdat->classzone_idx;
-			pgdat->kswapd_max_order =  0;
-			pgdat->classzone_idx = pgdat->nr_zones - 1;
+			new_order = pgdat->kswapd_max_order[kswapd_id];
+			new_classzone_idx = pgdat->classzone_idx[kswapd_id];
+			pgdat->kswapd_max_order[kswapd_id] =  0;
+			pgdat->classzone_idx[kswapd_id] = pgdat->nr_zones - 1;
 		}
 
 		if (order < new_order || classzone_idx > new_classzone_idx) {
@@ -3096,13 +3271,13 @@ static int kswapd(void *p)
 			classzone_idx = new_classzone_idx;
 		} else {
 			kswapd_try_to_sleep(pgdat, balanced_order,
-						balanced_classzone_idx);
-			order = pgdat->kswapd_max_order;
-			classzone_idx = pgdat->classzone_idx;
+					balanced_classzone_idx);
+			order = pgdat->kswapd_max_order[kswapd_id];
+			classzone_idx = pgdat->classzone_idx[kswapd_id];
 			new_order = order;
 			new_classzone_idx = classzone_idx;
-			pgdat->kswapd_max_order = 0;
-			pgdat->classzone_idx = pgdat->nr_zones - 1;
+			pgdat->kswapd_max_order[kswapd_id] = 0;
+			pgdat->classzone_idx[kswapd_id] = pgdat->nr_zones - 1;
 		}
 
 		ret = try_to_freeze();
@@ -3117,9 +3292,10 @@ static int kswapd(void *p)
 			trace_mm_vmscan_kswapd_wake(pgdat->node_id, order);
 			balanced_classzone_idx = classzone_idx;
 			balanced_order = balance_pgdat(pgdat, order,
-						&balanced_classzone_idx);
+					&balanced_classzone_idx, kswapd_id);
 		}
 	}
+	kswapd_set_awake(pgdat, false);
 	return 0;
 }
 
@@ -3129,6 +3305,7 @@ static int kswapd(void *p)
 void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 {
 	pg_data_t *pgdat;
+	int i;
 
 	if (!populated_zone(zone))
 		return;
@@ -3136,9 +3313,13 @@ void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 	if (!cpuset_zone_allowed_hardwall(zone, GFP_KERNEL))
 		return;
 	pgdat = zone->zone_pgdat;
-	if (pgdat->kswapd_max_order < order) {
-		pgdat->kswapd_max_order = order;
-		pgdat->classzone_idx = min(pgdat->classzone_idx, classzone_idx);
+	/* every thread of the node is woken, so every thread gets the request */
+	for (i = 0; i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd_max_order[i] < order) {
+			pgdat->kswapd_max_order[i] = order;
+			pgdat->classzone_idx[i] = min(pgdat->classzone_idx[i],
+						      classzone_idx);
+		}
 	}
 	if (!waitqueue_active(&pgdat->kswapd_wait))
 		return;
@@ -3234,7 +3415,7 @@ unsigned long shrink_all_memory(unsigned long nr_to_reclaim)
 static int __devinit cpu_callback(struct notifier_block *nfb,
 				  unsigned long action, void *hcpu)
 {
-	int nid;
+	int nid, i;
 
 	if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN) {
 		for_each_node_state(nid, N_HIGH_MEMORY) {
@@ -3243,33 +3424,70 @@ static int __devinit cpu_callback(struct notifier_block *nfb,
 
 			mask = cpumask_of_node(pgdat->node_id);
 
-			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
-				/* One of our CPUs online: restore mask */
-				set_cpus_allowed_ptr(pgdat->kswapd, mask);
+			if (cpumask_any_and(cpu_online_mask, mask) >= nr_cpu_ids)
+				continue;
+
+			/* One of our CPUs online: restore mask */
+			mutex_lock(&kswapd_threads_lock);
+			for (i = 0; i < MAX_KSWAPD_THREADS; i++)
+				if (pgdat->kswapd[i])
+					set_cpus_allowed_ptr(pgdat->kswapd[i],
+							     mask);
+			mutex_unlock(&kswapd_threads_lock);
 		}
 	}
 	return NOTIFY_OK;
 }
 
 /*
- * This kswapd start function will be called by init and node-hot-add.
- * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
+ * Start the first @nr kswapd threads of a node where they are missing and
+ * stop the others.  Called with kswapd_threads_lock held.
  */
-int kswapd_run(int nid)
+static int kswapd_update(int nid, int nr)
 {
 	pg_data_t *pgdat = NODE_DATA(nid);
-	int ret = 0;
+	struct task_struct *tsk;
+	int i;
 
-	if (pgdat->kswapd)
-		return 0;
+	for (i = nr; i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd[i]) {
+			kthread_stop(pgdat->kswapd[i]);
+			pgdat->kswapd[i] = NULL;
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (pgdat->kswapd[i])
+			continue;
 
-	pgdat->kswapd = kthread_run(kswapd, pgdat, "kswapd%d", nid);
-	if (IS_ERR(pgdat->kswapd)) {
-		/* failure at boot is fatal */
-		BUG_ON(system_state == SYSTEM_BOOTING);
-		printk("Failed to start kswapd on node %d\n",nid);
-		ret = -1;
+		if (i == 0)
+			tsk = kthread_create(kswapd, pgdat, "kswapd%d", nid);
+		else
+			tsk = kthread_create(kswapd, pgdat, "kswapd%d:%d",
+					     nid, i);
+		if (IS_ERR(tsk)) {
+			/* failure at boot is fatal */
+			BUG_ON(system_state == SYSTEM_BOOTING);
+			printk("Failed to start kswapd on node %d\n",nid);
+			return -1;
+		}
+		pgdat->kswapd[i] = tsk;
+		wake_up_process(tsk);
 	}
+	return 0;
+}
+
+/*
+ * This kswapd start function will be called by init and node-hot-add.
+ * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
+ */
+int kswapd_run(int nid)
+{
+	int ret;
+
+	mutex_lock(&kswapd_threads_lock);
+	ret = kswapd_update(nid, kswapd_threads);
+	mutex_unlock(&kswapd_threads_lock);
 	return ret;
 }
 
@@ -3278,16 +3496,49 @@ int kswapd_run(int nid)
  */
 void kswapd_stop(int nid)
 {
-	struct task_struct *kswapd = NODE_DATA(nid)->kswapd;
+	mutex_lock(&kswapd_threads_lock);
+	kswapd_update(nid, 0);
+	mutex_unlock(&kswapd_threads_lock);
+}
 
-	if (kswapd)
-		kthread_stop(kswapd);
+/*
+ * vm.kswapd_threads: start or stop kswapd threads on every node with
+ * memory to match the new number.
+ */
+int kswapd_threads_sysctl_handler(ctl_table *table, int write,
+				  void __user *buffer, size_t *length,
+				  loff_t *ppos)
+{
+	int old, ret, nid;
+
+	/* keeps N_HIGH_MEMORY stable, and nests outside kswapd_threads_lock */
+	lock_memory_hotplug();
+	mutex_lock(&kswapd_threads_lock);
+	old = kswapd_threads;
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write || kswapd_threads == old)
+		goto out;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		ret = kswapd_update(nid, kswapd_threads);
+		if (ret) {
+			ret = -ENOMEM;
+			break;
+		}
+	}
+out:
+	mutex_unlock(&kswapd_threads_lock);
+	unlock_memory_hotplug();
+	return ret;
 }
 
 static int __init kswapd_init(void)
 {
 	int nid;
 
+	BUILD_BUG_ON(KSWAPD_STEAL_THREAD7 - KSWAPD_STEAL_THREAD0 + 1 !=
+		     MAX_KSWAPD_THREADS);
+
 	swap_setup();
 	for_each_node_state(nid, N_HIGH_MEMORY)
  		kswapd_run(nid);
@@ -3429,8 +3680,11 @@ static int __zone_reclaim(struct zone *zone, gfp_t gfp_mask, unsigned int order)
 		 * pages.
 		 *
 		 * Note that shrink_slab will free memory on all zones and may
-		 * take a long time.
+		 * take a long time; only caches with per-node lists restrict
+		 * themselves to this zone's node.
 		 */
+		nodes_clear(shrink.nodes_to_scan);
+		node_set(zone_to_nid(zone), shrink.nodes_to_scan);
 		for (;;) {
 			unsigned long lru_pages = zone_reclaimable_pages(zone);
 
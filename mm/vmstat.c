@@ -681,6 +681,9 @@ static void walk_zones_in_node(struct seq_file *m, pg_data_t *pgdat,
 #define TEXTS_FOR_ZONES(xx) TEXT_FOR_DMA(xx) TEXT_FOR_DMA32(xx) xx "_normal", \
 					TEXT_FOR_HIGHMEM(xx) xx "_movable",
 
+#define TEXTS_FOR_KSWAPD_THREADS(xx) xx "0", xx "1", xx "2", xx "3", \
+					xx "4", xx "5", xx "6", xx "7",
+
 const char * const vmstat_text[] = {
 	/* Zoned VM counters */
 	"nr_free_pages",
@@ -752,6 +755,8 @@ const char * const vmstat_text[] = {
 	"kswapd_low_wmark_hit_quickly",
 	"kswapd_high_wmark_hit_quickly",
 	"kswapd_skip_congestion_wait",
+	TEXTS_FOR_KSWAPD_THREADS("kswapd_steal_thread")
+	TEXTS_FOR_KSWAPD_THREADS("kswapd_scan_thread")
 	"pageoutrun",
 	"allocstall",
 
@@ -36,8 +36,10 @@
 #include <asm/uaccess.h>
 #include <asm/unaligned.h>
 #include <linux/filter.h>
+#include <linux/bpf.h>
 #include <linux/reciprocal_div.h>
 #include <linux/ratelimit.h>
+#include <linux/seccomp.h>
 
 /* No hurry in this branch
  *
@@ -65,6 +67,34 @@ static inline void *load_pointer(const struct sk_buff *skb, int k,
 	return bpf_internal_load_pointer_neg_helper(skb, k, size);
 }
 
+/**
+ *	bpf_load_skb - load packet data for eBPF BPF_LD_ABS and BPF_LD_IND
+ *	@skb: buffer to load from
+ *	@k: offset, may be one of the negative SKF_*_OFF based offsets
+ *	@size: 1, 2 or 4 bytes
+ *
+ * Returns the data in host byte order, or ~0ULL if it is not in the
+ * packet, in which case the program stops and returns 0.
+ */
+u64 bpf_load_skb(const struct sk_buff *skb, int k, unsigned int size)
+{
+	u8 buf[4];
+	void *ptr;
+
+	ptr = load_pointer(skb, k, size, buf);
+	if (!ptr)
+		return ~0ULL;
+
+	switch (size) {
+	case 4:
+		return get_unaligned_be32(ptr);
+	case 2:
+		return get_unaligned_be16(ptr);
+	default:
+		return *(u8 *)ptr;
+	}
+}
+
 /**
  *	sk_filter - run a packet through a socket filter
  *	@sk: sock associated with &sk_buff
@@ -352,6 +382,11 @@ load_b:
 				A = 0;
 			continue;
 		}
+#ifdef CONFIG_SECCOMP_FILTER
+		case BPF_S_ANC_SECCOMP_LD_W:
+			A = seccomp_bpf_load(fentry->k);
+			continue;
+#endif
 		default:
 			WARN_RATELIMIT(1, "Unknown code:%u jt:%u tf:%u k:%u\n",
 				       fentry->code, fentry->jt,
@@ -584,7 +619,10 @@ void sk_filter_release_rcu(struct rcu_head *rcu)
 {
 	struct sk_filter *fp = container_of(rcu, struct sk_filter, rcu);
 
-	bpf_jit_free(fp);
+	if (fp->prog)
+		bpf_prog_put(fp->prog);
+	else
+		bpf_jit_free(fp);
 	kfree(fp);
 }
 EXPORT_SYMBOL(sk_filter_release_rcu);
@@ -620,6 +658,7 @@ int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk)
 	atomic_set(&fp->refcnt, 1);
 	fp->len = fprog->len;
 	fp->bpf_func = sk_run_filter;
+	fp->prog = NULL;
 
 	err = sk_chk_filter(fp->insns, fp->len);
 	if (err) {
@@ -639,6 +678,60 @@ int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk)
 }
 EXPORT_SYMBOL_GPL(sk_attach_filter);
 
+/* run the eBPF program of a filter attached with SO_ATTACH_BPF */
+static unsigned int sk_run_bpf_prog(const struct sk_buff *skb,
+				    const struct sock_filter *insns)
+{
+	const struct sk_filter *fp = container_of(insns, struct sk_filter,
+						  insns[0]);
+
+	return BPF_PROG_RUN(fp->prog, skb);
+}
+
+/**
+ *	sk_attach_bpf - attach an eBPF socket filter
+ *	@ufd: file descriptor of a BPF_PROG_TYPE_SOCKET_FILTER program
+ *	@sk: the socket to use
+ *
+ * The program was checked when it was loaded with bpf(BPF_PROG_LOAD).
+ * It gets the skb as context and, like a classic filter, returns the
+ * number of bytes to keep, 0 to drop the packet.
+ */
+int sk_attach_bpf(u32 ufd, struct sock *sk)
+{
+	struct sk_filter *fp, *old_fp;
+	struct bpf_prog *prog;
+
+	prog = bpf_prog_get(ufd);
+	if (IS_ERR(prog))
+		return PTR_ERR(prog);
+
+	if (prog->type != BPF_PROG_TYPE_SOCKET_FILTER) {
+		bpf_prog_put(prog);
+		return -EINVAL;
+	}
+
+	fp = sock_kmalloc(sk, sizeof(*fp), GFP_KERNEL);
+	if (!fp) {
+		bpf_prog_put(prog);
+		return -ENOMEM;
+	}
+
+	atomic_set(&fp->refcnt, 1);
+	fp->len = 0;
+	fp->bpf_func = sk_run_bpf_prog;
+	fp->prog = prog;
+
+	old_fp = rcu_dereference_protected(sk->sk_filter,
+					   sock_owned_by_user(sk));
+	rcu_assign_pointer(sk->sk_filter, fp);
+
+	if (old_fp)
+		sk_filter_uncharge(sk, old_fp);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sk_attach_bpf);
+
 int sk_detach_filter(struct sock *sk)
 {
 	int ret = -ENOENT;
@@ -654,3 +747,98 @@ int sk_detach_filter(struct sock *sk)
 	return ret;
 }
 EXPORT_SYMBOL_GPL(sk_detach_filter);
+
+#ifdef CONFIG_BPF_SYSCALL
+static const struct bpf_func_proto *sk_filter_func_proto(enum bpf_func_id func_id)
+{
+	switch (func_id) {
+	case BPF_FUNC_map_lookup_elem:
+		return &bpf_map_lookup_elem_proto;
+	case BPF_FUNC_map_update_elem:
+		return &bpf_map_update_elem_proto;
+	case BPF_FUNC_map_delete_elem:
+		return &bpf_map_delete_elem_proto;
+	case BPF_FUNC_get_prandom_u32:
+		return &bpf_get_prandom_u32_proto;
+	case BPF_FUNC_get_smp_processor_id:
+		return &bpf_get_smp_processor_id_proto;
+	default:
+		return NULL;
+	}
+}
+
+/* struct __sk_buff is read only and accessed one u32 field at a time */
+static bool sk_filter_is_valid_access(int off, int size,
+				      enum bpf_access_type type)
+{
+	if (type != BPF_READ)
+		return false;
+	if (off < 0 || off >= sizeof(struct __sk_buff))
+		return false;
+	return size == sizeof(__u32) && off % size == 0;
+}
+
+#define SKB_FIELD_LOAD(insn, field)					\
+	do {								\
+		(insn)->code = BPF_LDX | BPF_MEM |			\
+			(FIELD_SIZEOF(struct sk_buff, field) == 4 ?	\
+			 BPF_W : BPF_H);				\
+		(insn)->off = offsetof(struct sk_buff, field);		\
+	} while (0)
+
+static void sk_filter_convert_ctx_access(struct bpf_insn *insn, int ctx_off)
+{
+	switch (ctx_off) {
+	case offsetof(struct __sk_buff, len):
+		SKB_FIELD_LOAD(insn, len);
+		break;
+	case offsetof(struct __sk_buff, mark):
+		SKB_FIELD_LOAD(insn, mark);
+		break;
+	case offsetof(struct __sk_buff, queue_mapping):
+		SKB_FIELD_LOAD(insn, queue_mapping);
+		break;
+	case offsetof(struct __sk_buff, protocol):
+		SKB_FIELD_LOAD(insn, protocol);
+		break;
+	case offsetof(struct __sk_buff, vlan_tci):
+		SKB_FIELD_LOAD(insn, vlan_tci);
+		break;
+	case offsetof(struct __sk_buff, priority):
+		SKB_FIELD_LOAD(insn, priority);
+		break;
+	case offsetof(struct __sk_buff, ingress_ifindex):
+		SKB_FIELD_LOAD(insn, skb_iif);
+		break;
+	case offsetof(struct __sk_buff, hash):
+		SKB_FIELD_LOAD(insn, rxhash);
+		break;
+	}
+}
+
+static const struct bpf_verifier_ops sk_filter_ops = {
+	.get_func_proto		= sk_filter_func_proto,
+	.is_valid_access	= sk_filter_is_valid_access,
+	.convert_ctx_access	= sk_filter_convert_ctx_access,
+	.has_ld_abs		= true,
+};
+
+static struct bpf_prog_type_list sk_filter_type __read_mostly = {
+	.ops	= &sk_filter_ops,
+	.type	= BPF_PROG_TYPE_SOCKET_FILTER,
+};
+
+/* tc classifiers see the same skb context as socket filters */
+static struct bpf_prog_type_list sched_cls_type __read_mostly = {
+	.ops	= &sk_filter_ops,
+	.type	= BPF_PROG_TYPE_SCHED_CLS,
+};
+
+static int __init register_sk_filter_ops(void)
+{
+	bpf_register_prog_type(&sk_filter_type);
+	bpf_register_prog_type(&sched_cls_type);
+	return 0;
+}
+late_initcall(register_sk_filter_ops);
+#endif /* CONFIG_BPF_SYSCALL */
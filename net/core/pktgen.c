@@ -197,6 +197,7 @@
 #define F_QUEUE_MAP_RND (1<<13)	/* queue map Random */
 #define F_QUEUE_MAP_CPU (1<<14)	/* queue map mirrors smp_processor_id() */
 #define F_NODE          (1<<15)	/* Node memory alloc*/
+#define F_QUEUE_XMIT    (1<<16)	/* go through dev_queue_xmit() and the qdisc */
 
 /* Thread control flag bits */
 #define T_STOP        (1<<0)	/* Stop run */
@@ -674,6 +675,9 @@ static int pktgen_if_show(struct seq_file *seq, void *v)
 	if (pkt_dev->flags & F_NODE)
 		seq_printf(seq, "NODE_ALLOC  ");
 
+	if (pkt_dev->flags & F_QUEUE_XMIT)
+		seq_printf(seq, "QUEUE_XMIT  ");
+
 	seq_puts(seq, "\n");
 
 	/* not really stopped, more like last-running-at */
@@ -1235,12 +1239,18 @@ static ssize_t pktgen_if_write(struct file *file,
 		else if (strcmp(f, "!NODE_ALLOC") == 0)
 			pkt_dev->flags &= ~F_NODE;
 
+		else if (strcmp(f, "QUEUE_XMIT") == 0)
+			pkt_dev->flags |= F_QUEUE_XMIT;
+
+		else if (strcmp(f, "!QUEUE_XMIT") == 0)
+			pkt_dev->flags &= ~F_QUEUE_XMIT;
+
 		else {
 			sprintf(pg_result,
 				"Flag -:%s:- unknown\nAvailable flags, (prepend ! to un-set flag):\n%s",
 				f,
 				"IPSRC_RND, IPDST_RND, UDPSRC_RND, UDPDST_RND, "
-				"MACSRC_RND, MACDST_RND, TXSIZE_RND, IPV6, MPLS_RND, VID_RND, SVID_RND, FLOW_SEQ, IPSEC, NODE_ALLOC\n");
+				"MACSRC_RND, MACDST_RND, TXSIZE_RND, IPV6, MPLS_RND, VID_RND, SVID_RND, FLOW_SEQ, IPSEC, NODE_ALLOC, QUEUE_XMIT\n");
 			return count;
 		}
 		sprintf(pg_result, "OK: flags=0x%x", pkt_dev->flags);
@@ -3293,6 +3303,38 @@ static void pktgen_wait_for_skb(struct pktgen_dev *pkt_dev)
 	pkt_dev->idle_acc += ktime_to_ns(ktime_sub(ktime_now(), idle_start));
 }
 
+/*
+ * Hand the packet to dev_queue_xmit(), so that the qdisc and its locking
+ * are part of what is measured.  The queue is picked by the stack (XPS
+ * or the hash), not by the queue_map settings.
+ */
+static void pktgen_queue_xmit(struct pktgen_dev *pkt_dev)
+{
+	int ret;
+
+	atomic_inc(&pkt_dev->skb->users);
+	ret = dev_queue_xmit(pkt_dev->skb);
+
+	/* the skb is consumed whatever happened: build a new one */
+	pkt_dev->last_ok = 1;
+	switch (ret) {
+	case NET_XMIT_SUCCESS:
+		pkt_dev->sofar++;
+		pkt_dev->seq_num++;
+		pkt_dev->tx_bytes += pkt_dev->last_pkt_size;
+		break;
+	case NET_XMIT_DROP:
+	case NET_XMIT_CN:
+	case NET_XMIT_POLICED:
+		pkt_dev->errors++;
+		break;
+	default: /* ENETDOWN and the like */
+		if (net_ratelimit())
+			pr_info("%s xmit error: %d\n", pkt_dev->odevname, ret);
+		pkt_dev->errors++;
+	}
+}
+
 static void pktgen_xmit(struct pktgen_dev *pkt_dev)
 {
 	struct net_device *odev = pkt_dev->odev;
@@ -3316,9 +3358,12 @@ static void pktgen_xmit(struct pktgen_dev *pkt_dev)
 		return;
 	}
 
-	/* If no skb or clone count exhausted then get new one */
+	/* If no skb or clone count exhausted then get new one. A qdisc
+	 * may still hold the last skb, so it is never sent twice then.
+	 */
 	if (!pkt_dev->skb || (pkt_dev->last_ok &&
-			      ++pkt_dev->clone_count >= pkt_dev->clone_skb)) {
+			      (++pkt_dev->clone_count >= pkt_dev->clone_skb ||
+			       (pkt_dev->flags & F_QUEUE_XMIT)))) {
 		/* build a new pkt */
 		kfree_skb(pkt_dev->skb);
 
@@ -3337,6 +3382,11 @@ static void pktgen_xmit(struct pktgen_dev *pkt_dev)
 	if (pkt_dev->delay && pkt_dev->last_ok)
 		spin(pkt_dev, pkt_dev->next_tx);
 
+	if (pkt_dev->flags & F_QUEUE_XMIT) {
+		pktgen_queue_xmit(pkt_dev);
+		goto out;
+	}
+
 	queue_map = skb_get_queue_mapping(pkt_dev->skb);
 	txq = netdev_get_tx_queue(odev, queue_map);
 
@@ -3377,7 +3427,7 @@ static void pktgen_xmit(struct pktgen_dev *pkt_dev)
 	}
 unlock:
 	__netif_tx_unlock_bh(txq);
-
+out:
 	/* If pkt_dev->count is zero, then run forever */
 	if ((pkt_dev->count != 0) && (pkt_dev->sofar >= pkt_dev->count)) {
 		pktgen_wait_for_skb(pkt_dev);
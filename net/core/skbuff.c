@@ -619,6 +619,9 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 #endif
 #endif
 	new->vlan_tci		= old->vlan_tci;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	new->napi_id		= old->napi_id;
+#endif
 
 	skb_copy_secmark(new, old);
 }
@@ -719,6 +722,9 @@ int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
 	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
 		skb_frag_unref(skb, i);
 
+	/* tell the sender that its data did not go out from its own pages */
+	if (uarg->callback == sock_zerocopy_callback)
+		uarg->zerocopy = 0;
 	uarg->callback(uarg);
 
 	/* skb frags point to kernel buffers */
@@ -751,10 +757,8 @@ struct sk_buff *skb_clone(struct sk_buff *skb, gfp_t gfp_mask)
 {
 	struct sk_buff *n;
 
-	if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY) {
-		if (skb_copy_ubufs(skb, gfp_mask))
-			return NULL;
-	}
+	if (skb_orphan_frags(skb, gfp_mask))
+		return NULL;
 
 	n = skb + 1;
 	if (skb->fclone == SKB_FCLONE_ORIG &&
@@ -874,18 +878,17 @@ struct sk_buff *__pskb_copy(struct sk_buff *skb, int headroom, gfp_t gfp_mask)
 	if (skb_shinfo(skb)->nr_frags) {
 		int i;
 
-		if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY) {
-			if (skb_copy_ubufs(skb, gfp_mask)) {
-				kfree_skb(n);
-				n = NULL;
-				goto out;
-			}
+		if (skb_orphan_frags(skb, gfp_mask)) {
+			kfree_skb(n);
+			n = NULL;
+			goto out;
 		}
 		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
 			skb_shinfo(n)->frags[i] = skb_shinfo(skb)->frags[i];
 			skb_frag_ref(skb, i);
 		}
 		skb_shinfo(n)->nr_frags = i;
+		skb_zerocopy_clone(n, skb);
 	}
 
 	if (skb_has_frag_list(skb)) {
@@ -971,10 +974,11 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 		kfree(skb->head);
 	} else {
 		/* copy this zero copy skb frags */
-		if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY) {
-			if (skb_copy_ubufs(skb, gfp_mask))
-				goto nofrags;
-		}
+		if (skb_orphan_frags(skb, gfp_mask))
+			goto nofrags;
+		/* the new head keeps sharing a socket's zerocopy buffer */
+		if (skb_zcopy(skb))
+			atomic_inc(&skb_zcopy(skb)->refcnt);
 		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
 			skb_frag_ref(skb, i);
 
@@ -2258,6 +2262,7 @@ void skb_split(struct sk_buff *skb, struct sk_buff *skb1, const u32 len)
 {
 	int pos = skb_headlen(skb);
 
+	skb_zerocopy_clone(skb1, skb);
 	if (len < pos)	/* Split line is inside header. */
 		skb_split_inside_header(skb, skb1, len, pos);
 	else		/* Second chunk has no header, nothing to copy. */
@@ -2300,6 +2305,10 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 	BUG_ON(shiftlen > skb->len);
 	BUG_ON(skb_headlen(skb));	/* Would corrupt stream */
 
+	/* frags may only move between skbs sharing the same completion */
+	if (skb_zcopy(tgt) || skb_zcopy(skb))
+		return 0;
+
 	todo = shiftlen;
 	from = 0;
 	to = skb_shinfo(tgt)->nr_frags;
@@ -2770,6 +2779,7 @@ struct sk_buff *skb_segment(struct sk_buff *skb, netdev_features_t features)
 		}
 
 		frag = skb_shinfo(nskb)->frags;
+		skb_zerocopy_clone(nskb, skb);
 
 		skb_copy_from_linear_data_offset(skb, offset,
 						 skb_put(nskb, hsize), hsize);
@@ -3184,6 +3194,234 @@ int sock_queue_err_skb(struct sock *sk, struct sk_buff *skb)
 }
 EXPORT_SYMBOL(sock_queue_err_skb);
 
+/*
+ * MSG_ZEROCOPY completion.  The ubuf_info shared by all skbs of one send
+ * call lives in the control block of the skb later queued on the error
+ * queue to tell the sender its pages are no longer referenced.
+ */
+#define skb_from_uarg(uarg) container_of((void *)(uarg), struct sk_buff, cb)
+
+/* Charge pages pinned for transmit against RLIMIT_MEMLOCK */
+static int mm_account_pinned_pages(struct mmpin *mmp, size_t size)
+{
+	unsigned long max_pg, num_pg, new_pg, old_pg;
+	struct user_struct *user;
+
+	if (capable(CAP_IPC_LOCK) || !size)
+		return 0;
+
+	num_pg = (size >> PAGE_SHIFT) + 2;	/* worst case */
+	max_pg = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	user = current_user();
+
+	do {
+		old_pg = atomic_long_read(&user->locked_vm);
+		new_pg = old_pg + num_pg;
+		if (new_pg > max_pg)
+			return -ENOBUFS;
+	} while (atomic_long_cmpxchg(&user->locked_vm, old_pg, new_pg) !=
+		 old_pg);
+
+	mmp->user = get_uid(user);
+	mmp->num_pg = num_pg;
+	return 0;
+}
+
+static void mm_unaccount_pinned_pages(struct mmpin *mmp)
+{
+	if (mmp->user) {
+		atomic_long_sub(mmp->num_pg, &mmp->user->locked_vm);
+		free_uid(mmp->user);
+	}
+}
+
+/**
+ *	sock_zerocopy_alloc - start a zerocopy send call
+ *	@sk: sending socket
+ *	@size: bytes the call may pin
+ *
+ *	Returns the completion to attach to skbs whose frags point to the
+ *	caller's pages, holding one reference for the caller, or %NULL when
+ *	the notification cannot be allocated or the pages cannot be locked.
+ *	Each call takes the next id of the socket; ids are reported on the
+ *	error queue in ranges once all skbs of the calls have been freed.
+ */
+struct ubuf_info *sock_zerocopy_alloc(struct sock *sk, size_t size)
+{
+	struct ubuf_info *uarg;
+	struct sk_buff *skb;
+
+	skb = sock_omalloc(sk, 0, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	BUILD_BUG_ON(sizeof(*uarg) > sizeof(skb->cb));
+	uarg = (void *)skb->cb;
+	uarg->mmp.user = NULL;
+
+	if (mm_account_pinned_pages(&uarg->mmp, size)) {
+		kfree_skb(skb);
+		return NULL;
+	}
+
+	uarg->callback = sock_zerocopy_callback;
+	uarg->id = ((u32)atomic_inc_return(&sk->sk_zckey)) - 1;
+	uarg->len = 1;
+	uarg->zerocopy = 1;
+	atomic_set(&uarg->refcnt, 1);
+	sock_hold(sk);
+
+	return uarg;
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_alloc);
+
+/* Fold [lo, lo + len) into the notification at the error queue tail */
+static bool skb_zerocopy_notify_extend(struct sk_buff *skb, u32 lo, u16 len,
+				       u8 code)
+{
+	struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
+	u32 old_lo, old_hi;
+
+	if (serr->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+	    serr->ee.ee_code != code)
+		return false;
+
+	old_lo = serr->ee.ee_info;
+	old_hi = serr->ee.ee_data;
+	if (lo != old_hi + 1 || (u64)old_hi - old_lo + 1 + len >= (1ULL << 32))
+		return false;
+
+	serr->ee.ee_data += len;
+	return true;
+}
+
+void sock_zerocopy_callback(struct ubuf_info *uarg)
+{
+	struct sk_buff *tail, *skb = skb_from_uarg(uarg);
+	struct sock_exterr_skb *serr;
+	struct sock *sk = skb->sk;
+	struct sk_buff_head *q;
+	unsigned long flags;
+	u32 lo, hi;
+	u16 len;
+	u8 code;
+
+	if (!atomic_dec_and_test(&uarg->refcnt))
+		return;
+
+	mm_unaccount_pinned_pages(&uarg->mmp);
+
+	/* no len: the only call of this range was aborted, nothing to tell */
+	if (!uarg->len || sock_flag(sk, SOCK_DEAD))
+		goto release;
+
+	len = uarg->len;
+	lo = uarg->id;
+	hi = uarg->id + len - 1;
+	code = uarg->zerocopy ? 0 : SO_EE_CODE_ZEROCOPY_COPIED;
+
+	/* the control block now turns from ubuf_info into sock_exterr_skb */
+	serr = SKB_EXT_ERR(skb);
+	memset(serr, 0, sizeof(*serr));
+	serr->ee.ee_errno = 0;
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_code = code;
+	serr->ee.ee_info = lo;
+	serr->ee.ee_data = hi;
+
+	q = &sk->sk_error_queue;
+	spin_lock_irqsave(&q->lock, flags);
+	tail = skb_peek_tail(q);
+	if (!tail || !skb_zerocopy_notify_extend(tail, lo, len, code)) {
+		__skb_queue_tail(q, skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	sk->sk_error_report(sk);
+
+release:
+	consume_skb(skb);
+	sock_put(sk);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_callback);
+
+/**
+ *	sock_zerocopy_put_abort - give back the id of a failed send call
+ *	@uarg: completion from sock_zerocopy_alloc(), or %NULL
+ *
+ *	Must only be used when no skb took a reference on @uarg, so that the
+ *	call reports nothing and the next one reuses its id.
+ */
+void sock_zerocopy_put_abort(struct ubuf_info *uarg)
+{
+	if (uarg) {
+		struct sock *sk = skb_from_uarg(uarg)->sk;
+
+		atomic_dec(&sk->sk_zckey);
+		uarg->len--;
+		sock_zerocopy_put(uarg);
+	}
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put_abort);
+
+/**
+ *	skb_zerocopy_add_frags - append user pages to a skb without copying
+ *	@sk: socket the skb is charged to
+ *	@skb: buffer to append to, without frags of another zerocopy call
+ *	@from: user address of the data
+ *	@len: bytes to append
+ *	@uarg: completion of the send call
+ *
+ *	Pins the pages under @from and appends them as frags, as far as the
+ *	free frag slots allow.  Returns the number of bytes appended or a
+ *	negative error when none could be.
+ */
+int skb_zerocopy_add_frags(struct sock *sk, struct sk_buff *skb,
+			   const void __user *from, int len,
+			   struct ubuf_info *uarg)
+{
+	struct page *pages[MAX_SKB_FRAGS];
+	unsigned long addr = (unsigned long)from;
+	int i = skb_shinfo(skb)->nr_frags;
+	int n, pinned, copied = 0;
+
+	n = DIV_ROUND_UP(offset_in_page(addr) + len, PAGE_SIZE);
+	n = min_t(int, n, MAX_SKB_FRAGS - i);
+	if (n <= 0)
+		return -EMSGSIZE;
+
+	pinned = get_user_pages_fast(addr, n, 0, pages);
+	if (pinned <= 0)
+		return pinned ? : -EFAULT;
+
+	for (n = 0; n < pinned; n++) {
+		int off = offset_in_page(addr);
+		int size = min_t(int, len, PAGE_SIZE - off);
+
+		if (skb_can_coalesce(skb, i, pages[n], off)) {
+			skb_frag_size_add(&skb_shinfo(skb)->frags[i - 1], size);
+			put_page(pages[n]);
+		} else {
+			skb_fill_page_desc(skb, i++, pages[n], off, size);
+		}
+		addr += size;
+		len -= size;
+		copied += size;
+	}
+
+	skb->len	     += copied;
+	skb->data_len	     += copied;
+	skb->truesize	     += copied;
+	sk->sk_wmem_queued   += copied;
+	sk_mem_charge(sk, copied);
+
+	if (!skb_zcopy(skb))
+		skb_zcopy_set(skb, uarg);
+	return copied;
+}
+EXPORT_SYMBOL_GPL(skb_zerocopy_add_frags);
+
 void skb_tstamp_tx(struct sk_buff *orig_skb,
 		struct skb_shared_hwtstamps *hwtstamps)
 {
@@ -24,8 +24,12 @@
 #include <linux/proc_fs.h>
 #include <linux/err.h>
 #include <linux/cpumask.h>
+#include <linux/jhash.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
 
 #include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/xt_tcpudp.h>
 #include <linux/netfilter_ipv4/ip_tables.h>
 #include <net/netfilter/nf_log.h>
 #include "../../netfilter/xt_repldata.h"
@@ -284,6 +288,559 @@ struct ipt_entry *ipt_next_entry(const struct ipt_entry *entry)
 	return (void *)entry + entry->next_offset;
 }
 
+#ifdef CONFIG_IP_NF_IPTABLES_CLASSIFY
+/*
+ * Compiled classifier.
+ *
+ * When a table is loaded, runs of consecutive rules that only look at
+ * the ip header (plus tcp/udp ports and comments) are compiled into a
+ * tuple space classifier: the rules of a run are grouped by which
+ * fields they match exactly (source/destination mask, protocol,
+ * destination port) and each group is a hash table of rule lists.
+ * ipt_do_table() then jumps from the start of a run straight to the
+ * first rule of the run that matches, instead of evaluating each one.
+ *
+ * A run never contains a rule whose evaluation has side effects, and
+ * every place where the traversal can enter the middle of the rules
+ * (hook entries, underflows, jump targets, return points and rules
+ * following a target that may continue) starts a new run, so skipping
+ * the rules the classifier rules out gives the same verdict, counters
+ * and traces as the linear walk.
+ */
+
+static unsigned int classify_min_rules __read_mostly = 8;
+module_param(classify_min_rules, uint, 0644);
+MODULE_PARM_DESC(classify_min_rules,
+		 "Shortest run of rules to compile at table load (0 = never)");
+
+#define IPT_CLS_NONE		0xFFFFFFFFU
+/* each group costs a hash lookup, split runs rather than grow them */
+#define IPT_CLS_MAX_GROUPS	32
+
+struct ipt_cls_rule {
+	u32		offset;		/* of the entry in the table */
+	u32		next;		/* next rule with the same key */
+};
+
+struct ipt_cls_group {
+	__be32		smsk;
+	__be32		dmsk;
+	u8		proto;		/* key includes the protocol */
+	u8		port;		/* key includes the destination port */
+	u32		first;		/* first rule of the group */
+};
+
+struct ipt_cls_node {
+	__be32		src;
+	__be32		dst;
+	__be16		dport;
+	u8		proto;
+	u32		group;
+	u32		first;		/* first rule with this key */
+	u32		last;
+	u32		next;		/* next node in the hash bucket */
+};
+
+struct ipt_cls_run {
+	u32		start;		/* offset of the first rule */
+	u32		end;		/* offset of the rule after the run */
+	u32		rule;		/* index of the first rule */
+	u32		nrules;
+	u32		group;		/* index of the first group */
+	u32		ngroups;
+};
+
+struct ipt_classifier {
+	unsigned int		nruns;
+	unsigned int		hmask;
+	unsigned long		*starts;	/* run starts, see ipt_cls_slot() */
+	struct ipt_cls_run	*runs;
+	struct ipt_cls_group	*groups;
+	struct ipt_cls_rule	*rules;
+	struct ipt_cls_node	*nodes;
+	u32			*buckets;
+};
+
+/* Header fields of the packet, extracted on first use */
+struct ipt_cls_pkt {
+	__be32		saddr;
+	__be32		daddr;
+	__be16		dport;
+	u8		proto;
+	u8		state;
+};
+
+enum {
+	IPT_CLS_PKT_UNSET,
+	IPT_CLS_PKT_PORT,	/* dport is valid */
+	IPT_CLS_PKT_NOPORT,
+	IPT_CLS_PKT_OFF,	/* a skipped rule might hotdrop, walk them */
+};
+
+/* entries are at least sizeof(struct ipt_entry) apart */
+static inline unsigned int ipt_cls_slot(unsigned int offset)
+{
+	return offset / sizeof(struct ipt_entry);
+}
+
+static inline u32 ipt_cls_hash(const struct ipt_classifier *cls,
+			       __be32 src, __be32 dst, u8 proto, __be16 dport,
+			       u32 group)
+{
+	return jhash_3words((__force u32)src, (__force u32)dst,
+			    ((__force u32)dport << 8) | proto,
+			    group) & cls->hmask;
+}
+
+/* Can the rule be skipped without evaluating it, and what does it key on */
+static bool ipt_cls_rule_ok(const struct ipt_entry *e,
+			    struct ipt_cls_group *g, struct ipt_cls_node *n)
+{
+	const struct xt_entry_match *ematch;
+	const struct ipt_ip *ip = &e->ip;
+	bool port = false;
+
+	memset(g, 0, sizeof(*g));
+	memset(n, 0, sizeof(*n));
+
+	xt_ematch_foreach(ematch, e) {
+		const struct xt_match *m = ematch->u.kernel.match;
+		u16 dpts[2];
+		u8 inv;
+
+		if (strcmp(m->name, "comment") == 0)
+			continue;
+		if (port || m->revision != 0)
+			return false;
+		if (strcmp(m->name, "tcp") == 0) {
+			const struct xt_tcp *tcp = (const void *)ematch->data;
+
+			/* option parsing can hotdrop */
+			if (tcp->option)
+				return false;
+			dpts[0] = tcp->dpts[0];
+			dpts[1] = tcp->dpts[1];
+			inv = tcp->invflags & XT_TCP_INV_DSTPT;
+		} else if (strcmp(m->name, "udp") == 0) {
+			const struct xt_udp *udp = (const void *)ematch->data;
+
+			dpts[0] = udp->dpts[0];
+			dpts[1] = udp->dpts[1];
+			inv = udp->invflags & XT_UDP_INV_DSTPT;
+		} else
+			return false;
+
+		port = true;
+		if (dpts[0] == dpts[1] && !inv) {
+			g->port = 1;
+			n->dport = htons(dpts[0]);
+		}
+	}
+
+	if (!(ip->invflags & IPT_INV_SRCIP)) {
+		g->smsk = ip->smsk.s_addr;
+		n->src = ip->src.s_addr;
+	}
+	if (!(ip->invflags & IPT_INV_DSTIP)) {
+		g->dmsk = ip->dmsk.s_addr;
+		n->dst = ip->dst.s_addr;
+	}
+	if (ip->proto && !(ip->invflags & IPT_INV_PROTO)) {
+		g->proto = 1;
+		n->proto = ip->proto;
+	}
+	/* tcp/udp check the protocol is set, so the port implies it */
+	return true;
+}
+
+/*
+ * Mark the jump target of a rule as an entry point, and return whether
+ * the traversal can go on with the rule after it once it matched.
+ */
+static bool ipt_cls_mark_target(struct ipt_entry *e, unsigned int offset,
+				unsigned long *starts, unsigned int size)
+{
+	const struct xt_entry_target *t = ipt_get_target(e);
+	int v;
+
+	if (t->u.kernel.target->target)
+		return true;
+
+	v = ((struct xt_standard_target *)t)->verdict;
+	if (v < 0)
+		return false;
+	if ((unsigned int)v < size)
+		__set_bit(ipt_cls_slot(v), starts);
+	return !(e->ip.flags & IPT_F_GOTO) || offset + e->next_offset == v;
+}
+
+/* Number of rules that can share a run with e, 0 if e cannot be compiled */
+static unsigned int ipt_cls_run_len(const struct xt_table_info *info,
+				    void *entry0, struct ipt_entry *e,
+				    const unsigned long *starts)
+{
+	struct ipt_cls_group g;
+	struct ipt_cls_node key;
+	unsigned int n = 0;
+
+	while ((void *)e < entry0 + info->size &&
+	       ipt_cls_rule_ok(e, &g, &key) &&
+	       (n == 0 || !test_bit(ipt_cls_slot((void *)e - entry0), starts))) {
+		e = ipt_next_entry(e);
+		n++;
+	}
+	return n;
+}
+
+static void ipt_cls_add_rule(struct ipt_classifier *cls, struct ipt_cls_run *run,
+			     unsigned int *nnodes, const struct ipt_cls_group *g,
+			     const struct ipt_cls_node *key, u32 rule)
+{
+	struct ipt_cls_node *n;
+	u32 group, i, h;
+
+	for (group = run->group; group < run->group + run->ngroups; group++) {
+		const struct ipt_cls_group *gi = &cls->groups[group];
+
+		if (gi->smsk == g->smsk && gi->dmsk == g->dmsk &&
+		    gi->proto == g->proto && gi->port == g->port)
+			break;
+	}
+	if (group == run->group + run->ngroups) {
+		cls->groups[group] = *g;
+		cls->groups[group].first = rule;
+		run->ngroups++;
+	}
+
+	h = ipt_cls_hash(cls, key->src, key->dst, key->proto, key->dport,
+			 group);
+	for (i = cls->buckets[h]; i != IPT_CLS_NONE; i = cls->nodes[i].next) {
+		n = &cls->nodes[i];
+		if (n->group == group && n->src == key->src &&
+		    n->dst == key->dst && n->proto == key->proto &&
+		    n->dport == key->dport) {
+			/* rules are added in order, keep the list sorted */
+			cls->rules[n->last].next = rule;
+			n->last = rule;
+			return;
+		}
+	}
+
+	n = &cls->nodes[(*nnodes)++];
+	*n = *key;
+	n->group = group;
+	n->first = n->last = rule;
+	n->next = cls->buckets[h];
+	cls->buckets[h] = n - cls->nodes;
+}
+
+/* Start a run at e, after the previous one if it was split */
+static struct ipt_cls_run *ipt_cls_new_run(struct ipt_classifier *cls,
+					   unsigned int offset, u32 rule)
+{
+	struct ipt_cls_run *run = &cls->runs[cls->nruns++];
+
+	run->start = offset;
+	run->rule = rule;
+	run->group = run > cls->runs ? run[-1].group + run[-1].ngroups : 0;
+	__set_bit(ipt_cls_slot(offset), cls->starts);
+	return run;
+}
+
+static void ipt_cls_build(struct xt_table_info *info, void *entry0)
+{
+	struct ipt_classifier *cls;
+	struct ipt_cls_group g;
+	struct ipt_cls_node key;
+	struct ipt_entry *e;
+	unsigned long *starts;
+	unsigned int nslots, nrules, hsize, nnodes, len, n, i;
+	bool cont;
+	void *p;
+
+	if (classify_min_rules == 0 || info->number < classify_min_rules)
+		return;
+
+	/* Mark where the traversal can enter the rules */
+	nslots = ipt_cls_slot(info->size) + 1;
+	starts = kcalloc(BITS_TO_LONGS(nslots), sizeof(long), GFP_KERNEL);
+	if (!starts)
+		return;
+	for (i = 0; i < NF_INET_NUMHOOKS; i++) {
+		if (info->hook_entry[i] < info->size)
+			__set_bit(ipt_cls_slot(info->hook_entry[i]), starts);
+		if (info->underflow[i] < info->size)
+			__set_bit(ipt_cls_slot(info->underflow[i]), starts);
+	}
+	cont = false;
+	xt_entry_foreach(e, entry0, info->size) {
+		if (cont)
+			__set_bit(ipt_cls_slot((void *)e - entry0), starts);
+		cont = ipt_cls_mark_target(e, (void *)e - entry0, starts,
+					   info->size);
+	}
+
+	/* Count the rules in runs long enough to be worth compiling */
+	nrules = 0;
+	for (e = entry0; (void *)e < entry0 + info->size; ) {
+		n = ipt_cls_run_len(info, entry0, e, starts);
+		if (n >= classify_min_rules)
+			nrules += n;
+		for (i = 0; i < max(n, 1U); i++)
+			e = ipt_next_entry(e);
+	}
+	if (nrules == 0)
+		goto out;
+
+	/*
+	 * Every run, group and key has at least one rule; runs are split
+	 * when they have too many groups.
+	 */
+	hsize = roundup_pow_of_two(2 * nrules);
+	len = ALIGN(sizeof(*cls), sizeof(long)) +
+	      BITS_TO_LONGS(nslots) * sizeof(long) +
+	      nrules * (sizeof(struct ipt_cls_run) +
+			sizeof(struct ipt_cls_group) +
+			sizeof(struct ipt_cls_rule) +
+			sizeof(struct ipt_cls_node)) +
+	      hsize * sizeof(u32);
+	if (len <= PAGE_SIZE)
+		p = kzalloc(len, GFP_KERNEL);
+	else
+		p = vzalloc(len);
+	if (!p)
+		goto out;
+
+	cls = p;
+	p += ALIGN(sizeof(*cls), sizeof(long));
+	cls->starts = p;
+	p += BITS_TO_LONGS(nslots) * sizeof(long);
+	cls->runs = p;
+	p += nrules * sizeof(struct ipt_cls_run);
+	cls->groups = p;
+	p += nrules * sizeof(struct ipt_cls_group);
+	cls->rules = p;
+	p += nrules * sizeof(struct ipt_cls_rule);
+	cls->nodes = p;
+	p += nrules * sizeof(struct ipt_cls_node);
+	cls->buckets = p;
+	cls->hmask = hsize - 1;
+	memset(cls->buckets, 0xFF, hsize * sizeof(u32));
+
+	nrules = nnodes = 0;
+	for (e = entry0; (void *)e < entry0 + info->size; ) {
+		struct ipt_cls_run *run = NULL;
+
+		n = ipt_cls_run_len(info, entry0, e, starts);
+		if (n < classify_min_rules) {
+			for (i = 0; i < max(n, 1U); i++)
+				e = ipt_next_entry(e);
+			continue;
+		}
+
+		for (i = 0; i < n; i++, e = ipt_next_entry(e)) {
+			unsigned int offset = (void *)e - entry0;
+
+			if (run && run->ngroups == IPT_CLS_MAX_GROUPS) {
+				run->end = offset;
+				run = NULL;
+			}
+			if (!run)
+				run = ipt_cls_new_run(cls, offset, nrules);
+
+			ipt_cls_rule_ok(e, &g, &key);
+			cls->rules[nrules].offset = offset;
+			cls->rules[nrules].next = IPT_CLS_NONE;
+			ipt_cls_add_rule(cls, run, &nnodes, &g, &key, nrules);
+			run->nrules++;
+			nrules++;
+		}
+		run->end = (void *)e - entry0;
+	}
+
+	info->classifier = cls;
+out:
+	kfree(starts);
+}
+
+static const struct ipt_cls_run *
+ipt_cls_find_run(const struct ipt_classifier *cls, unsigned int offset)
+{
+	unsigned int lo = 0, hi = cls->nruns;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (cls->runs[mid].start == offset)
+			return &cls->runs[mid];
+		if (cls->runs[mid].start < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+static bool ipt_cls_pkt_init(struct ipt_cls_pkt *pkt, const struct sk_buff *skb,
+			     const struct iphdr *ip,
+			     const struct xt_action_param *par)
+{
+	const __be16 *ports;
+	__be16 _ports[2];
+	unsigned int hlen;
+
+	pkt->saddr = ip->saddr;
+	pkt->daddr = ip->daddr;
+	pkt->proto = ip->protocol;
+	pkt->dport = 0;
+	pkt->state = IPT_CLS_PKT_NOPORT;
+
+	switch (ip->protocol) {
+	case IPPROTO_TCP:
+		/* tcp_mt() drops these, let it see them */
+		if (par->fragoff == 1)
+			goto off;
+		hlen = sizeof(struct tcphdr);
+		break;
+	case IPPROTO_UDP:
+		hlen = sizeof(struct udphdr);
+		break;
+	default:
+		return true;
+	}
+	if (par->fragoff)
+		return true;
+
+	/* a header the matches cannot read makes them drop the packet */
+	if (skb->len < par->thoff + hlen)
+		goto off;
+	ports = skb_header_pointer(skb, par->thoff, sizeof(_ports), _ports);
+	if (!ports)
+		goto off;
+	pkt->dport = ports[1];
+	pkt->state = IPT_CLS_PKT_PORT;
+	return true;
+off:
+	pkt->state = IPT_CLS_PKT_OFF;
+	return false;
+}
+
+static bool ipt_cls_match(const struct ipt_entry *e, const struct sk_buff *skb,
+			  const struct iphdr *ip, const char *indev,
+			  const char *outdev, struct xt_action_param *par)
+{
+	const struct xt_entry_match *ematch;
+
+	if (!ip_packet_match(ip, indev, outdev, &e->ip, par->fragoff))
+		return false;
+	xt_ematch_foreach(ematch, e) {
+		par->match     = ematch->u.kernel.match;
+		par->matchinfo = ematch->data;
+		if (!par->match->match(skb, par))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Called when the traversal reaches a rule.  If it starts a compiled
+ * run, returns the first rule of the run that matches the packet, or
+ * moves *pe past the run and its successors when none does.
+ */
+static struct ipt_entry *
+ipt_cls_find(const struct xt_table_info *private, const void *table_base,
+	     struct ipt_entry **pe, struct ipt_cls_pkt *pkt,
+	     const struct sk_buff *skb, const struct iphdr *ip,
+	     const char *indev, const char *outdev,
+	     struct xt_action_param *par)
+{
+	const struct ipt_classifier *cls = private->classifier;
+	unsigned int offset = (void *)*pe - table_base;
+
+	if (pkt->state == IPT_CLS_PKT_OFF)
+		return NULL;
+	while (test_bit(ipt_cls_slot(offset), cls->starts)) {
+		const struct ipt_cls_run *run = ipt_cls_find_run(cls, offset);
+		const struct ipt_cls_group *g, *gend;
+		u32 best = run->rule + run->nrules;
+
+		if (pkt->state == IPT_CLS_PKT_UNSET &&
+		    !ipt_cls_pkt_init(pkt, skb, ip, par))
+			return NULL;
+
+		gend = &cls->groups[run->group + run->ngroups];
+		for (g = &cls->groups[run->group]; g < gend; g++) {
+			__be32 src = pkt->saddr & g->smsk;
+			__be32 dst = pkt->daddr & g->dmsk;
+			u8 proto = g->proto ? pkt->proto : 0;
+			__be16 dport = 0;
+			u32 i, r;
+
+			/* groups are sorted by their first rule */
+			if (g->first >= best)
+				break;
+			if (g->port) {
+				if (pkt->state != IPT_CLS_PKT_PORT)
+					continue;
+				dport = pkt->dport;
+			}
+
+			i = cls->buckets[ipt_cls_hash(cls, src, dst, proto, dport,
+						      g - cls->groups)];
+			for (; i != IPT_CLS_NONE; i = cls->nodes[i].next) {
+				const struct ipt_cls_node *n = &cls->nodes[i];
+
+				if (n->group != g - cls->groups ||
+				    n->src != src || n->dst != dst ||
+				    n->proto != proto || n->dport != dport)
+					continue;
+				for (r = n->first; r < best;
+				     r = cls->rules[r].next) {
+					struct ipt_entry *e;
+
+					e = get_entry(table_base,
+						      cls->rules[r].offset);
+					if (ipt_cls_match(e, skb, ip, indev,
+							  outdev, par)) {
+						best = r;
+						break;
+					}
+				}
+				break;
+			}
+		}
+
+		if (best < run->rule + run->nrules)
+			return get_entry(table_base, cls->rules[best].offset);
+
+		offset = run->end;
+		*pe = get_entry(table_base, offset);
+	}
+	return NULL;
+}
+
+#else
+struct ipt_cls_pkt {
+	u8		state;
+};
+
+#define IPT_CLS_PKT_UNSET	0
+
+static inline void ipt_cls_build(struct xt_table_info *info, void *entry0)
+{
+}
+
+static inline struct ipt_entry *
+ipt_cls_find(const struct xt_table_info *private, const void *table_base,
+	     struct ipt_entry **pe, struct ipt_cls_pkt *pkt,
+	     const struct sk_buff *skb, const struct iphdr *ip,
+	     const char *indev, const char *outdev,
+	     struct xt_action_param *par)
+{
+	return NULL;
+}
+#endif /* CONFIG_IP_NF_IPTABLES_CLASSIFY */
+
 /* Returns one of the generic firewall policies, like NF_ACCEPT. */
 unsigned int
 ipt_do_table(struct sk_buff *skb,
@@ -302,6 +859,7 @@ ipt_do_table(struct sk_buff *skb,
 	unsigned int *stackptr, origptr, cpu;
 	const struct xt_table_info *private;
 	struct xt_action_param acpar;
+	struct ipt_cls_pkt pkt;
 	unsigned int addend;
 
 	/* Initialization */
@@ -321,6 +879,7 @@ ipt_do_table(struct sk_buff *skb,
 	acpar.out     = out;
 	acpar.family  = NFPROTO_IPV4;
 	acpar.hooknum = hook;
+	pkt.state     = IPT_CLS_PKT_UNSET;
 
 	IP_NF_ASSERT(table->valid_hooks & (1 << hook));
 	local_bh_disable();
@@ -343,6 +902,16 @@ ipt_do_table(struct sk_buff *skb,
 		const struct xt_entry_match *ematch;
 
 		IP_NF_ASSERT(e);
+		if (private->classifier) {
+			struct ipt_entry *hit;
+
+			hit = ipt_cls_find(private, table_base, &e, &pkt,
+					   skb, ip, indev, outdev, &acpar);
+			if (hit) {
+				e = hit;
+				goto matched;
+			}
+		}
 		if (!ip_packet_match(ip, indev, outdev,
 		    &e->ip, acpar.fragoff)) {
  no_match:
@@ -356,7 +925,7 @@ ipt_do_table(struct sk_buff *skb,
 			if (!acpar.match->match(skb, &acpar))
 				goto no_match;
 		}
-
+ matched:
 		ADD_COUNTER(e->counters, skb->len, 1);
 
 		t = ipt_get_target(e);
@@ -414,6 +983,7 @@ ipt_do_table(struct sk_buff *skb,
 		verdict = t->u.kernel.target->target(skb, &acpar);
 		/* Target might have changed stuff. */
 		ip = ip_hdr(skb);
+		pkt.state = IPT_CLS_PKT_UNSET;
 		if (verdict == XT_CONTINUE)
 			e = ipt_next_entry(e);
 		else
@@ -863,6 +1433,8 @@ translate_table(struct net *net, struct xt_table_info *newinfo, void *entry0,
 		return ret;
 	}
 
+	ipt_cls_build(newinfo, entry0);
+
 	/* And one copy for every other CPU */
 	for_each_possible_cpu(i) {
 		if (newinfo->entries[i] && newinfo->entries[i] != entry0)
@@ -1762,6 +2334,8 @@ translate_compat_table(struct net *net,
 		return ret;
 	}
 
+	ipt_cls_build(newinfo, entry1);
+
 	/* And one copy for every other CPU */
 	for_each_possible_cpu(i)
 		if (newinfo->entries[i] && newinfo->entries[i] != entry1)
@@ -0,0 +1,179 @@
+/*
+ * net/netfilter/nf_conntrack_bench.c
+ *
+ * Conntrack insert/delete stress benchmark.  One kernel thread per CPU
+ * creates batches of distinct TCP conntracks in init_net, inserts them
+ * in the hash table, looks each one up by its reply tuple and kills it
+ * again.  This takes the same bucket locks, expectation lock and
+ * per-cpu lists as connection setup and teardown do on the packet
+ * path, so running it with an increasing number of cpus shows how
+ * conntrack scales with the connection rate, e.g.
+ *
+ *	modprobe nf_conntrack_bench cpus=8 batch=64
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/kbench.h>
+#include <linux/sched.h>
+#include <linux/in.h>
+#include <net/net_namespace.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_zones.h>
+
+static int cpus;
+module_param(cpus, int, 0);
+MODULE_PARM_DESC(cpus, "Number of CPUs to run on (default: all online)");
+
+static int loops = 10000;
+module_param(loops, int, 0);
+MODULE_PARM_DESC(loops, "Number of batches each thread inserts and deletes");
+
+static int batch = 16;
+module_param(batch, int, 0);
+MODULE_PARM_DESC(batch, "Number of conntracks held before they are killed");
+
+/* 10.<thread>.<slot>:<loop> -> 10.255.0.1:80, unique while alive */
+static void bench_tuples(struct nf_conntrack_tuple *orig,
+			 struct nf_conntrack_tuple *repl,
+			 int id, int slot, int loop)
+{
+	memset(orig, 0, sizeof(*orig));
+	orig->src.l3num = AF_INET;
+	orig->src.u3.ip = htonl(0x0a000000 | ((id & 0xff) << 16) |
+				(slot & 0xffff));
+	orig->src.u.tcp.port = htons(1024 + (loop & 0x7fff));
+	orig->dst.u3.ip = htonl(0x0aff0001);
+	orig->dst.u.tcp.port = htons(80);
+	orig->dst.protonum = IPPROTO_TCP;
+	orig->dst.dir = IP_CT_DIR_ORIGINAL;
+
+	memset(repl, 0, sizeof(*repl));
+	repl->src.l3num = AF_INET;
+	repl->src.u3.ip = orig->dst.u3.ip;
+	repl->src.u.tcp.port = orig->dst.u.tcp.port;
+	repl->dst.u3.ip = orig->src.u3.ip;
+	repl->dst.u.tcp.port = orig->src.u.tcp.port;
+	repl->dst.protonum = IPPROTO_TCP;
+	repl->dst.dir = IP_CT_DIR_REPLY;
+}
+
+static int bench_batch(struct kbench_thread *t, int loop)
+{
+	struct nf_conn **cts = t->data;
+	struct nf_conntrack_tuple orig, repl;
+	struct nf_conntrack_tuple_hash *h;
+	struct nf_conn *ct;
+	int i, err = 0;
+
+	for (i = 0; i < batch; i++) {
+		bench_tuples(&orig, &repl, t->id, i, loop);
+		ct = nf_conntrack_alloc(&init_net, NF_CT_DEFAULT_ZONE,
+					&orig, &repl, GFP_KERNEL);
+		if (IS_ERR(ct)) {
+			err = PTR_ERR(ct);
+			break;
+		}
+		ct->timeout.expires = jiffies + 600 * HZ;
+		ct->status |= IPS_CONFIRMED;
+		err = nf_conntrack_hash_check_insert(ct);
+		if (err < 0) {
+			nf_conntrack_free(ct);
+			break;
+		}
+		cts[i] = ct;
+
+		h = nf_conntrack_find_get(&init_net, NF_CT_DEFAULT_ZONE, &repl);
+		if (h != &ct->tuplehash[IP_CT_DIR_REPLY]) {
+			if (h)
+				nf_ct_put(nf_ct_tuplehash_to_ctrack(h));
+			err = -ENOENT;
+			i++;
+			break;
+		}
+		nf_ct_put(ct);
+	}
+
+	/* drop the hash table reference, then the one from alloc */
+	while (i--) {
+		nf_ct_kill(cts[i]);
+		nf_ct_put(cts[i]);
+	}
+	return err;
+}
+
+static int bench_fn(struct kbench_thread *t)
+{
+	int i, err = 0;
+
+	for (i = 0; i < loops && !err; i++) {
+		err = bench_batch(t, i);
+		cond_resched();
+	}
+	return err;
+}
+
+static int __init nf_conntrack_bench_init(void)
+{
+	struct kbench_thread *threads;
+	u64 ns, ops;
+	int nr, i, err = 0;
+
+	/* thread ids and slots are encoded in the source address */
+	if (loops <= 0 || batch <= 0 || batch > 0x10000 || cpus < 0)
+		return -EINVAL;
+
+	get_online_cpus();
+
+	nr = min(num_online_cpus(), 256U);
+	if (cpus && cpus < nr)
+		nr = cpus;
+
+	threads = kcalloc(nr, sizeof(*threads), GFP_KERNEL);
+	if (!threads) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < nr; i++) {
+		threads[i].data = kcalloc(batch, sizeof(struct nf_conn *),
+					  GFP_KERNEL);
+		if (!threads[i].data) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	err = kbench_run(threads, nr, bench_fn, "nf_conntrack_bench", &ns);
+	if (err) {
+		printk(KERN_ERR "nf_conntrack_bench: insert failed: %d\n", err);
+		goto out_free;
+	}
+
+	ops = (u64)loops * batch;
+	printk(KERN_INFO "nf_conntrack_bench: %d threads, %u buckets, "
+	       "%llu ns per insert+lookup+delete, %llu conns/sec\n",
+	       nr, init_net.ct.htable_size, div64_u64(ns, ops),
+	       ns ? div64_u64(ops * nr * NSEC_PER_SEC, ns) : 0);
+
+out_free:
+	for (i = 0; i < nr; i++)
+		kfree(threads[i].data);
+	kfree(threads);
+out:
+	put_online_cpus();
+
+	return kbench_init_result(err);
+}
+
+module_init(nf_conntrack_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Conntrack insert/delete stress benchmark");
@@ -720,6 +720,11 @@ void xt_free_table_info(struct xt_table_info *info)
 	else
 		kfree(info->jumpstack);
 
+	if (is_vmalloc_addr(info->classifier))
+		vfree(info->classifier);
+	else
+		kfree(info->classifier);
+
 	free_percpu(info->stackptr);
 
 	kfree(info);
@@ -25,6 +25,7 @@
 #include <linux/rcupdate.h>
 #include <linux/list.h>
 #include <linux/slab.h>
+#include <linux/log2.h>
 #include <net/pkt_sched.h>
 #include <net/dst.h>
 
@@ -37,6 +38,10 @@
  * - enqueue, dequeue are serialized via qdisc root lock
  * - ingress filtering is also serialized via qdisc root lock
  * - updates to tree and tree walking are only done under the rtnl mutex.
+ *
+ * TCQ_F_NOLOCK qdiscs are the exception: their enqueue is safe against
+ * concurrent callers and dequeue is serialized by __QDISC_STATE_RUNNING
+ * alone, so neither takes the root lock.
  */
 
 static inline int dev_requeue_skb(struct sk_buff *skb, struct Qdisc *q)
@@ -118,7 +123,8 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 	int ret = NETDEV_TX_BUSY;
 
 	/* And release qdisc */
-	spin_unlock(root_lock);
+	if (root_lock)
+		spin_unlock(root_lock);
 
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
 	if (!netif_xmit_frozen_or_stopped(txq))
@@ -126,7 +132,8 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 
 	HARD_TX_UNLOCK(dev, txq);
 
-	spin_lock(root_lock);
+	if (root_lock)
+		spin_lock(root_lock);
 
 	if (dev_xmit_complete(ret)) {
 		/* Driver sent out skb successfully or skb was consumed */
@@ -150,7 +157,8 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 }
 
 /*
- * NOTE: Called under qdisc_lock(q) with locally disabled BH.
+ * NOTE: Called under qdisc_lock(q) with locally disabled BH, or with BH
+ * only disabled for a TCQ_F_NOLOCK qdisc.
  *
  * __QDISC_STATE_RUNNING guarantees only one CPU can process
  * this qdisc at a time. qdisc_lock(q) serializes queue accesses for
@@ -180,7 +188,7 @@ static inline int qdisc_restart(struct Qdisc *q)
 	if (unlikely(!skb))
 		return 0;
 	WARN_ON_ONCE(skb_dst_is_noref(skb));
-	root_lock = qdisc_lock(q);
+	root_lock = (q->flags & TCQ_F_NOLOCK) ? NULL : qdisc_lock(q);
 	dev = qdisc_dev(q);
 	txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
 
@@ -190,6 +198,14 @@ static inline int qdisc_restart(struct Qdisc *q)
 void __qdisc_run(struct Qdisc *q)
 {
 	int quota = weight_p;
+	bool nolock = q->flags & TCQ_F_NOLOCK;
+
+again:
+	/* a deactivated lockless qdisc is reset once nobody runs it */
+	if (nolock && unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
+		qdisc_run_end(q);
+		return;
+	}
 
 	while (qdisc_restart(q)) {
 		/*
@@ -199,11 +215,19 @@ void __qdisc_run(struct Qdisc *q)
 		 */
 		if (--quota <= 0 || need_resched()) {
 			__netif_schedule(q);
+			nolock = false;
 			break;
 		}
 	}
 
 	qdisc_run_end(q);
+
+	/* Enqueues that found us running may have come too late for the
+	 * loop above; they left __QDISC_STATE_MISSED to say so.
+	 */
+	if (nolock && test_and_clear_bit(__QDISC_STATE_MISSED, &q->state) &&
+	    qdisc_run_begin(q))
+		goto again;
 }
 
 unsigned long dev_trans_start(struct net_device *dev)
@@ -545,6 +569,243 @@ struct Qdisc_ops pfifo_fast_ops __read_mostly = {
 };
 EXPORT_SYMBOL(pfifo_fast_ops);
 
+/* Lockless FIFO: the default per-queue qdisc below mq.
+ *
+ * Senders reserve a slot of a bounded ring with cmpxchg on the tail and
+ * publish their skb through the slot's sequence number, so enqueue never
+ * takes the qdisc lock; whoever holds __QDISC_STATE_RUNNING is the only
+ * one taking skbs out.  Senders only share the tail cache line, which is
+ * cheap on multiqueue devices where XPS keeps few CPUs per queue.  A
+ * single ring rather than one per CPU keeps the packets of a flow in
+ * order when its sender migrates.
+ *
+ * The consumer takes up to PFIFO_LL_BATCH skbs at a time, handing their
+ * slots back and refreshing the queue length and drop count once per
+ * batch instead of once per packet.
+ */
+
+#define PFIFO_LL_BATCH		16
+#define PFIFO_LL_MIN_LIMIT	64
+#define PFIFO_LL_MAX_LIMIT	65536
+
+struct pfifo_ll_cell {
+	unsigned long		seq;
+	struct sk_buff		*skb;
+};
+
+struct pfifo_ll_ring {
+	unsigned long		tail;		/* senders */
+	atomic_long_t		drops;
+
+	unsigned long		head ____cacheline_aligned_in_smp;
+	unsigned long		mask;
+	unsigned int		next, count;
+	struct sk_buff		*batch[PFIFO_LL_BATCH];
+
+	struct pfifo_ll_cell	cells[0] ____cacheline_aligned_in_smp;
+};
+
+struct pfifo_lockless_priv {
+	struct pfifo_ll_ring	*ring;
+};
+
+static int pfifo_lockless_enqueue(struct sk_buff *skb, struct Qdisc *qdisc)
+{
+	struct pfifo_lockless_priv *priv = qdisc_priv(qdisc);
+	struct pfifo_ll_ring *r = priv->ring;
+	struct pfifo_ll_cell *cell;
+	unsigned long pos, old;
+	long diff;
+
+	pos = ACCESS_ONCE(r->tail);
+	for (;;) {
+		cell = &r->cells[pos & r->mask];
+		diff = (long)(ACCESS_ONCE(cell->seq) - pos);
+		if (diff == 0) {
+			old = cmpxchg(&r->tail, pos, pos + 1);
+			if (old == pos)
+				break;
+			pos = old;
+		} else if (diff < 0) {
+			/* the consumer has not freed this slot yet: full */
+			atomic_long_inc(&r->drops);
+			kfree_skb(skb);
+			return NET_XMIT_DROP;
+		} else {
+			pos = ACCESS_ONCE(r->tail);
+		}
+	}
+
+	cell->skb = skb;
+	smp_wmb();
+	cell->seq = pos + 1;
+	return NET_XMIT_SUCCESS;
+}
+
+static unsigned int pfifo_ll_refill(struct Qdisc *qdisc,
+				    struct pfifo_ll_ring *r)
+{
+	unsigned long pos = r->head;
+	struct pfifo_ll_cell *cell;
+	unsigned int i, n = 0;
+
+	while (n < PFIFO_LL_BATCH) {
+		cell = &r->cells[pos & r->mask];
+		if (ACCESS_ONCE(cell->seq) != pos + 1)
+			break;
+		smp_rmb();
+		r->batch[n++] = cell->skb;
+		pos++;
+	}
+
+	if (n) {
+		/* read the skbs before the senders may reuse their slots */
+		smp_mb();
+		for (i = 0; i < n; i++) {
+			cell = &r->cells[(r->head + i) & r->mask];
+			cell->seq = r->head + i + r->mask + 1;
+		}
+		r->head = pos;
+	}
+	r->next = 0;
+	r->count = n;
+
+	qdisc->q.qlen = n + (ACCESS_ONCE(r->tail) - pos);
+	qdisc->qstats.drops = atomic_long_read(&r->drops);
+	return n;
+}
+
+static struct sk_buff *pfifo_lockless_dequeue(struct Qdisc *qdisc)
+{
+	struct pfifo_lockless_priv *priv = qdisc_priv(qdisc);
+	struct pfifo_ll_ring *r = priv->ring;
+	struct sk_buff *skb;
+
+	if (r->next == r->count && !pfifo_ll_refill(qdisc, r))
+		return NULL;
+
+	skb = r->batch[r->next++];
+	if (qdisc->q.qlen)
+		qdisc->q.qlen--;
+	qdisc_bstats_update(qdisc, skb);
+	return skb;
+}
+
+static struct sk_buff *pfifo_lockless_peek(struct Qdisc *qdisc)
+{
+	struct pfifo_lockless_priv *priv = qdisc_priv(qdisc);
+	struct pfifo_ll_ring *r = priv->ring;
+
+	if (r->next == r->count && !pfifo_ll_refill(qdisc, r))
+		return NULL;
+
+	return r->batch[r->next];
+}
+
+/* Only called once nobody runs the qdisc; senders may still enqueue */
+static void pfifo_lockless_reset(struct Qdisc *qdisc)
+{
+	struct pfifo_lockless_priv *priv = qdisc_priv(qdisc);
+	struct pfifo_ll_ring *r = priv->ring;
+
+	if (!r)
+		return;
+
+	do {
+		while (r->next < r->count)
+			kfree_skb(r->batch[r->next++]);
+	} while (pfifo_ll_refill(qdisc, r));
+
+	qdisc->qstats.backlog = 0;
+	qdisc->q.qlen = 0;
+}
+
+static void pfifo_lockless_destroy(struct Qdisc *qdisc)
+{
+	struct pfifo_lockless_priv *priv = qdisc_priv(qdisc);
+
+	kfree(priv->ring);
+}
+
+static int pfifo_lockless_dump(struct Qdisc *qdisc, struct sk_buff *skb)
+{
+	struct pfifo_lockless_priv *priv = qdisc_priv(qdisc);
+	struct tc_fifo_qopt opt = { .limit = priv->ring->mask + 1 };
+
+	qdisc->qstats.drops = atomic_long_read(&priv->ring->drops);
+	NLA_PUT(skb, TCA_OPTIONS, sizeof(opt), &opt);
+	return skb->len;
+
+nla_put_failure:
+	return -1;
+}
+
+static int pfifo_lockless_init(struct Qdisc *qdisc, struct nlattr *opt)
+{
+	struct pfifo_lockless_priv *priv = qdisc_priv(qdisc);
+	struct net_device *dev = qdisc_dev(qdisc);
+	struct pfifo_ll_ring *r;
+	unsigned long i, limit;
+
+#ifdef CONFIG_NET_SCHED
+	/*
+	 * Senders do not account q.qlen and backlog, the dequeuer only
+	 * refreshes a snapshot of them.  Classful parents need exact
+	 * counts to activate their classes, so only the root and mq may
+	 * have us as a child.  mq itself is not visible yet while it
+	 * creates its default children.
+	 */
+	if (qdisc->parent != TC_H_ROOT) {
+		struct Qdisc *parent = qdisc_lookup(dev,
+						    TC_H_MAJ(qdisc->parent));
+
+		if (parent && !(parent->flags & TCQ_F_MQROOT))
+			return -EOPNOTSUPP;
+	}
+#endif
+
+	if (opt) {
+		struct tc_fifo_qopt *ctl = nla_data(opt);
+
+		if (nla_len(opt) < sizeof(*ctl))
+			return -EINVAL;
+		limit = ctl->limit;
+	} else {
+		limit = dev->tx_queue_len;
+	}
+	limit = clamp_t(unsigned long, limit,
+			PFIFO_LL_MIN_LIMIT, PFIFO_LL_MAX_LIMIT);
+	limit = roundup_pow_of_two(limit);
+
+	r = kzalloc_node(sizeof(*r) + limit * sizeof(r->cells[0]), GFP_KERNEL,
+			 netdev_queue_numa_node_read(qdisc->dev_queue));
+	if (!r)
+		return -ENOMEM;
+
+	r->mask = limit - 1;
+	for (i = 0; i < limit; i++)
+		r->cells[i].seq = i;
+	atomic_long_set(&r->drops, 0);
+	priv->ring = r;
+
+	qdisc->flags |= TCQ_F_NOLOCK;
+	return 0;
+}
+
+struct Qdisc_ops pfifo_lockless_ops __read_mostly = {
+	.id		=	"pfifo_lockless",
+	.priv_size	=	sizeof(struct pfifo_lockless_priv),
+	.enqueue	=	pfifo_lockless_enqueue,
+	.dequeue	=	pfifo_lockless_dequeue,
+	.peek		=	pfifo_lockless_peek,
+	.init		=	pfifo_lockless_init,
+	.reset		=	pfifo_lockless_reset,
+	.destroy	=	pfifo_lockless_destroy,
+	.dump		=	pfifo_lockless_dump,
+	.owner		=	THIS_MODULE,
+};
+EXPORT_SYMBOL(pfifo_lockless_ops);
+
 struct Qdisc *qdisc_alloc(struct netdev_queue *dev_queue,
 			  struct Qdisc_ops *ops)
 {
@@ -782,8 +1043,23 @@ static void dev_deactivate_queue(struct net_device *dev,
 			set_bit(__QDISC_STATE_DEACTIVATED, &qdisc->state);
 
 		rcu_assign_pointer(dev_queue->qdisc, qdisc_default);
-		qdisc_reset(qdisc);
+		if (!(qdisc->flags & TCQ_F_NOLOCK))
+			qdisc_reset(qdisc);
+
+		spin_unlock_bh(qdisc_lock(qdisc));
+	}
+}
+
+/* Lockless qdiscs may still be dequeued from until they stop running */
+static void dev_reset_queue(struct net_device *dev,
+			    struct netdev_queue *dev_queue,
+			    void *_unused)
+{
+	struct Qdisc *qdisc = dev_queue->qdisc_sleeping;
 
+	if (qdisc && (qdisc->flags & TCQ_F_NOLOCK)) {
+		spin_lock_bh(qdisc_lock(qdisc));
+		qdisc_reset(qdisc);
 		spin_unlock_bh(qdisc_lock(qdisc));
 	}
 }
@@ -846,9 +1122,11 @@ void dev_deactivate_many(struct list_head *head)
 		synchronize_net();
 
 	/* Wait for outstanding qdisc_run calls. */
-	list_for_each_entry(dev, head, unreg_list)
+	list_for_each_entry(dev, head, unreg_list) {
 		while (some_qdisc_is_busy(dev))
 			yield();
+		netdev_for_each_tx_queue(dev, dev_reset_queue, NULL);
+	}
 }
 
 void dev_deactivate(struct net_device *dev)
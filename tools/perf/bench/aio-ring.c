@@ -0,0 +1,305 @@
+/*
+ *
+ * aio-ring.c
+ *
+ * ring: Benchmark for submitting AIO through the io_setup_ring() submission
+ * queue, compared to passing iocb arrays to io_submit()
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+#ifndef __NR_io_setup_ring
+# if defined(__x86_64__)
+#  define __NR_io_setup		206
+#  define __NR_io_destroy	207
+#  define __NR_io_getevents	208
+#  define __NR_io_submit	209
+#  define __NR_io_setup_ring	312
+# elif defined(__i386__)
+#  define __NR_io_setup		245
+#  define __NR_io_destroy	246
+#  define __NR_io_getevents	247
+#  define __NR_io_submit	248
+#  define __NR_io_setup_ring	349
+# else
+#  define __NR_io_setup_ring	272	/* asm-generic */
+# endif
+#endif
+
+#ifndef AIO_SETUP_SQRING
+#define AIO_SETUP_SQRING	(1 << 0)
+#define AIO_SETUP_SQPOLL	(1 << 1)
+#define AIO_RING_COMPAT_SQRING	(1 << 1)
+#define AIO_SQ_NEED_WAKEUP	(1 << 0)
+
+struct aio_sq_ring {
+	__u32		head;
+	__u32		tail;
+	__u32		mask;
+	__u32		flags;
+	__u32		dropped;
+	__u32		reserved[11];
+
+	struct iocb	iocbs[0];
+};
+#endif
+
+#define aio_mb()	__sync_synchronize()
+
+/* the kernel's struct aio_ring, which is not exported */
+struct aio_cq_ring {
+	unsigned	id;
+	unsigned	nr;
+	unsigned	head;
+	unsigned	tail;
+
+	unsigned	magic;
+	unsigned	compat_features;
+	unsigned	incompat_features;
+	unsigned	header_length;
+
+	struct io_event	io_events[0];
+};
+
+static int		loops = 100000;
+static int		batch = 32;
+static int		block_size = 512;
+static const char	*filename = "/tmp";
+static bool		use_sqpoll;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of batches to submit"),
+	OPT_INTEGER('b', "batch", &batch,
+		    "Specify number of iocbs per batch"),
+	OPT_INTEGER('s', "size", &block_size,
+		    "Specify size of each write in bytes"),
+	OPT_STRING('d', "dir", &filename, "dir",
+		   "Directory to create the scratch file in"),
+	OPT_BOOLEAN('p', "sqpoll", &use_sqpoll,
+		    "Also run with a kernel thread polling the queue (needs root)"),
+	OPT_END()
+};
+
+static const char * const bench_aio_ring_usage[] = {
+	"perf bench aio ring <options>",
+	NULL
+};
+
+static char *buf;
+
+static long io_setup_ring(unsigned nr, unsigned flags, aio_context_t *ctx)
+{
+	return syscall(__NR_io_setup_ring, nr, flags, ctx);
+}
+
+static void prep_write(struct iocb *iocb, int fd, int i)
+{
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->aio_lio_opcode = IOCB_CMD_PWRITE;
+	iocb->aio_fildes = fd;
+	iocb->aio_buf = (unsigned long)buf;
+	iocb->aio_nbytes = block_size;
+	iocb->aio_offset = (__s64)i * block_size;
+	iocb->aio_data = i;
+}
+
+/* reap nr completions straight from the mapped completion ring */
+static void reap_ring(aio_context_t ctx, int nr)
+{
+	struct aio_cq_ring *ring = (struct aio_cq_ring *)ctx;
+	unsigned head = ring->head;
+
+	while (nr) {
+		unsigned tail = *(volatile unsigned *)&ring->tail;
+
+		rmb();
+		while (head != tail && nr) {
+			if (ring->io_events[head].res != block_size) {
+				fprintf(stderr, "aio write failed: %lld\n",
+					(long long)ring->io_events[head].res);
+				exit(1);
+			}
+			head = (head + 1) % ring->nr;
+			nr--;
+		}
+		aio_mb();
+		ring->head = head;
+		if (nr)
+			cpu_relax();
+	}
+}
+
+static void run_io_submit(int fd)
+{
+	struct iocb *iocbs = calloc(batch, sizeof(*iocbs));
+	struct iocb **iocbpp = calloc(batch, sizeof(*iocbpp));
+	struct io_event *events = calloc(batch, sizeof(*events));
+	aio_context_t ctx = 0;
+	int i, j, done;
+
+	if (!iocbs || !iocbpp || !events)
+		die("calloc");
+	if (syscall(__NR_io_setup, batch, &ctx))
+		die("io_setup");
+
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < batch; j++) {
+			prep_write(&iocbs[j], fd, j);
+			iocbpp[j] = &iocbs[j];
+		}
+		if (syscall(__NR_io_submit, ctx, batch, iocbpp) != batch)
+			die("io_submit");
+		for (done = 0; done < batch; )
+			done += syscall(__NR_io_getevents, ctx, batch - done,
+					batch - done, events, NULL);
+	}
+
+	syscall(__NR_io_destroy, ctx);
+	free(events);
+	free(iocbpp);
+	free(iocbs);
+}
+
+static int run_sq_ring(int fd, unsigned flags)
+{
+	struct aio_cq_ring *ring;
+	struct aio_sq_ring *sq;
+	aio_context_t ctx = 0;
+	size_t off, pagesize = sysconf(_SC_PAGESIZE);
+	int i, j;
+
+	if (io_setup_ring(batch, flags, &ctx)) {
+		fprintf(stderr, "io_setup_ring: %s\n", strerror(errno));
+		return -1;
+	}
+
+	ring = (struct aio_cq_ring *)ctx;
+	if (!(ring->compat_features & AIO_RING_COMPAT_SQRING))
+		die("no submission queue mapped");
+
+	off = ring->header_length + ring->nr * sizeof(struct io_event);
+	off = (off + pagesize - 1) & ~(pagesize - 1);
+	sq = (struct aio_sq_ring *)(ctx + off);
+
+	for (i = 0; i < loops; i++) {
+		unsigned tail = sq->tail;
+
+		for (j = 0; j < batch; j++)
+			prep_write(&sq->iocbs[tail++ & sq->mask], fd, j);
+		aio_mb();
+		sq->tail = tail;
+		aio_mb();
+
+		if (!(flags & AIO_SETUP_SQPOLL)) {
+			if (syscall(__NR_io_submit, ctx, batch, NULL) != batch)
+				die("io_submit");
+		} else if (sq->flags & AIO_SQ_NEED_WAKEUP) {
+			syscall(__NR_io_submit, ctx, 0, NULL);
+		}
+
+		reap_ring(ctx, batch);
+	}
+
+	syscall(__NR_io_destroy, ctx);
+	return 0;
+}
+
+static void print_result(const char *name, struct timeval *diff)
+{
+	unsigned long long result_usec;
+	double ios = (double)loops * batch;
+
+	result_usec = diff->tv_sec * 1000000ULL + diff->tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %lu.%03lu [sec]\n", name,
+		       diff->tv_sec, (unsigned long)(diff->tv_usec / 1000));
+		printf(" %14lf usecs/io\n", (double)result_usec / ios);
+		printf(" %14d ios/sec\n\n",
+		       (int)(ios / ((double)result_usec / 1000000.0)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %lu.%03lu\n", name, diff->tv_sec,
+		       (unsigned long)(diff->tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_aio_ring(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	char path[PATH_MAX];
+	int fd;
+
+	argc = parse_options(argc, argv, options,
+			     bench_aio_ring_usage, 0);
+
+	if (batch <= 0 || loops <= 0 || block_size <= 0)
+		usage_with_options(bench_aio_ring_usage, options);
+
+	buf = zalloc(block_size);
+	if (!buf)
+		die("zalloc");
+
+	snprintf(path, sizeof(path), "%s/perf-bench-aio-XXXXXX", filename);
+	fd = mkstemp(path);
+	if (fd < 0)
+		die("mkstemp %s: %s", path, strerror(errno));
+	unlink(path);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# Submitting %d batches of %d %d-byte writes\n\n",
+		       loops, batch, block_size);
+
+	gettimeofday(&start, NULL);
+	run_io_submit(fd);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	print_result("io_submit", &diff);
+
+	gettimeofday(&start, NULL);
+	if (!run_sq_ring(fd, AIO_SETUP_SQRING)) {
+		gettimeofday(&stop, NULL);
+		timersub(&stop, &start, &diff);
+		print_result("sq ring", &diff);
+	}
+
+	if (use_sqpoll) {
+		gettimeofday(&start, NULL);
+		if (!run_sq_ring(fd, AIO_SETUP_SQPOLL)) {
+			gettimeofday(&stop, NULL);
+			timersub(&stop, &start, &diff);
+			print_result("sq poll", &diff);
+		}
+	}
+
+	close(fd);
+	free(buf);
+	return 0;
+}
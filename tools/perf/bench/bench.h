@@ -1,10 +1,36 @@
 #ifndef BENCH_H
 #define BENCH_H
 
+#include <pthread.h>
+
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
 extern int bench_mem_memset(int argc, const char **argv, const char *prefix);
+extern int bench_aio_ring(int argc, const char **argv, const char *prefix);
+extern int bench_futex_hash(int argc, const char **argv, const char *prefix);
+extern int bench_ipc_semop(int argc, const char **argv, const char *prefix);
+extern int bench_fs_create(int argc, const char **argv, const char *prefix);
+
+/*
+ * Helper for benchmarks that run the same loop in a number of threads for
+ * a fixed time: bench_run_threads() starts all threads at once, stops them
+ * after runtime seconds and prints the throughput of all of them.  The
+ * loop runs until bench_threads_done is set and returns the number of
+ * operations it did.
+ */
+struct bench_worker {
+	pthread_t		thread;
+	int			id;
+	unsigned long		ops;
+	void			*priv;
+};
+
+typedef unsigned long (*bench_worker_fn)(struct bench_worker *w);
+
+extern volatile int bench_threads_done;
+extern void bench_run_threads(struct bench_worker *worker, int nthreads,
+			      int runtime, bench_worker_fn fn);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
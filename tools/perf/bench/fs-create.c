@@ -0,0 +1,118 @@
+/*
+ *
+ * fs-create.c
+ *
+ * create: Benchmark for file creation and unlink: every thread creates
+ * and removes small files in its own directory, so the threads do not
+ * share a parent directory and mostly contend on the global inode
+ * structures (inode hash, superblock inode list).
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+static int		nthreads;
+static int		batch = 128;
+static int		runtime = 5;
+static const char	*basedir = ".";
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: number of CPUs)"),
+	OPT_INTEGER('b', "batch", &batch,
+		    "Specify number of files created before they are unlinked"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_STRING('d', "directory", &basedir, "dir",
+		   "Specify directory to create the files in"),
+	OPT_END()
+};
+
+static const char * const bench_fs_create_usage[] = {
+	"perf bench fs create <options>",
+	NULL
+};
+
+static unsigned long fs_create_loop(struct bench_worker *w)
+{
+	const char *dir = w->priv;
+	char path[PATH_MAX];
+	unsigned long ops = 0;
+	int i, fd;
+
+	while (!bench_threads_done) {
+		for (i = 0; i < batch; i++) {
+			snprintf(path, sizeof(path), "%s/%d", dir, i);
+			fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0600);
+			if (fd < 0)
+				die("open %s: %s", path, strerror(errno));
+			close(fd);
+		}
+		for (i = 0; i < batch; i++) {
+			snprintf(path, sizeof(path), "%s/%d", dir, i);
+			if (unlink(path))
+				die("unlink %s: %s", path, strerror(errno));
+		}
+		ops += 2 * batch;
+	}
+	return ops;
+}
+
+int bench_fs_create(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	struct bench_worker *worker;
+	char *dirs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_fs_create_usage, 0);
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0 || batch <= 0 || runtime <= 0)
+		usage_with_options(bench_fs_create_usage, options);
+
+	worker = calloc(nthreads, sizeof(*worker));
+	dirs = calloc(nthreads, PATH_MAX);
+	if (!worker || !dirs)
+		die("calloc");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads creating and unlinking %d files each "
+		       "in %s, for %d secs\n\n",
+		       nthreads, batch, basedir, runtime);
+
+	for (i = 0; i < nthreads; i++) {
+		char *dir = dirs + i * PATH_MAX;
+
+		snprintf(dir, PATH_MAX, "%s/perf-bench-fs.%d.%d",
+			 basedir, getpid(), i);
+		if (mkdir(dir, 0700))
+			die("mkdir %s: %s", dir, strerror(errno));
+		worker[i].priv = dir;
+	}
+
+	bench_run_threads(worker, nthreads, runtime, fs_create_loop);
+
+	for (i = 0; i < nthreads; i++)
+		rmdir(worker[i].priv);
+
+	free(dirs);
+	free(worker);
+	return 0;
+}
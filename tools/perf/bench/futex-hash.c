@@ -0,0 +1,115 @@
+/*
+ *
+ * futex-hash.c
+ *
+ * hash: Benchmark for futex hash bucket contention: every thread
+ * issues FUTEX_WAKE on its own set of futexes, so the only thing they
+ * can collide on is the kernel's futex hash.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifndef __NR_futex
+# if defined(__x86_64__)
+#  define __NR_futex		202
+# elif defined(__i386__)
+#  define __NR_futex		240
+# else
+#  define __NR_futex		98	/* asm-generic */
+# endif
+#endif
+
+#ifndef FUTEX_PRIVATE_FLAG
+#define FUTEX_PRIVATE_FLAG	128
+#endif
+
+static int		nthreads;
+static int		nfutexes = 1024;
+static int		runtime = 5;
+static bool		fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: number of CPUs)"),
+	OPT_INTEGER('f', "futexes", &nfutexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_BOOLEAN('s', "shared", &fshared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+static unsigned long futex_hash_loop(struct bench_worker *w)
+{
+	int *futex = w->priv;
+	int op = FUTEX_WAKE | (fshared ? 0 : FUTEX_PRIVATE_FLAG);
+	unsigned long ops = 0;
+	int i;
+
+	while (!bench_threads_done) {
+		for (i = 0; i < nfutexes; i++) {
+			/* nobody waits, so this is just hash + bucket lock */
+			if (syscall(__NR_futex, &futex[i], op, 1,
+				    NULL, NULL, 0) < 0)
+				die("futex: %s", strerror(errno));
+		}
+		ops += nfutexes;
+	}
+	return ops;
+}
+
+int bench_futex_hash(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct bench_worker *worker;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_hash_usage, 0);
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0 || nfutexes <= 0 || runtime <= 0)
+		usage_with_options(bench_futex_hash_usage, options);
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		die("calloc");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads, %d %s futexes each, for %d secs\n\n",
+		       nthreads, nfutexes, fshared ? "shared" : "private",
+		       runtime);
+
+	for (i = 0; i < nthreads; i++) {
+		worker[i].priv = calloc(nfutexes, sizeof(int));
+		if (!worker[i].priv)
+			die("calloc");
+	}
+
+	bench_run_threads(worker, nthreads, runtime, futex_hash_loop);
+
+	for (i = 0; i < nthreads; i++)
+		free(worker[i].priv);
+	free(worker);
+	return 0;
+}
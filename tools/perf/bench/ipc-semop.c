@@ -0,0 +1,114 @@
+/*
+ *
+ * ipc-semop.c
+ *
+ * semop: Benchmark for SysV semaphore scalability: every thread works
+ * on its own semaphore of one shared semaphore set, so the only thing
+ * they can collide on is the locking of the set itself.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+
+static int		nthreads;
+static int		nsems = 256;
+static int		runtime = 5;
+static int		complex_every;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: number of CPUs)"),
+	OPT_INTEGER('n', "nsems", &nsems,
+		    "Specify number of semaphores in the set"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_INTEGER('c', "complex", &complex_every,
+		    "Make every Nth operation a two-semaphore semop (0: never)"),
+	OPT_END()
+};
+
+static const char * const bench_ipc_semop_usage[] = {
+	"perf bench ipc semop <options>",
+	NULL
+};
+
+static int		semid;
+
+static unsigned long ipc_semop_loop(struct bench_worker *w)
+{
+	/* spread the threads over the set */
+	int semnum = (int)((long long)w->id * nsems / nthreads);
+	struct sembuf up[2], down[2];
+	unsigned long ops = 0;
+	int nsops;
+
+	/* the second sop only turns this into a complex operation */
+	up[0].sem_num = down[0].sem_num = semnum;
+	up[1].sem_num = down[1].sem_num = (semnum + 1) % nsems;
+	up[0].sem_op = 1;
+	down[0].sem_op = -1;
+	up[1].sem_op = down[1].sem_op = 0;
+	up[0].sem_flg = up[1].sem_flg = 0;
+	down[0].sem_flg = down[1].sem_flg = IPC_NOWAIT;
+
+	while (!bench_threads_done) {
+		nsops = (complex_every && !(ops % complex_every)) ? 2 : 1;
+
+		if (semop(semid, up, 1) ||
+		    semop(semid, down, nsops)) {
+			/* a neighbour's wait-for-zero sop may not be met */
+			if (errno == EAGAIN && nsops == 2) {
+				if (semop(semid, down, 1))
+					die("semop: %s", strerror(errno));
+			} else
+				die("semop: %s", strerror(errno));
+		}
+		ops += 2;
+	}
+	return ops;
+}
+
+int bench_ipc_semop(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	struct bench_worker *worker;
+
+	argc = parse_options(argc, argv, options,
+			     bench_ipc_semop_usage, 0);
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0 || nsems <= 0 || runtime <= 0 || complex_every < 0)
+		usage_with_options(bench_ipc_semop_usage, options);
+
+	semid = semget(IPC_PRIVATE, nsems, IPC_CREAT | 0600);
+	if (semid < 0)
+		die("semget: %s", strerror(errno));
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		die("calloc");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads on a set of %d semaphores, for %d secs\n\n",
+		       nthreads, nsems, runtime);
+
+	bench_run_threads(worker, nthreads, runtime, ipc_semop_loop);
+
+	semctl(semid, 0, IPC_RMID);
+
+	free(worker);
+	return 0;
+}
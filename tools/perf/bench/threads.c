@@ -0,0 +1,107 @@
+/*
+ *
+ * threads.c
+ *
+ * Start/stop and reporting for benchmarks that run one loop in many
+ * threads for a fixed time, see bench_run_threads() in bench.h.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+volatile int		bench_threads_done;
+
+static bench_worker_fn	worker_fn;
+static int		nstarted;
+static pthread_mutex_t	start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	ready_cond = PTHREAD_COND_INITIALIZER;
+static int		go;
+
+static void *workerfn(void *arg)
+{
+	struct bench_worker *w = arg;
+
+	pthread_mutex_lock(&start_lock);
+	nstarted++;
+	pthread_cond_signal(&ready_cond);
+	while (!go)
+		pthread_cond_wait(&start_cond, &start_lock);
+	pthread_mutex_unlock(&start_lock);
+
+	w->ops = worker_fn(w);
+	return NULL;
+}
+
+void bench_run_threads(struct bench_worker *worker, int nthreads,
+		       int runtime, bench_worker_fn fn)
+{
+	struct timeval start, stop, diff;
+	unsigned long long total = 0, result_usec;
+	int i;
+
+	worker_fn = fn;
+	bench_threads_done = 0;
+	nstarted = 0;
+	go = 0;
+
+	for (i = 0; i < nthreads; i++) {
+		worker[i].id = i;
+		worker[i].ops = 0;
+		if (pthread_create(&worker[i].thread, NULL,
+				   workerfn, &worker[i]))
+			die("pthread_create");
+	}
+
+	pthread_mutex_lock(&start_lock);
+	while (nstarted < nthreads)
+		pthread_cond_wait(&ready_cond, &start_lock);
+	go = 1;
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_lock);
+
+	sleep(runtime);
+	bench_threads_done = 1;
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_join(worker[i].thread, NULL))
+			die("pthread_join");
+		total += worker[i].ops;
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+		printf(" %14lf usecs/op\n",
+		       (double)result_usec * nthreads / (double)total);
+		printf(" %14llu ops/sec\n",
+		       total * 1000000ULL / result_usec);
+		printf(" %14llu ops/sec/thread\n",
+		       total * 1000000ULL / result_usec / nthreads);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu\n", total * 1000000ULL / result_usec);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
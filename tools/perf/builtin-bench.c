@@ -13,6 +13,10 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  aio   ... asynchronous I/O submission
+ *  futex ... futex hash contention
+ *  ipc   ... SysV IPC scalability
+ *  fs    ... file creation and removal
  *
  */
 
@@ -61,6 +65,46 @@ static struct bench_suite mem_suites[] = {
 	  NULL             }
 };
 
+static struct bench_suite aio_suites[] = {
+	{ "ring",
+	  "Submission through the io_setup_ring() queue vs io_submit()",
+	  bench_aio_ring },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL           }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Contention on the futex hash from FUTEX_WAKE on distinct futexes",
+	  bench_futex_hash },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite ipc_suites[] = {
+	{ "semop",
+	  "Threads doing semop() on their own semaphore of one set",
+	  bench_ipc_semop },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL            }
+};
+
+static struct bench_suite fs_suites[] = {
+	{ "create",
+	  "Threads creating and unlinking files in their own directories",
+	  bench_fs_create },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL            }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -74,6 +118,18 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "aio",
+	  "asynchronous I/O submission",
+	  aio_suites },
+	{ "futex",
+	  "futex hash contention",
+	  futex_suites },
+	{ "ipc",
+	  "SysV IPC scalability",
+	  ipc_suites },
+	{ "fs",
+	  "file creation and removal",
+	  fs_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },